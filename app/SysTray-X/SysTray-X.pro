@@ -4,7 +4,7 @@
 #
 #-------------------------------------------------
 
-QT       += core gui
+QT       += core gui network
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -34,7 +34,7 @@ unix:!macx: {
     QMAKE_LFLAGS += $(RPM_OPT_FLAGS)
 #    QMAKE_LFLAGS += -static-libgcc -static-libstdc++
 
-    LIBS += -lX11
+    LIBS += -lX11 -lXss -lX11-xcb -lxcb
 }
 win32: {
 #    QMAKE_LFLAGS += -static -lwinpthread -static-libgcc -static-libstdc++ $$(QMAKE_LFLAGS_WINDOWS)
@@ -136,6 +136,11 @@ win32: {
 SOURCES += \
         main.cpp \
         systrayxlink.cpp \
+        systrayxlinkdecoder.cpp \
+        systrayxlinktransport.cpp \
+        systrayxunreadmodel.cpp \
+        systrayxdaemon.cpp \
+        systrayxbase64.cpp \
         systrayxicon.cpp \
         systrayx.cpp \
         debugwidget.cpp \
@@ -153,6 +158,12 @@ SOURCES += \
 
 HEADERS += \
         systrayxlink.h \
+        systrayxlinkqueue.h \
+        systrayxlinkdecoder.h \
+        systrayxlinktransport.h \
+        systrayxunreadmodel.h \
+        systrayxdaemon.h \
+        systrayxbase64.h \
         systrayxicon.h \
         systrayx.h \
         debugwidget.h \
@@ -229,4 +240,5 @@ unix:macx: {
 
     QMAKE_POST_LINK += cp -R $$[QT_INSTALL_LIBS]/QtCore.framework $${OUT_PWD}/$${TARGET}.app/Contents/Frameworks ;
     QMAKE_POST_LINK += cp -R $$[QT_INSTALL_LIBS]/QtGui.framework $${OUT_PWD}/$${TARGET}.app/Contents/Frameworks ;
+    QMAKE_POST_LINK += cp -R $$[QT_INSTALL_LIBS]/QtNetwork.framework $${OUT_PWD}/$${TARGET}.app/Contents/Frameworks ;
 }
@@ -46,11 +46,14 @@ void    DebugWidget::setUnreadMail( int unread )
 
 
 /*
- *  Handle a debug state change signal
+ *  Handle a preferences change signal
  */
-void    DebugWidget::slotDebugChange()
+void    DebugWidget::slotPreferencesChange( quint32 changes )
 {
-    this->setVisible( m_pref->getDebug() );
+    if( changes & Preferences::PREF_DEBUG_CHANGE )
+    {
+        this->setVisible( m_pref->getDebug() );
+    }
 }
 
 
@@ -65,9 +65,11 @@ class DebugWidget : public QWidget
     public slots:
 
         /**
-         * @brief slotDebugChange. The debug state changed.
+         * @brief slotPreferencesChange. The preferences changed.
+         *
+         *  @param changes  The changes (bits, Preferences::PrefChange).
          */
-        void    slotDebugChange();
+        void    slotPreferencesChange( quint32 changes );
 
         /**
          * @brief slotSetUnreadMail. Slot for handling unread mail signals.
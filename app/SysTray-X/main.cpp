@@ -2,6 +2,12 @@
  *	Local includes
  */
 #include "systrayx.h"
+#include "systrayxdaemon.h"
+
+/*
+ *	System includes
+ */
+#include <cstring>
 
 /*
  *	Qt includes
@@ -10,8 +16,25 @@
 
 int main( int argc, char *argv[] )
 {
+    /*
+     *  Started by the first stub as the resident daemon?
+     */
+    bool daemon = argc > 1 && strcmp( argv[ 1 ], SysTrayXDaemon::DAEMON_ARGUMENT ) == 0;
+
+    /*
+     *  Started by Thunderbird, forward to the daemon if enabled, run on our own if not available
+     */
+    if( !daemon && SysTrayXDaemon::isEnabled() )
+    {
+        int result = SysTrayXDaemon::runStub( argv[ 0 ] );
+        if( result >= 0 )
+        {
+            return result;
+        }
+    }
+
     QApplication a(argc, argv);
-    SysTrayX systrayx;
+    SysTrayX systrayx( daemon );
 
     return a.exec();
 }
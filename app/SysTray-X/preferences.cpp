@@ -12,6 +12,25 @@
 /*
  *	Qt includes
  */
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QSaveFile>
+#include <QFileInfo>
+#include <QFile>
+#include <QDir>
+#include <QTimer>
+
+
+/*
+ *  Constants
+ */
+const int   Preferences::ICON_STORE_SIZE = 8;
+const quint32   Preferences::CACHE_MAGIC = 0x53545850;     // "STXP"
+const quint16   Preferences::CACHE_VERSION = 1;
+const quint32   Preferences::CACHED_CHANGES = PREF_ICON_TYPE_CHANGE | PREF_ICON_DATA_CHANGE |
+        PREF_HIDE_ON_MINIMIZE_CHANGE | PREF_START_MINIMIZED_CHANGE | PREF_DEBUG_CHANGE;
+const int   Preferences::CACHE_SAVE_DELAY = 2000;
+
 
 /**
  * @brief Preferences.  Constructor.
@@ -23,14 +42,205 @@ Preferences::Preferences( QObject *parent ) : QObject( parent )
      */
     m_app_pref_changed = false;
 
+    m_update_level = 0;
+    m_changes = 0;
+
     m_icon_type = PREF_BLANK_ICON;
     m_icon_mime = "image/png";
     m_icon_data = QByteArray();
+    m_icon_digest = iconDigest( m_icon_data );
 
     m_hide_minimize = true;
     m_start_minimized = false;
 
     m_debug = false;
+
+    /*
+     *  Save the cache once per burst of changes
+     */
+    m_save_timer = new QTimer( this );
+    m_save_timer->setSingleShot( true );
+    m_save_timer->setInterval( CACHE_SAVE_DELAY );
+    connect( m_save_timer, &QTimer::timeout, this, &Preferences::slotSaveCache );
+}
+
+
+/*
+ *  Destructor.
+ */
+Preferences::~Preferences()
+{
+    /*
+     *  Do not lose the last changes
+     */
+    if( m_save_timer->isActive() )
+    {
+        m_save_timer->stop();
+        saveCache();
+    }
+}
+
+
+/*
+ *  Start a transaction.
+ */
+void    Preferences::beginUpdate()
+{
+    m_update_level++;
+}
+
+
+/*
+ *  End a transaction.
+ */
+void    Preferences::commitUpdate()
+{
+    if( m_update_level > 0 )
+    {
+        m_update_level--;
+    }
+
+    if( m_update_level == 0 && m_changes != 0 )
+    {
+        quint32 changes = m_changes;
+        m_changes = 0;
+
+        /*
+         *  Tell the world the new preferences
+         */
+        emit signalPreferencesChange( changes );
+
+        /*
+         *  Keep them for the next start, not on the GUI thread for every commit
+         */
+        if( !m_cache_file.isEmpty() && ( changes & CACHED_CHANGES ) )
+        {
+            m_save_timer->start();
+        }
+    }
+}
+
+
+/*
+ *  Load the last known preferences.
+ */
+bool    Preferences::loadCache( const QString& cache_file )
+{
+    bool valid = false;
+
+    QFile file( cache_file );
+    if( file.open( QIODevice::ReadOnly ) )
+    {
+        QDataStream stream( &file );
+        stream.setVersion( QDataStream::Qt_5_0 );
+
+        quint32 magic;
+        quint16 version;
+        stream >> magic >> version;
+
+        if( magic == CACHE_MAGIC && version == CACHE_VERSION )
+        {
+            qint32 icon_type;
+            QString icon_mime;
+            QByteArray icon_data;
+            bool hide_minimize;
+            bool start_minimized;
+            bool debug;
+            QList< QByteArray > store;
+
+            stream >> icon_type >> icon_mime >> icon_data >> hide_minimize >> start_minimized >> debug >> store;
+
+            if( stream.status() == QDataStream::Ok )
+            {
+                /*
+                 *  Apply them at once
+                 */
+                beginUpdate();
+
+                for( int i = 0 ; i < store.size() ; ++i )
+                {
+                    storeIcon( iconDigest( store.at( i ) ), store.at( i ) );
+                }
+
+                setIconType( static_cast< IconType >( icon_type ) );
+                setIconMime( icon_mime );
+                setIconData( icon_data );
+                setHideOnMinimize( hide_minimize );
+                setStartMinimized( start_minimized );
+                setDebug( debug );
+
+                commitUpdate();
+
+                valid = true;
+            }
+        }
+    }
+
+    /*
+     *  Save the changes from now on
+     */
+    m_cache_file = cache_file;
+
+    return valid;
+}
+
+
+/*
+ *  Save the preferences to the cache.
+ */
+bool    Preferences::saveCache() const
+{
+    QDir().mkpath( QFileInfo( m_cache_file ).path() );
+
+    QSaveFile file( m_cache_file );
+    if( !file.open( QIODevice::WriteOnly ) )
+    {
+        return false;
+    }
+
+    QDataStream stream( &file );
+    stream.setVersion( QDataStream::Qt_5_0 );
+
+    /*
+     *  The icon store, oldest first
+     */
+    QList< QByteArray > store;
+    for( int i = 0 ; i < m_icon_store_order.size() ; ++i )
+    {
+        store.append( m_icon_store.value( m_icon_store_order.at( i ) ) );
+    }
+
+    stream << CACHE_MAGIC << CACHE_VERSION;
+    stream << static_cast< qint32 >( m_icon_type ) << m_icon_mime << m_icon_data << m_hide_minimize << m_start_minimized << m_debug << store;
+
+    return file.commit();
+}
+
+
+/*
+ *  Save the cache after a burst of changes.
+ */
+void    Preferences::slotSaveCache()
+{
+    saveCache();
+}
+
+
+/*
+ *  Record a change.
+ */
+void    Preferences::changed( PrefChange change )
+{
+    m_changes |= change;
+
+    if( m_update_level == 0 )
+    {
+        /*
+         *  Single change, commit it now
+         */
+        beginUpdate();
+        commitUpdate();
+    }
 }
 
 
@@ -74,9 +284,9 @@ void    Preferences::setIconType( IconType icon_type )
         m_icon_type = icon_type;
 
         /*
-         *  Tell the world the new preference
+         *  Record the new preference
          */
-        emit signalIconTypeChange();
+        changed( PREF_ICON_TYPE_CHANGE );
     }
 }
 
@@ -95,7 +305,15 @@ const QString&  Preferences::getIconMime() const
  */
 void    Preferences::setIconMime( const QString& icon_mime )
 {
-    m_icon_mime = icon_mime;
+    if( m_icon_mime != icon_mime )
+    {
+        m_icon_mime = icon_mime;
+
+        /*
+         *  Record the new preference
+         */
+        changed( PREF_ICON_DATA_CHANGE );
+    }
 }
 
 
@@ -117,15 +335,84 @@ void    Preferences::setIconData( const QByteArray& icon_data )
     if( m_icon_data != icon_data )
     {
         m_icon_data = icon_data;
+        m_icon_digest = iconDigest( m_icon_data );
 
         /*
-         *  Tell the world the new preference
+         *  Keep it for a later digest lookup
          */
-        emit signalIconDataChange();
+        storeIcon( m_icon_digest, m_icon_data );
+
+        /*
+         *  Record the new preference
+         */
+        changed( PREF_ICON_DATA_CHANGE );
     }
 }
 
 
+/*
+ *  Get the icon digest.
+ */
+const QByteArray&   Preferences::getIconDigest() const
+{
+    return m_icon_digest;
+}
+
+
+/*
+ *  Find icon data in the local store.
+ */
+bool    Preferences::findIcon( const QByteArray& digest, QByteArray& icon_data ) const
+{
+    if( digest == m_icon_digest )
+    {
+        icon_data = m_icon_data;
+        return true;
+    }
+
+    QHash< QByteArray, QByteArray >::const_iterator it = m_icon_store.constFind( digest );
+    if( it == m_icon_store.constEnd() )
+    {
+        return false;
+    }
+
+    icon_data = it.value();
+    return true;
+}
+
+
+/*
+ *  Calculate the digest of icon data.
+ */
+QByteArray  Preferences::iconDigest( const QByteArray& icon_data )
+{
+    return QCryptographicHash::hash( icon_data, QCryptographicHash::Sha256 ).toHex();
+}
+
+
+/*
+ *  Add icon data to the local store.
+ */
+void    Preferences::storeIcon( const QByteArray& digest, const QByteArray& icon_data )
+{
+    if( icon_data.isEmpty() || m_icon_store.contains( digest ) )
+    {
+        return;
+    }
+
+    /*
+     *  Drop the oldest icon
+     */
+    if( m_icon_store_order.size() >= ICON_STORE_SIZE )
+    {
+        m_icon_store.remove( m_icon_store_order.takeFirst() );
+    }
+
+    m_icon_store.insert( digest, icon_data );
+    m_icon_store_order.append( digest );
+}
+
+
 /*
  *  Get the hide on minimize pref.
  */
@@ -145,9 +432,9 @@ void    Preferences::setHideOnMinimize( bool state )
         m_hide_minimize = state;
 
         /*
-         *  Tell the world the new preference
+         *  Record the new preference
          */
-        emit signalHideOnMinimizeChange();
+        changed( PREF_HIDE_ON_MINIMIZE_CHANGE );
     }
 }
 
@@ -171,9 +458,9 @@ void    Preferences::setStartMinimized( bool state )
         m_start_minimized = state;
 
         /*
-         *  Tell the world the new preference
+         *  Record the new preference
          */
-        emit signalStartMinimizedChange();
+        changed( PREF_START_MINIMIZED_CHANGE );
     }
 }
 
@@ -197,8 +484,8 @@ void    Preferences::setDebug( bool state )
         m_debug = state;
 
         /*
-         *  Tell the world the new preference
+         *  Record the new preference
          */
-        emit signalDebugChange();
+        changed( PREF_DEBUG_CHANGE );
     }
 }
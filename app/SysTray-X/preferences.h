@@ -11,6 +11,13 @@
 #include <QObject>
 #include <QString>
 #include <QByteArray>
+#include <QHash>
+#include <QList>
+
+/*
+ *  Predefines
+ */
+class QTimer;
 
 /**
  * @brief The Preferences class. Class to hold the preferences.
@@ -30,6 +37,22 @@ class Preferences : public QObject
             PREF_CUSTOM_ICON
         };
 
+        /*
+         *  Preference changes (bits)
+         */
+        enum PrefChange {
+            PREF_ICON_TYPE_CHANGE = 0x01,
+            PREF_ICON_DATA_CHANGE = 0x02,
+            PREF_HIDE_ON_MINIMIZE_CHANGE = 0x04,
+            PREF_START_MINIMIZED_CHANGE = 0x08,
+            PREF_DEBUG_CHANGE = 0x10
+        };
+
+        /**
+         * @brief MAX_ICON_SIZE. Largest custom icon, the add-on only accepts frames up to 1 MB and gets it in base64.
+         */
+        static const int MAX_ICON_SIZE = 512 * 1024;
+
     public:
 
         /**
@@ -37,6 +60,11 @@ class Preferences : public QObject
          */
         Preferences( QObject *parent = nullptr );
 
+        /**
+         * @brief ~Preferences. Destructor, writes a pending cache save.
+         */
+        ~Preferences();
+
         /**
          * @brief getAppPrefChanged. Control for sending changes to the add-on.
          *
@@ -51,6 +79,34 @@ class Preferences : public QObject
          */
         void setAppPrefChanged( bool state );
 
+        /**
+         * @brief beginUpdate. Start a transaction, changes are signalled at the commit.
+         *
+         *  Transactions may be nested, the outer commit signals.
+         */
+        void beginUpdate();
+
+        /**
+         * @brief commitUpdate. End a transaction, signal all changes at once.
+         */
+        void commitUpdate();
+
+        /**
+         * @brief loadCache. Load the last known preferences, later changes are saved to the cache.
+         *
+         *  @param cache_file   The cache file.
+         *
+         *  @return     False if there was no valid cache.
+         */
+        bool loadCache( const QString& cache_file );
+
+        /**
+         * @brief saveCache. Save the preferences to the cache now.
+         *
+         *  @return     Success.
+         */
+        bool saveCache() const;
+
         /**
          * @brief getIconType. Get the icon type.
          *
@@ -93,6 +149,32 @@ class Preferences : public QObject
          */
         void setIconData( const QByteArray& icon_data );
 
+        /**
+         * @brief getIconDigest. Get the digest of the icon data.
+         *
+         * @return      The digest (hex).
+         */
+        const QByteArray& getIconDigest() const;
+
+        /**
+         * @brief findIcon. Find icon data in the local store.
+         *
+         * @param digest        The digest (hex).
+         * @param icon_data     Storage for the icon data.
+         *
+         * @return      True if found.
+         */
+        bool findIcon( const QByteArray& digest, QByteArray& icon_data ) const;
+
+        /**
+         * @brief iconDigest. Calculate the digest of icon data (SHA-256).
+         *
+         * @param icon_data     The icon data.
+         *
+         * @return      The digest (hex).
+         */
+        static QByteArray iconDigest( const QByteArray& icon_data );
+
         /**
          * @brief getHideOnMinimize. Get the hide on minimize state.
          *
@@ -138,37 +220,88 @@ class Preferences : public QObject
     signals:
 
         /**
-         * @brief signalIconTypeChange. Signal a icon type change.
+         * @brief signalPreferencesChange. Signal the changed preferences of a transaction.
+         *
+         *  @param changes  The changes (bits, PrefChange).
          */
-        void signalIconTypeChange();
+        void signalPreferencesChange( quint32 changes );
+
+    private slots:
 
         /**
-         * @brief signalIconDataChange. Signal a icon data change.
+         * @brief slotSaveCache. Save the preferences to the cache after a burst of changes.
          */
-        void signalIconDataChange();
+        void slotSaveCache();
+
+    private:
 
         /**
-         * @brief signalHideOnMinimizeChange. Signal a hide on mnimize state change.
+         * @brief changed. Record a change, signal it when not in a transaction.
+         *
+         * @param change    The change.
          */
-        void signalHideOnMinimizeChange();
+        void changed( PrefChange change );
 
         /**
-         * @brief signalStartMinimizedChange. Signal a start minimized state change.
+         * @brief storeIcon. Add icon data to the local store.
+         *
+         * @param digest        The digest (hex).
+         * @param icon_data     The icon data.
          */
-        void signalStartMinimizedChange();
+        void storeIcon( const QByteArray& digest, const QByteArray& icon_data );
+
+    private:
 
         /**
-         * @brief signalDebugChange. Signal a debug state change.
+         * @brief ICON_STORE_SIZE. Max number of icons in the local store.
          */
-        void signalDebugChange();
+        static const int ICON_STORE_SIZE;
 
-    private:
+        /**
+         * @brief CACHE_MAGIC. Cache file identification.
+         */
+        static const quint32 CACHE_MAGIC;
+
+        /**
+         * @brief CACHE_VERSION. Cache file format version.
+         */
+        static const quint16 CACHE_VERSION;
+
+        /**
+         * @brief CACHED_CHANGES. Changes of fields kept in the cache (bits, PrefChange).
+         */
+        static const quint32 CACHED_CHANGES;
+
+        /**
+         * @brief CACHE_SAVE_DELAY. Time to wait for more changes before saving the cache (ms).
+         */
+        static const int CACHE_SAVE_DELAY;
+
+        /**
+         * @brief m_save_timer. Delays the cache save.
+         */
+        QTimer* m_save_timer;
+
+        /**
+         * @brief m_cache_file. The preferences cache file.
+         */
+        QString m_cache_file;
 
         /**
          * @brief m_app_pref_changed. Control for sending changes to the add-on.
          */
         bool m_app_pref_changed;
 
+        /**
+         * @brief m_update_level. Transaction nesting level.
+         */
+        int m_update_level;
+
+        /**
+         * @brief m_changes. Changes of the current transaction (bits, PrefChange).
+         */
+        quint32 m_changes;
+
         /**
          * @brief m_icon_type. Selected icon type.
          */
@@ -184,6 +317,21 @@ class Preferences : public QObject
          */
         QByteArray m_icon_data;
 
+        /**
+         * @brief m_icon_digest. Digest of the icon image.
+         */
+        QByteArray m_icon_digest;
+
+        /**
+         * @brief m_icon_store. Known icon images, keyed by digest.
+         */
+        QHash< QByteArray, QByteArray > m_icon_store;
+
+        /**
+         * @brief m_icon_store_order. Digests of the stored icons, oldest first.
+         */
+        QList< QByteArray > m_icon_store_order;
+
         /**
          * @brief m_hide_minimize. Hide the minimized window.
          */
@@ -11,6 +11,7 @@
  */
 #include <QPixmap>
 #include <QFileDialog>
+#include <QMessageBox>
 #include <QMimeDatabase>
 #include <QJsonDocument>
 #include <QJsonObject>
@@ -131,8 +132,10 @@ void    PreferencesDialog::slotAccept()
     m_pref->setAppPrefChanged( true );
 
     /*
-     *  Get all the selected values and store them in the preferences
+     *  Get all the selected values and store them in the preferences, signal them at once
      */
+    m_pref->beginUpdate();
+
     m_pref->setIconType( static_cast< Preferences::IconType >( m_ui->iconTypeGroup->checkedId() ) );
     m_pref->setIconMime( m_tmp_icon_mime );
     m_pref->setIconData( m_tmp_icon_data );
@@ -142,6 +145,8 @@ void    PreferencesDialog::slotAccept()
 
     m_pref->setDebug( m_ui->debugWindowCheckBox->isChecked() );
 
+    m_pref->commitUpdate();
+
     /*
      *  Settings changed by app
      */
@@ -164,6 +169,17 @@ void    PreferencesDialog::slotFileSelect()
     if( file_dialog.exec() )
     {
         QFile file( file_dialog.selectedFiles()[ 0 ] );
+
+        /*
+         *  The icon has to fit in a frame to the add-on
+         */
+        if( file.size() > Preferences::MAX_ICON_SIZE )
+        {
+            QMessageBox::warning( this, tr( "Open Image" ),
+                                  tr( "The image is too large, the maximum is %1 KB." ).arg( Preferences::MAX_ICON_SIZE / 1024 ) );
+            return;
+        }
+
         file.open( QIODevice::ReadOnly );
         m_tmp_icon_data = file.readAll();
         file.close();
@@ -180,50 +196,38 @@ void    PreferencesDialog::slotFileSelect()
 
 
 /*
- *  Handle the debug change signal
- */
-void    PreferencesDialog::slotDebugChange()
-{
-    setDebug( m_pref->getDebug() );
-}
-
-
-/*
- *  Handle the hide on minimize change signal
+ *  Handle the preferences change signal
  */
-void    PreferencesDialog::slotHideOnMinimizeChange()
+void    PreferencesDialog::slotPreferencesChange( quint32 changes )
 {
-    setHideOnMinimize( m_pref->getHideOnMinimize() );
-}
-
+    if( changes & Preferences::PREF_DEBUG_CHANGE )
+    {
+        setDebug( m_pref->getDebug() );
+    }
 
-/*
- *  Handle the start minimized change signal
- */
-void    PreferencesDialog::slotStartMinimizedChange()
-{
-    setStartMinimized( m_pref->getStartMinimized() );
-}
+    if( changes & Preferences::PREF_HIDE_ON_MINIMIZE_CHANGE )
+    {
+        setHideOnMinimize( m_pref->getHideOnMinimize() );
+    }
 
-/*
- *  Handle the icon type change signal
- */
-void    PreferencesDialog::slotIconTypeChange()
-{
-    setIconType( m_pref->getIconType() );
-}
+    if( changes & Preferences::PREF_START_MINIMIZED_CHANGE )
+    {
+        setStartMinimized( m_pref->getStartMinimized() );
+    }
 
+    if( changes & Preferences::PREF_ICON_TYPE_CHANGE )
+    {
+        setIconType( m_pref->getIconType() );
+    }
 
-/*
- *  Handle the icon data change signal
- */
-void    PreferencesDialog::slotIconDataChange()
-{
-    m_tmp_icon_mime = m_pref->getIconMime();
-    m_tmp_icon_data = m_pref->getIconData();
+    if( changes & Preferences::PREF_ICON_DATA_CHANGE )
+    {
+        m_tmp_icon_mime = m_pref->getIconMime();
+        m_tmp_icon_data = m_pref->getIconData();
 
-    /*
-     *  Display the icon
-     */
-    setIcon();
+        /*
+         *  Display the icon
+         */
+        setIcon();
+    }
 }
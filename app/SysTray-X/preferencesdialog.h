@@ -92,29 +92,11 @@ class PreferencesDialog : public QDialog
     public slots:
 
         /**
-         * @brief slotDebugChange. Slot for handling debug change signals.
-         */
-        void slotDebugChange();
-
-        /**
-         * @brief slotHideOnMinimizeChange. Slot for handling hide on minimize change signals.
-         */
-        void slotHideOnMinimizeChange();
-
-        /**
-         * @brief slotStartMinimizedChange. Slot for handling start minimized change signals.
-         */
-        void slotStartMinimizedChange();
-
-        /**
-         * @brief slotIconTypeChange. Slot for handling icon type change signals.
-         */
-        void slotIconTypeChange();
-
-        /**
-         * @brief slotIconDataChange. Slot for handling icon data change signals.
+         * @brief slotPreferencesChange. Slot for handling preferences change signals.
+         *
+         *  @param changes  The changes (bits, Preferences::PrefChange).
          */
-        void slotIconDataChange();
+        void slotPreferencesChange( quint32 changes );
 
     private slots:
 
@@ -6,6 +6,7 @@
 #include "debugwidget.h"
 #include "preferencesdialog.h"
 #include "systrayxlink.h"
+#include "systrayxdaemon.h"
 #include "systrayxicon.h"
 #include "windowctrl.h"
 
@@ -13,35 +14,51 @@
  *	Qt includes
  */
 #include <QCoreApplication>
+#include <QStandardPaths>
 #include <QMenu>
 #include <QStyle>
 #include <QIcon>
+#include <QTimer>
 
 /*
  *  Constants
  */
-const QString   SysTrayX::JSON_PREF_REQUEST = "{\"preferences\":{}}";
+const QString   SysTrayX::PREF_CACHE_FILE = "preferences.cache";
 
 
 /*
  *  Constructor
  */
-SysTrayX::SysTrayX( QObject *parent ) : QObject( parent )
+SysTrayX::SysTrayX( bool daemon, QObject *parent ) : QObject( parent )
 {
     /*
      *  Setup preferences storage
      */
     m_preferences = new Preferences();
 
-    /*
-     *  Setup window control
-     */
-    m_win_ctrl = new WindowCtrl( m_preferences );
+    m_win_ctrl = nullptr;
+    m_link = nullptr;
+    m_daemon = nullptr;
 
-    /*
-     *  Setup the link
-     */
-    m_link = new SysTrayXLink( m_preferences );
+    if( daemon )
+    {
+        /*
+         *  Setup the profiles, each with its own link and window control
+         */
+        m_daemon = new SysTrayXDaemon( m_preferences, this );
+    }
+    else
+    {
+        /*
+         *  Setup window control
+         */
+        m_win_ctrl = new WindowCtrl( m_preferences );
+
+        /*
+         *  Setup the link
+         */
+        m_link = new SysTrayXLink( m_preferences );
+    }
 
     /*
      *  Setup preferences dialog
@@ -62,81 +79,102 @@ SysTrayX::SysTrayX( QObject *parent ) : QObject( parent )
         m_debug->show();
     }
 
-    /*
-     *  Connect debug link signals
-     */
-    connect( m_link, &SysTrayXLink::signalUnreadMail, m_debug, &DebugWidget::slotUnreadMail );
-
-    connect( m_win_ctrl, &WindowCtrl::signalConsole, m_debug, &DebugWidget::slotConsole );
-    connect( m_debug, &DebugWidget::signalTest1ButtonClicked, m_win_ctrl, &WindowCtrl::slotWindowTest1 );
-    connect( m_debug, &DebugWidget::signalTest2ButtonClicked, m_win_ctrl, &WindowCtrl::slotWindowTest2 );
-    connect( m_debug, &DebugWidget::signalTest3ButtonClicked, m_win_ctrl, &WindowCtrl::slotWindowTest3 );
-
     /*
      *  Connect preferences signals
      */
-    connect( m_preferences, &Preferences::signalIconTypeChange, m_tray_icon, &SysTrayXIcon::slotIconTypeChange );
-    connect( m_preferences, &Preferences::signalIconDataChange, m_tray_icon, &SysTrayXIcon::slotIconDataChange );
-
-    connect( m_preferences, &Preferences::signalHideOnMinimizeChange, m_win_ctrl, &WindowCtrl::slotHideOnMinimizeChange );
-    connect( m_preferences, &Preferences::signalStartMinimizedChange, m_win_ctrl, &WindowCtrl::slotStartMinimizedChange );
-
-
-    connect( m_preferences, &Preferences::signalIconTypeChange, m_pref_dialog, &PreferencesDialog::slotIconTypeChange );
-    connect( m_preferences, &Preferences::signalIconDataChange, m_pref_dialog, &PreferencesDialog::slotIconDataChange );
-    connect( m_preferences, &Preferences::signalHideOnMinimizeChange, m_pref_dialog, &PreferencesDialog::slotHideOnMinimizeChange );
-    connect( m_preferences, &Preferences::signalStartMinimizedChange, m_pref_dialog, &PreferencesDialog::slotStartMinimizedChange );
-    connect( m_preferences, &Preferences::signalDebugChange, m_pref_dialog, &PreferencesDialog::slotDebugChange );
-
-    connect( m_preferences, &Preferences::signalIconTypeChange, m_link, &SysTrayXLink::slotIconTypeChange );
-    connect( m_preferences, &Preferences::signalIconDataChange, m_link, &SysTrayXLink::slotIconDataChange );
-    connect( m_preferences, &Preferences::signalHideOnMinimizeChange, m_link, &SysTrayXLink::slotHideOnMinimizeChange );
-    connect( m_preferences, &Preferences::signalStartMinimizedChange, m_link, &SysTrayXLink::slotStartMinimizedChange );
-    connect( m_preferences, &Preferences::signalDebugChange, m_link, &SysTrayXLink::slotDebugChange );
-
-    connect( m_preferences, &Preferences::signalDebugChange, m_debug, &DebugWidget::slotDebugChange );
-
-    /*
-     *  Connect link signals
-     */
-    connect( m_link, &SysTrayXLink::signalUnreadMail, m_tray_icon, &SysTrayXIcon::slotSetUnreadMail );
-    connect( m_link, &SysTrayXLink::signalAddOnShutdown, this, &SysTrayX::slotAddOnShutdown );
-    connect( m_link, &SysTrayXLink::signalWindowState, m_win_ctrl, &WindowCtrl::slotWindowState );
-    connect( m_link, &SysTrayXLink::signalTitle, m_win_ctrl, &WindowCtrl::slotWindowTitle );
-
-    /*
-     *  Connect window signals
-     */
-    connect( m_win_ctrl, &WindowCtrl::signalWindowNormal, m_link, &SysTrayXLink::slotWindowNormal );
-    connect( m_win_ctrl, &WindowCtrl::signalWindowMinimize, m_link, &SysTrayXLink::slotWindowMinimize );
-
-    /*
-     *  Connect system tray signals
-     */
-    connect( m_tray_icon, &SysTrayXIcon::signalShowHide, m_win_ctrl, &WindowCtrl::slotShowHide );
-
-    /*
-     *  SysTrayX
-     */
-    connect( this, &SysTrayX::signalClose, m_win_ctrl, &WindowCtrl::slotClose );
-
-    /*
-     *  Request preferences from add-on
-     */
-    getPreferences();
-}
-
+    connect( m_preferences, &Preferences::signalPreferencesChange, m_tray_icon, &SysTrayXIcon::slotPreferencesChange );
+    connect( m_preferences, &Preferences::signalPreferencesChange, m_pref_dialog, &PreferencesDialog::slotPreferencesChange );
+    connect( m_preferences, &Preferences::signalPreferencesChange, m_debug, &DebugWidget::slotPreferencesChange );
+
+    if( m_daemon )
+    {
+        /*
+         *  Connect daemon signals, the profiles connect their own link and window control
+         */
+        connect( m_daemon, &SysTrayXDaemon::signalUnreadMail, m_debug, &DebugWidget::slotUnreadMail );
+        connect( m_daemon, &SysTrayXDaemon::signalUnreadMail, m_tray_icon, &SysTrayXIcon::slotSetUnreadMail );
+        connect( m_daemon, &SysTrayXDaemon::signalLinkState, m_tray_icon, &SysTrayXIcon::slotLinkState );
+        connect( m_daemon, &SysTrayXDaemon::signalAccountUnread, m_tray_icon, &SysTrayXIcon::slotSetAccountUnread );
+        connect( m_daemon, &SysTrayXDaemon::signalConsole, m_debug, &DebugWidget::slotConsole );
+        connect( m_daemon, &SysTrayXDaemon::signalAllProfilesClosed, this, &SysTrayX::slotAddOnShutdown );
+        connect( m_debug, &DebugWidget::signalTest1ButtonClicked, m_daemon, &SysTrayXDaemon::slotBenchmark );
+        connect( m_debug, &DebugWidget::signalTest2ButtonClicked, m_daemon, &SysTrayXDaemon::slotStatistics );
+        connect( m_debug, &DebugWidget::signalTest3ButtonClicked, m_daemon, &SysTrayXDaemon::slotWindowBenchmark );
+        connect( m_tray_icon, &SysTrayXIcon::signalShowHide, m_daemon, &SysTrayXDaemon::slotShowHide );
+        connect( this, &SysTrayX::signalClose, m_daemon, &SysTrayXDaemon::slotClose );
+    }
+    else
+    {
+        /*
+         *  Connect debug link signals
+         */
+        connect( m_link, &SysTrayXLink::signalUnreadMail, m_debug, &DebugWidget::slotUnreadMail );
+
+        connect( m_win_ctrl, &WindowCtrl::signalConsole, m_debug, &DebugWidget::slotConsole );
+        connect( m_debug, &DebugWidget::signalTest1ButtonClicked, m_win_ctrl, &WindowCtrl::slotWindowTest1 );
+        connect( m_debug, &DebugWidget::signalTest1ButtonClicked, m_link, &SysTrayXLink::slotBenchmark );
+        connect( m_link, &SysTrayXLink::signalConsole, m_debug, &DebugWidget::slotConsole );
+        connect( m_debug, &DebugWidget::signalTest2ButtonClicked, m_win_ctrl, &WindowCtrl::slotWindowTest2 );
+        connect( m_debug, &DebugWidget::signalTest2ButtonClicked, m_link, &SysTrayXLink::slotStatistics );
+        connect( m_debug, &DebugWidget::signalTest3ButtonClicked, m_win_ctrl, &WindowCtrl::slotWindowTest3 );
+
+        /*
+         *  Connect preferences signals
+         */
+        connect( m_preferences, &Preferences::signalPreferencesChange, m_win_ctrl, &WindowCtrl::slotPreferencesChange );
+        connect( m_preferences, &Preferences::signalPreferencesChange, m_link, &SysTrayXLink::slotPreferencesChange );
+
+        /*
+         *  Connect link signals
+         */
+        connect( m_link, &SysTrayXLink::signalUnreadMail, m_tray_icon, &SysTrayXIcon::slotSetUnreadMail );
+        connect( m_link, &SysTrayXLink::signalAccountUnread, m_tray_icon, &SysTrayXIcon::slotSetAccountUnread );
+        connect( m_link, &SysTrayXLink::signalLinkState, m_tray_icon, &SysTrayXIcon::slotLinkState );
+        connect( m_link, &SysTrayXLink::signalAddOnShutdown, this, &SysTrayX::slotAddOnShutdown );
+        connect( m_link, &SysTrayXLink::signalWindowState, m_win_ctrl, &WindowCtrl::slotWindowState );
+        connect( m_link, &SysTrayXLink::signalTitle, m_win_ctrl, &WindowCtrl::slotWindowTitle );
+
+        /*
+         *  Connect window signals
+         */
+        connect( m_win_ctrl, &WindowCtrl::signalWindowNormal, m_link, &SysTrayXLink::slotWindowNormal );
+        connect( m_win_ctrl, &WindowCtrl::signalWindowMinimize, m_link, &SysTrayXLink::slotWindowMinimize );
+        connect( m_win_ctrl, &WindowCtrl::signalPollInterval, m_link, &SysTrayXLink::slotPollInterval );
+
+        /*
+         *  Connect system tray signals
+         */
+        connect( m_tray_icon, &SysTrayXIcon::signalShowHide, m_win_ctrl, &WindowCtrl::slotShowHide );
+
+        /*
+         *  SysTrayX
+         */
+        connect( this, &SysTrayX::signalClose, m_win_ctrl, &WindowCtrl::slotClose );
+    }
 
-/*
- *  Send a preferences request
- */
-void    SysTrayX::getPreferences()
-{
     /*
-     *  Request preferences from add-on
+     *  Apply the last known preferences before the first paint,
+     *  the add-on preferences will follow
      */
-    QByteArray request = QString( SysTrayX::JSON_PREF_REQUEST ).toUtf8();
-    emit signalWriteMessage( request );
+    m_preferences->loadCache( QStandardPaths::writableLocation( QStandardPaths::CacheLocation ) + "/" + PREF_CACHE_FILE );
+
+    if( m_daemon )
+    {
+        /*
+         *  Wait for the stubs, quit if another daemon was faster
+         */
+        if( !m_daemon->start() )
+        {
+            QTimer::singleShot( 0, this, &SysTrayX::slotAddOnShutdown );
+        }
+    }
+    else
+    {
+        /*
+         *  Start the handshake, the add-on answers with its preferences
+         */
+        m_link->sendHello();
+    }
 }
 
 
@@ -147,7 +185,14 @@ void    SysTrayX::createActions()
 {
     m_showhide_action = new QAction(tr("&Show/Hide"), this);
     m_showhide_action->setIcon( QIcon( ":/files/icons/window-restore.png" ) );
-    connect( m_showhide_action, &QAction::triggered, m_win_ctrl, &WindowCtrl::slotShowHide );
+    if( m_daemon )
+    {
+        connect( m_showhide_action, &QAction::triggered, m_daemon, &SysTrayXDaemon::slotShowHide );
+    }
+    else
+    {
+        connect( m_showhide_action, &QAction::triggered, m_win_ctrl, &WindowCtrl::slotShowHide );
+    }
 
     m_pref_action = new QAction(tr("&Preferences"), this);
     m_pref_action->setIcon( QIcon( ":/files/icons/gtk-preferences.png" ) );
@@ -20,6 +20,7 @@ class QAction;
 
 class DebugWidget;
 class PreferencesDialog;
+class SysTrayXDaemon;
 class SysTrayXIcon;
 class SysTrayXLink;
 class WindowCtrl;
@@ -33,24 +34,20 @@ class SysTrayX : public QObject
 
     public:
 
-        static const QString JSON_PREF_REQUEST;
+        static const QString PREF_CACHE_FILE;
 
     public:
 
         /**
          * @brief SysTrayX. Constructor.
          *
+         *  @param daemon   Run as the resident daemon of all profiles instead of for one Thunderbird.
          *  @param parent   My parent.
          */
-        explicit SysTrayX( QObject *parent = nullptr );
+        explicit SysTrayX( bool daemon = false, QObject *parent = nullptr );
 
     private:
 
-        /**
-         * @brief SysTrayX::getPreferences
-         */
-        void    getPreferences();
-
         /**
          * @brief createTrayIcon. Create the system tray icon.
          */
@@ -63,13 +60,6 @@ class SysTrayX : public QObject
 
     signals:
 
-        /**
-         * @brief signalWriteMessage
-         *
-         * @param message
-         */
-        void    signalWriteMessage( QByteArray message );
-
         /**
          * @brief signalClose. Signal close all TB windows.
          */
@@ -109,6 +99,11 @@ class SysTrayX : public QObject
          */
         SysTrayXLink*   m_link;
 
+        /**
+         * @brief m_daemon. Pointer to the profiles of the resident daemon.
+         */
+        SysTrayXDaemon* m_daemon;
+
         /**
          * @brief m_pref_dialog. Pointer to the preferences dialog.
          */
@@ -0,0 +1,628 @@
+#include "systrayxbase64.h"
+
+/*
+ *	Local includes
+ */
+
+
+/*
+ *  System includes
+ */
+#include <cstring>
+
+#if defined( __x86_64__ ) || defined( __i386__ ) || defined( _M_X64 ) || defined( _M_IX86 )
+#define SYSTRAYX_BASE64_X86
+#include <immintrin.h>
+#if defined( _MSC_VER )
+#include <intrin.h>
+#endif
+#endif
+
+/*
+ *	Qt includes
+ */
+#include <QElapsedTimer>
+
+
+/*
+ *  The kernels are compiled for their instruction set only, the dispatch makes sure they are not called on other CPUs
+ */
+#if defined( SYSTRAYX_BASE64_X86 ) && ( defined( __GNUC__ ) || defined( __clang__ ) )
+#define SYSTRAYX_TARGET( isa )  __attribute__(( target( isa ) ))
+#else
+#define SYSTRAYX_TARGET( isa )
+#endif
+
+
+/*
+ *  Constants
+ */
+const char* const   SysTrayXBase64::IMPL_NAMES[] = {
+    "scalar",
+    "ssse3",
+    "avx2"
+};
+
+static const char   ENCODE_TABLE[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+
+/*
+ *  Reverse of ENCODE_TABLE, -1 for characters outside the alphabet
+ */
+static const struct DecodeTable
+{
+    DecodeTable()
+    {
+        memset( values, -1, sizeof( values ) );
+        for( int i = 0 ; i < 64 ; ++i )
+        {
+            values[ static_cast< quint8 >( ENCODE_TABLE[ i ] ) ] = static_cast< signed char >( i );
+        }
+    }
+
+    signed char values[ 256 ];
+}   DECODE_TABLE;
+
+
+/*
+ *  Implementation in use, detected at startup
+ */
+SysTrayXBase64::Implementation  SysTrayXBase64::m_impl = SysTrayXBase64::detect();
+
+
+#ifdef SYSTRAYX_BASE64_X86
+
+/*
+ *  Split 12 bytes per lane into 16 6-bit indices and translate them to ASCII (SSSE3)
+ */
+SYSTRAYX_TARGET( "ssse3" )
+static inline __m128i   encodeLane128( __m128i in )
+{
+    in = _mm_shuffle_epi8( in, _mm_set_epi8( 10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1 ) );
+
+    const __m128i t0 = _mm_and_si128( in, _mm_set1_epi32( 0x0fc0fc00 ) );
+    const __m128i t1 = _mm_mulhi_epu16( t0, _mm_set1_epi32( 0x04000040 ) );
+    const __m128i t2 = _mm_and_si128( in, _mm_set1_epi32( 0x003f03f0 ) );
+    const __m128i t3 = _mm_mullo_epi16( t2, _mm_set1_epi32( 0x01000010 ) );
+    const __m128i indices = _mm_or_si128( t1, t3 );
+
+    /*
+     *  Map the index ranges to an offset: 0..25 -> 13, 26..51 -> 0, 52..61 -> 1..10, 62 -> 11, 63 -> 12
+     */
+    __m128i range = _mm_subs_epu8( indices, _mm_set1_epi8( 51 ) );
+    const __m128i less = _mm_cmpgt_epi8( _mm_set1_epi8( 26 ), indices );
+    range = _mm_or_si128( range, _mm_and_si128( less, _mm_set1_epi8( 13 ) ) );
+
+    const __m128i offsets = _mm_setr_epi8( 'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                           '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0 );
+
+    return _mm_add_epi8( _mm_shuffle_epi8( offsets, range ), indices );
+}
+
+
+/*
+ *  Encode blocks of 12 bytes (SSSE3)
+ */
+SYSTRAYX_TARGET( "ssse3" )
+static int  encodeSsse3( const char* src, int len, char* dst )
+{
+    int pos = 0;
+
+    /*
+     *  A load reads 16 bytes, 12 are used
+     */
+    while( len - pos >= 16 )
+    {
+        __m128i in = _mm_loadu_si128( reinterpret_cast< const __m128i* >( src + pos ) );
+        _mm_storeu_si128( reinterpret_cast< __m128i* >( dst ), encodeLane128( in ) );
+
+        pos += 12;
+        dst += 16;
+    }
+
+    return pos;
+}
+
+
+/*
+ *  Translate 16 characters to 6-bit values and pack them into 12 bytes (SSSE3)
+ *  Returns false for characters outside the alphabet.
+ */
+SYSTRAYX_TARGET( "ssse3" )
+static inline bool  decodeLane128( __m128i in, __m128i& out )
+{
+    const __m128i upper = _mm_and_si128( _mm_cmpgt_epi8( in, _mm_set1_epi8( 'A' - 1 ) ), _mm_cmpgt_epi8( _mm_set1_epi8( 'Z' + 1 ), in ) );
+    const __m128i lower = _mm_and_si128( _mm_cmpgt_epi8( in, _mm_set1_epi8( 'a' - 1 ) ), _mm_cmpgt_epi8( _mm_set1_epi8( 'z' + 1 ), in ) );
+    const __m128i digit = _mm_and_si128( _mm_cmpgt_epi8( in, _mm_set1_epi8( '0' - 1 ) ), _mm_cmpgt_epi8( _mm_set1_epi8( '9' + 1 ), in ) );
+    const __m128i plus = _mm_cmpeq_epi8( in, _mm_set1_epi8( '+' ) );
+    const __m128i slash = _mm_cmpeq_epi8( in, _mm_set1_epi8( '/' ) );
+
+    const __m128i valid = _mm_or_si128( _mm_or_si128( upper, lower ), _mm_or_si128( digit, _mm_or_si128( plus, slash ) ) );
+    if( _mm_movemask_epi8( valid ) != 0xFFFF )
+    {
+        return false;
+    }
+
+    __m128i shift = _mm_and_si128( upper, _mm_set1_epi8( -65 ) );
+    shift = _mm_or_si128( shift, _mm_and_si128( lower, _mm_set1_epi8( -71 ) ) );
+    shift = _mm_or_si128( shift, _mm_and_si128( digit, _mm_set1_epi8( 4 ) ) );
+    shift = _mm_or_si128( shift, _mm_and_si128( plus, _mm_set1_epi8( 19 ) ) );
+    shift = _mm_or_si128( shift, _mm_and_si128( slash, _mm_set1_epi8( 16 ) ) );
+
+    const __m128i values = _mm_add_epi8( in, shift );
+
+    /*
+     *  Merge 4 x 6 bits into 3 bytes per 32 bit word, then compact the words
+     */
+    const __m128i merged = _mm_madd_epi16( _mm_maddubs_epi16( values, _mm_set1_epi32( 0x01400140 ) ), _mm_set1_epi32( 0x00011000 ) );
+    out = _mm_shuffle_epi8( merged, _mm_setr_epi8( 2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1 ) );
+
+    return true;
+}
+
+
+/*
+ *  Decode blocks of 16 characters (SSSE3), the output needs 4 bytes of slack
+ */
+SYSTRAYX_TARGET( "ssse3" )
+static int  decodeSsse3( const char* src, int len, char* dst )
+{
+    int pos = 0;
+
+    while( len - pos >= 16 )
+    {
+        __m128i out;
+        if( !decodeLane128( _mm_loadu_si128( reinterpret_cast< const __m128i* >( src + pos ) ), out ) )
+        {
+            break;
+        }
+
+        _mm_storeu_si128( reinterpret_cast< __m128i* >( dst ), out );
+
+        pos += 16;
+        dst += 12;
+    }
+
+    return pos;
+}
+
+
+/*
+ *  Encode blocks of 24 bytes (AVX2)
+ */
+SYSTRAYX_TARGET( "avx2" )
+static int  encodeAvx2( const char* src, int len, char* dst )
+{
+    int pos = 0;
+
+    const __m256i shuffle = _mm256_setr_epi8( 1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+                                              1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10 );
+    const __m256i offsets = _mm256_setr_epi8( 'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                              '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+                                              'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                              '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0 );
+
+    /*
+     *  The second lane load reads up to byte 28, 24 are used
+     */
+    while( len - pos >= 28 )
+    {
+        __m256i in = _mm256_inserti128_si256( _mm256_castsi128_si256( _mm_loadu_si128( reinterpret_cast< const __m128i* >( src + pos ) ) ),
+                                              _mm_loadu_si128( reinterpret_cast< const __m128i* >( src + pos + 12 ) ), 1 );
+
+        in = _mm256_shuffle_epi8( in, shuffle );
+
+        const __m256i t0 = _mm256_and_si256( in, _mm256_set1_epi32( 0x0fc0fc00 ) );
+        const __m256i t1 = _mm256_mulhi_epu16( t0, _mm256_set1_epi32( 0x04000040 ) );
+        const __m256i t2 = _mm256_and_si256( in, _mm256_set1_epi32( 0x003f03f0 ) );
+        const __m256i t3 = _mm256_mullo_epi16( t2, _mm256_set1_epi32( 0x01000010 ) );
+        const __m256i indices = _mm256_or_si256( t1, t3 );
+
+        __m256i range = _mm256_subs_epu8( indices, _mm256_set1_epi8( 51 ) );
+        const __m256i less = _mm256_cmpgt_epi8( _mm256_set1_epi8( 26 ), indices );
+        range = _mm256_or_si256( range, _mm256_and_si256( less, _mm256_set1_epi8( 13 ) ) );
+
+        _mm256_storeu_si256( reinterpret_cast< __m256i* >( dst ), _mm256_add_epi8( _mm256_shuffle_epi8( offsets, range ), indices ) );
+
+        pos += 24;
+        dst += 32;
+    }
+
+    return pos;
+}
+
+
+/*
+ *  Decode blocks of 32 characters (AVX2), the output needs 4 bytes of slack
+ */
+SYSTRAYX_TARGET( "avx2" )
+static int  decodeAvx2( const char* src, int len, char* dst )
+{
+    int pos = 0;
+
+    while( len - pos >= 32 )
+    {
+        const __m256i in = _mm256_loadu_si256( reinterpret_cast< const __m256i* >( src + pos ) );
+
+        const __m256i upper = _mm256_and_si256( _mm256_cmpgt_epi8( in, _mm256_set1_epi8( 'A' - 1 ) ), _mm256_cmpgt_epi8( _mm256_set1_epi8( 'Z' + 1 ), in ) );
+        const __m256i lower = _mm256_and_si256( _mm256_cmpgt_epi8( in, _mm256_set1_epi8( 'a' - 1 ) ), _mm256_cmpgt_epi8( _mm256_set1_epi8( 'z' + 1 ), in ) );
+        const __m256i digit = _mm256_and_si256( _mm256_cmpgt_epi8( in, _mm256_set1_epi8( '0' - 1 ) ), _mm256_cmpgt_epi8( _mm256_set1_epi8( '9' + 1 ), in ) );
+        const __m256i plus = _mm256_cmpeq_epi8( in, _mm256_set1_epi8( '+' ) );
+        const __m256i slash = _mm256_cmpeq_epi8( in, _mm256_set1_epi8( '/' ) );
+
+        const __m256i valid = _mm256_or_si256( _mm256_or_si256( upper, lower ), _mm256_or_si256( digit, _mm256_or_si256( plus, slash ) ) );
+        if( _mm256_movemask_epi8( valid ) != -1 )
+        {
+            break;
+        }
+
+        __m256i shift = _mm256_and_si256( upper, _mm256_set1_epi8( -65 ) );
+        shift = _mm256_or_si256( shift, _mm256_and_si256( lower, _mm256_set1_epi8( -71 ) ) );
+        shift = _mm256_or_si256( shift, _mm256_and_si256( digit, _mm256_set1_epi8( 4 ) ) );
+        shift = _mm256_or_si256( shift, _mm256_and_si256( plus, _mm256_set1_epi8( 19 ) ) );
+        shift = _mm256_or_si256( shift, _mm256_and_si256( slash, _mm256_set1_epi8( 16 ) ) );
+
+        const __m256i values = _mm256_add_epi8( in, shift );
+        const __m256i merged = _mm256_madd_epi16( _mm256_maddubs_epi16( values, _mm256_set1_epi32( 0x01400140 ) ), _mm256_set1_epi32( 0x00011000 ) );
+        const __m256i out = _mm256_shuffle_epi8( merged, _mm256_setr_epi8( 2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                                                           2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1 ) );
+
+        /*
+         *  12 bytes per lane, the second store overwrites the unused part of the first
+         */
+        _mm_storeu_si128( reinterpret_cast< __m128i* >( dst ), _mm256_castsi256_si128( out ) );
+        _mm_storeu_si128( reinterpret_cast< __m128i* >( dst + 12 ), _mm256_extracti128_si256( out, 1 ) );
+
+        pos += 32;
+        dst += 24;
+    }
+
+    return pos;
+}
+
+#endif
+
+
+/*
+ *  Encode data to base64
+ */
+QByteArray  SysTrayXBase64::encode( const QByteArray& data )
+{
+    return encode( data, m_impl );
+}
+
+
+/*
+ *  Encode data to base64 with an implementation
+ */
+QByteArray  SysTrayXBase64::encode( const QByteArray& data, Implementation impl )
+{
+    const int len = data.size();
+    const char* src = data.constData();
+
+    QByteArray result( ( len + 2 ) / 3 * 4, Qt::Uninitialized );
+    char* dst = result.data();
+
+    /*
+     *  Bulk with the vector kernels
+     */
+    int pos = 0;
+
+#ifdef SYSTRAYX_BASE64_X86
+    if( impl == IMPL_AVX2 )
+    {
+        pos = encodeAvx2( src, len, dst );
+    }
+    else if( impl == IMPL_SSSE3 )
+    {
+        pos = encodeSsse3( src, len, dst );
+    }
+#endif
+
+    dst += pos / 3 * 4;
+
+    /*
+     *  The tail
+     */
+    for( ; len - pos >= 3 ; pos += 3 )
+    {
+        quint32 triple = ( static_cast< quint8 >( src[ pos ] ) << 16 ) | ( static_cast< quint8 >( src[ pos + 1 ] ) << 8 ) | static_cast< quint8 >( src[ pos + 2 ] );
+
+        *dst++ = ENCODE_TABLE[ ( triple >> 18 ) & 0x3F ];
+        *dst++ = ENCODE_TABLE[ ( triple >> 12 ) & 0x3F ];
+        *dst++ = ENCODE_TABLE[ ( triple >> 6 ) & 0x3F ];
+        *dst++ = ENCODE_TABLE[ triple & 0x3F ];
+    }
+
+    if( len - pos > 0 )
+    {
+        quint32 triple = static_cast< quint8 >( src[ pos ] ) << 16;
+        if( len - pos > 1 )
+        {
+            triple |= static_cast< quint8 >( src[ pos + 1 ] ) << 8;
+        }
+
+        *dst++ = ENCODE_TABLE[ ( triple >> 18 ) & 0x3F ];
+        *dst++ = ENCODE_TABLE[ ( triple >> 12 ) & 0x3F ];
+        *dst++ = ( len - pos > 1 ) ? ENCODE_TABLE[ ( triple >> 6 ) & 0x3F ] : '=';
+        *dst++ = '=';
+    }
+
+    return result;
+}
+
+
+/*
+ *  Decode base64 text
+ */
+QByteArray  SysTrayXBase64::decode( const QByteArray& base64 )
+{
+    return decode( base64, m_impl );
+}
+
+
+/*
+ *  Decode base64 text with an implementation
+ */
+QByteArray  SysTrayXBase64::decode( const QByteArray& base64, Implementation impl )
+{
+    const int len = base64.size();
+    const char* src = base64.constData();
+
+    if( len % 4 != 0 )
+    {
+        return QByteArray::fromBase64( base64 );
+    }
+
+    /*
+     *  Room for the vector kernel slack
+     */
+    QByteArray result( len / 4 * 3 + 16, Qt::Uninitialized );
+    char* dst = result.data();
+
+    /*
+     *  Bulk with the vector kernels, the last quad may have padding
+     */
+    int pos = 0;
+    int body = len > 4 ? len - 4 : 0;
+
+#ifdef SYSTRAYX_BASE64_X86
+    if( impl == IMPL_AVX2 )
+    {
+        pos = decodeAvx2( src, body, dst );
+    }
+    else if( impl == IMPL_SSSE3 )
+    {
+        pos = decodeSsse3( src, body, dst );
+    }
+#endif
+
+    /*
+     *  The tail
+     */
+    int written = decodeScalar( src + pos, len - pos, dst + pos / 4 * 3 );
+    if( written < 0 )
+    {
+        /*
+         *  Not canonical, let Qt handle white space and other oddities
+         */
+        return QByteArray::fromBase64( base64 );
+    }
+
+    result.resize( pos / 4 * 3 + written );
+
+    return result;
+}
+
+
+/*
+ *  Decode canonical base64 text
+ */
+int SysTrayXBase64::decodeScalar( const char* src, int len, char* dst )
+{
+    const signed char* table = DECODE_TABLE.values;
+
+    char* start = dst;
+
+    for( int pos = 0 ; pos < len ; pos += 4 )
+    {
+        int a = table[ static_cast< quint8 >( src[ pos ] ) ];
+        int b = table[ static_cast< quint8 >( src[ pos + 1 ] ) ];
+        int c = table[ static_cast< quint8 >( src[ pos + 2 ] ) ];
+        int d = table[ static_cast< quint8 >( src[ pos + 3 ] ) ];
+
+        if( a < 0 || b < 0 )
+        {
+            return -1;
+        }
+
+        *dst++ = static_cast< char >( ( a << 2 ) | ( b >> 4 ) );
+
+        if( c < 0 || d < 0 )
+        {
+            /*
+             *  Padding, only in the last quad
+             */
+            if( pos + 4 != len || src[ pos + 3 ] != '=' || ( c < 0 && src[ pos + 2 ] != '=' ) )
+            {
+                return -1;
+            }
+
+            if( c >= 0 )
+            {
+                *dst++ = static_cast< char >( ( b << 4 ) | ( c >> 2 ) );
+            }
+
+            break;
+        }
+
+        *dst++ = static_cast< char >( ( b << 4 ) | ( c >> 2 ) );
+        *dst++ = static_cast< char >( ( c << 6 ) | d );
+    }
+
+    return static_cast< int >( dst - start );
+}
+
+
+/*
+ *  Get the implementation used on this CPU
+ */
+SysTrayXBase64::Implementation  SysTrayXBase64::getImplementation()
+{
+    return m_impl;
+}
+
+
+/*
+ *  Force an implementation
+ */
+void    SysTrayXBase64::setImplementation( Implementation impl )
+{
+    Implementation best = detect();
+
+    m_impl = impl > best ? best : impl;
+}
+
+
+/*
+ *  Get the best implementation supported by the CPU
+ */
+SysTrayXBase64::Implementation  SysTrayXBase64::detect()
+{
+#if defined( SYSTRAYX_BASE64_X86 ) && ( defined( __GNUC__ ) || defined( __clang__ ) )
+
+    __builtin_cpu_init();
+
+    if( __builtin_cpu_supports( "avx2" ) )
+    {
+        return IMPL_AVX2;
+    }
+
+    if( __builtin_cpu_supports( "ssse3" ) )
+    {
+        return IMPL_SSSE3;
+    }
+
+#elif defined( SYSTRAYX_BASE64_X86 ) && defined( _MSC_VER )
+
+    int info[ 4 ];
+    __cpuid( info, 0 );
+    int max_leaf = info[ 0 ];
+
+    __cpuid( info, 1 );
+    bool ssse3 = ( info[ 2 ] & ( 1 << 9 ) ) != 0;
+    bool osxsave = ( info[ 2 ] & ( 1 << 27 ) ) != 0;
+    bool avx = ( info[ 2 ] & ( 1 << 28 ) ) != 0;
+
+    if( max_leaf >= 7 && osxsave && avx && ( _xgetbv( 0 ) & 0x6 ) == 0x6 )
+    {
+        __cpuidex( info, 7, 0 );
+        if( info[ 1 ] & ( 1 << 5 ) )
+        {
+            return IMPL_AVX2;
+        }
+    }
+
+    if( ssse3 )
+    {
+        return IMPL_SSSE3;
+    }
+
+#endif
+
+    return IMPL_SCALAR;
+}
+
+
+/*
+ *  Compare the implementations with QByteArray
+ */
+QStringList SysTrayXBase64::benchmark()
+{
+    QStringList results;
+
+    Implementation best = detect();
+
+    results.append( QString( "Base64 benchmark, MB/s encode / decode (%1 available)" ).arg( IMPL_NAMES[ best ] ) );
+
+    const int sizes[] = { 4 * 1024, 16 * 1024, 64 * 1024, 256 * 1024, 1024 * 1024 };
+
+    for( int s = 0 ; s < static_cast< int >( sizeof( sizes ) / sizeof( sizes[ 0 ] ) ) ; ++s )
+    {
+        QByteArray data( sizes[ s ], Qt::Uninitialized );
+        for( int i = 0 ; i < data.size() ; ++i )
+        {
+            data[ i ] = static_cast< char >( ( i * 131 ) ^ ( i >> 7 ) );
+        }
+
+        /*
+         *  About 4 MB per measurement
+         */
+        const int iterations = qMax( 1, 4 * 1024 * 1024 / sizes[ s ] );
+        const double megabytes = static_cast< double >( sizes[ s ] ) * iterations / ( 1024 * 1024 );
+
+        QString line = QString( "%1 KB:" ).arg( sizes[ s ] / 1024 );
+        QByteArray reference = data.toBase64();
+
+        /*
+         *  Qt
+         */
+        QElapsedTimer timer;
+        timer.start();
+
+        for( int i = 0 ; i < iterations ; ++i )
+        {
+            reference = data.toBase64();
+        }
+
+        double enc_s = qMax( timer.nsecsElapsed(), Q_INT64_C( 1 ) ) / 1e9;
+
+        timer.restart();
+
+        QByteArray decoded;
+        for( int i = 0 ; i < iterations ; ++i )
+        {
+            decoded = QByteArray::fromBase64( reference );
+        }
+
+        double dec_s = qMax( timer.nsecsElapsed(), Q_INT64_C( 1 ) ) / 1e9;
+
+        line += QString( " qt %1 / %2" ).arg( megabytes / enc_s, 0, 'f', 0 ).arg( megabytes / dec_s, 0, 'f', 0 );
+
+        /*
+         *  Ours, every implementation the CPU supports
+         */
+        for( int impl = IMPL_SCALAR ; impl <= best ; ++impl )
+        {
+            QByteArray encoded;
+
+            timer.restart();
+
+            for( int i = 0 ; i < iterations ; ++i )
+            {
+                encoded = encode( data, static_cast< Implementation >( impl ) );
+            }
+
+            enc_s = qMax( timer.nsecsElapsed(), Q_INT64_C( 1 ) ) / 1e9;
+
+            timer.restart();
+
+            for( int i = 0 ; i < iterations ; ++i )
+            {
+                decoded = decode( encoded, static_cast< Implementation >( impl ) );
+            }
+
+            dec_s = qMax( timer.nsecsElapsed(), Q_INT64_C( 1 ) ) / 1e9;
+
+            line += QString( ", %1 %2 / %3%4" )
+                    .arg( IMPL_NAMES[ impl ] )
+                    .arg( megabytes / enc_s, 0, 'f', 0 )
+                    .arg( megabytes / dec_s, 0, 'f', 0 )
+                    .arg( encoded == reference && decoded == data ? "" : " (MISMATCH)" );
+        }
+
+        results.append( line );
+    }
+
+    return results;
+}
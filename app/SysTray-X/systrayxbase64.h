@@ -0,0 +1,132 @@
+#ifndef SYSTRAYXBASE64_H
+#define SYSTRAYXBASE64_H
+
+/*
+ *	Local includes
+ */
+
+/*
+ *	Qt includes
+ */
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+
+/**
+ * @brief The SysTrayXBase64 class. Base64 codec for the icon payloads.
+ *
+ *  Works on raw bytes. Uses SSSE3 or AVX2 kernels when the CPU has them (checked at runtime),
+ *  the scalar code handles the tails and other CPUs.
+ */
+class SysTrayXBase64
+{
+    public:
+
+        /*
+         *  Implementations
+         */
+        enum Implementation
+        {
+            IMPL_SCALAR = 0,
+            IMPL_SSSE3,
+            IMPL_AVX2
+        };
+
+    public:
+
+        /**
+         * @brief encode. Encode data to base64.
+         *
+         *  @param data     The data.
+         *
+         *  @return     The base64 text.
+         */
+        static QByteArray   encode( const QByteArray& data );
+
+        /**
+         * @brief decode. Decode base64 text.
+         *
+         *  Unpadded or non-canonical input is handled like QByteArray::fromBase64().
+         *
+         *  @param base64   The base64 text.
+         *
+         *  @return     The data.
+         */
+        static QByteArray   decode( const QByteArray& base64 );
+
+        /**
+         * @brief getImplementation. Get the implementation used on this CPU.
+         *
+         *  @return     The implementation.
+         */
+        static Implementation   getImplementation();
+
+        /**
+         * @brief setImplementation. Force an implementation, limited to what the CPU supports.
+         *
+         *  @param impl     The implementation.
+         */
+        static void setImplementation( Implementation impl );
+
+        /**
+         * @brief benchmark. Compare the implementations with QByteArray for 4 KB - 1 MB icons.
+         *
+         *  Leaves the implementation in use alone, safe to run next to the link threads.
+         *
+         *  @return     The results.
+         */
+        static QStringList  benchmark();
+
+    private:
+
+        /**
+         * @brief IMPL_NAMES. The implementation names.
+         */
+        static const char* const    IMPL_NAMES[];
+
+        /**
+         * @brief encode. Encode data to base64 with an implementation.
+         *
+         *  @param data     The data.
+         *  @param impl     The implementation.
+         *
+         *  @return     The base64 text.
+         */
+        static QByteArray   encode( const QByteArray& data, Implementation impl );
+
+        /**
+         * @brief decode. Decode base64 text with an implementation.
+         *
+         *  @param base64   The base64 text.
+         *  @param impl     The implementation.
+         *
+         *  @return     The data.
+         */
+        static QByteArray   decode( const QByteArray& base64, Implementation impl );
+
+        /**
+         * @brief detect. Get the best implementation supported by the CPU.
+         *
+         *  @return     The implementation.
+         */
+        static Implementation   detect();
+
+        /**
+         * @brief decodeScalar. Decode canonical base64 text.
+         *
+         *  @param src      The text.
+         *  @param len      The text length.
+         *  @param dst      Storage for the data.
+         *
+         *  @return     Number of bytes written, -1 for non-canonical input.
+         */
+        static int  decodeScalar( const char* src, int len, char* dst );
+
+        /**
+         * @brief m_impl. The implementation in use.
+         */
+        static Implementation   m_impl;
+};
+
+#endif // SYSTRAYXBASE64_H
@@ -0,0 +1,1244 @@
+#include "systrayxdaemon.h"
+
+/*
+ *	Local includes
+ */
+#include "preferences.h"
+#include "systrayxbase64.h"
+#include "systrayxlink.h"
+#include "systrayxlinkdecoder.h"
+#include "systrayxlinktransport.h"
+#include "windowctrl.h"
+
+/*
+ *  System includes
+ */
+#include <cstdlib>
+#include <cstring>
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#endif
+
+/*
+ *	Qt includes
+ */
+#include <QTimer>
+#include <QByteArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QLockFile>
+#include <QSocketNotifier>
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+#include <QCborValue>
+#include <QCborMap>
+#endif
+
+/*
+ *  Constants
+ */
+const char* const   SysTrayXDaemon::DAEMON_ARGUMENT = "--daemon";
+const char* const   SysTrayXDaemon::DAEMON_ENV = "SYSTRAY_X_DAEMON";
+
+#ifdef Q_OS_UNIX
+
+/*
+ *  Write all data
+ */
+static bool writeFully( int fd, const char* data, ssize_t len )
+{
+    while( len > 0 )
+    {
+        ssize_t count = ::write( fd, data, static_cast< size_t >( len ) );
+
+        if( count < 0 )
+        {
+            if( errno == EINTR )
+            {
+                continue;
+            }
+
+            return false;
+        }
+
+        data += count;
+        len -= count;
+    }
+
+    return true;
+}
+
+
+/*
+ *  Check the other end of a socket runs as our user
+ */
+static bool isPeerUser( int fd )
+{
+#ifdef SO_PEERCRED
+    struct ucred cred;
+    socklen_t cred_len = sizeof( cred );
+
+    if( ::getsockopt( fd, SOL_SOCKET, SO_PEERCRED, &cred, &cred_len ) < 0 || cred_len != sizeof( cred ) )
+    {
+        return false;
+    }
+
+    return cred.uid == ::getuid();
+#else
+    uid_t uid;
+    gid_t gid;
+
+    if( ::getpeereid( fd, &uid, &gid ) < 0 )
+    {
+        return false;
+    }
+
+    return uid == ::getuid();
+#endif
+}
+
+
+/*
+ *  Connect to the daemon socket
+ */
+static int connectDaemon( const QByteArray& path )
+{
+    struct sockaddr_un addr;
+    if( static_cast< size_t >( path.length() ) >= sizeof( addr.sun_path ) )
+    {
+        return -1;
+    }
+
+    int fd = ::socket( AF_UNIX, SOCK_STREAM, 0 );
+    if( fd < 0 )
+    {
+        return -1;
+    }
+
+    memset( &addr, 0, sizeof( addr ) );
+    addr.sun_family = AF_UNIX;
+    memcpy( addr.sun_path, path.constData(), static_cast< size_t >( path.length() ) );
+
+    if( ::connect( fd, reinterpret_cast< struct sockaddr* >( &addr ), sizeof( addr ) ) < 0 )
+    {
+        ::close( fd );
+        return -1;
+    }
+
+    /*
+     *  Never forward the link to a daemon of another user
+     */
+    if( !isPeerUser( fd ) )
+    {
+        ::close( fd );
+        return -1;
+    }
+
+    return fd;
+}
+
+
+/*
+ *  Read until a buffer holds a complete frame
+ */
+static bool waitForFrame( int fd, QByteArray& buffer, int timeout )
+{
+    const int header_len = static_cast< int >( sizeof( qint32 ) );
+
+    QElapsedTimer timer;
+    timer.start();
+
+    forever
+    {
+        if( buffer.length() >= header_len )
+        {
+            qint32 len;
+            memcpy( &len, buffer.constData(), sizeof( qint32 ) );
+
+            if( len <= 0 || buffer.length() >= header_len + len )
+            {
+                return true;
+            }
+        }
+
+        struct pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+
+        int remaining = timeout - static_cast< int >( timer.elapsed() );
+        if( remaining <= 0 || ::poll( &pfd, 1, remaining ) == 0 )
+        {
+            return false;
+        }
+
+        char data[ 4096 ];
+        ssize_t count = ::read( fd, data, sizeof( data ) );
+
+        if( count > 0 )
+        {
+            buffer.append( data, static_cast< int >( count ) );
+        }
+        else
+        if( count == 0 || errno != EINTR )
+        {
+            return false;
+        }
+    }
+}
+
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+
+/*
+ *  Convert a CBOR value to JSON, byte strings become standard base64
+ */
+static QJsonValue cborToJson( const QCborValue& value )
+{
+    if( value.isByteArray() )
+    {
+        return QString::fromLatin1( SysTrayXBase64::encode( value.toByteArray() ) );
+    }
+
+    if( value.isMap() )
+    {
+        QJsonObject object;
+
+        const QCborMap map = value.toMap();
+        for( QCborMap::ConstIterator it = map.constBegin() ; it != map.constEnd() ; ++it )
+        {
+            object.insert( it.key().toString(), cborToJson( it.value() ) );
+        }
+
+        return object;
+    }
+
+    return value.toJsonValue();
+}
+
+#endif
+
+
+/*
+ *  Convert a preferences frame of the add-on to CBOR, the icon becomes a byte string
+ */
+static QByteArray   toCborFrame( const QByteArray& frame )
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+    if( !frame.startsWith( "{\"preferences\"" ) )
+    {
+        return frame;
+    }
+
+    QJsonObject message = QJsonDocument::fromJson( frame ).object();
+    if( message.size() != 1 || !message.value( "preferences" ).isObject() )
+    {
+        return frame;
+    }
+
+    QCborMap pref;
+
+    const QJsonObject json_pref = message.value( "preferences" ).toObject();
+    for( QJsonObject::ConstIterator it = json_pref.constBegin() ; it != json_pref.constEnd() ; ++it )
+    {
+        if( it.key() == "icon" && it.value().isString() )
+        {
+            pref.insert( it.key(), SysTrayXBase64::decode( it.value().toString().toLatin1() ) );
+        }
+        else
+        {
+            pref.insert( it.key(), QCborValue::fromJsonValue( it.value() ) );
+        }
+    }
+
+    QCborMap cbor_message;
+    cbor_message.insert( QString( "preferences" ), pref );
+
+    return QCborValue( cbor_message ).toCbor();
+#else
+    return frame;
+#endif
+}
+
+
+/*
+ *  Convert a CBOR frame of the daemon to JSON, the add-on only understands JSON
+ */
+static QByteArray   toJsonFrame( const QByteArray& frame )
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+    if( frame.isEmpty() || !SysTrayXLinkDecoder::isCbor( frame.at( 0 ) ) )
+    {
+        return frame;
+    }
+
+    QJsonValue message = cborToJson( QCborValue::fromCbor( frame ) );
+    if( !message.isObject() )
+    {
+        return frame;
+    }
+
+    return QJsonDocument( message.toObject() ).toJson( QJsonDocument::Compact );
+#else
+    return frame;
+#endif
+}
+
+
+/*
+ *  Relay the complete frames of a buffer, converting them on the way
+ */
+static bool relayFrames( int fd, QByteArray& buffer, QByteArray (*convert)( const QByteArray& ), bool& framing )
+{
+    const int header_len = static_cast< int >( sizeof( qint32 ) );
+
+    while( framing && buffer.length() >= header_len )
+    {
+        qint32 len;
+        memcpy( &len, buffer.constData(), sizeof( qint32 ) );
+
+        if( len <= 0 || len > SysTrayXLinkRingBuffer::DEFAULT_MAX_FRAME_SIZE )
+        {
+            /*
+             *  Lost the frame boundaries, relay the bytes as they are, the link resyncs
+             */
+            framing = false;
+            break;
+        }
+
+        if( buffer.length() < header_len + len )
+        {
+            return true;
+        }
+
+        QByteArray frame = convert( buffer.mid( header_len, len ) );
+        qint32 frame_len = frame.length();
+
+        if( !writeFully( fd, reinterpret_cast< const char* >( &frame_len ), sizeof( qint32 ) ) ||
+            !writeFully( fd, frame.constData(), frame_len ) )
+        {
+            return false;
+        }
+
+        buffer.remove( 0, header_len + len );
+    }
+
+    if( !framing && !buffer.isEmpty() )
+    {
+        if( !writeFully( fd, buffer.constData(), buffer.length() ) )
+        {
+            return false;
+        }
+
+        buffer.clear();
+    }
+
+    return true;
+}
+
+
+/*
+ *  Start the daemon, detached from Thunderbird and its pipes
+ */
+static void spawnDaemon( const char* program )
+{
+    pid_t pid = ::fork();
+    if( pid < 0 )
+    {
+        return;
+    }
+
+    if( pid == 0 )
+    {
+        ::setsid();
+
+        if( ::fork() == 0 )
+        {
+            int null_fd = ::open( "/dev/null", O_RDWR );
+            if( null_fd >= 0 )
+            {
+                ::dup2( null_fd, STDIN_FILENO );
+                ::dup2( null_fd, STDOUT_FILENO );
+
+                if( null_fd > STDERR_FILENO )
+                {
+                    ::close( null_fd );
+                }
+            }
+
+            ::execl( program, program, SysTrayXDaemon::DAEMON_ARGUMENT, static_cast< char* >( nullptr ) );
+        }
+
+        ::_exit( 0 );
+    }
+
+    ::waitpid( pid, nullptr, 0 );
+}
+
+#endif
+
+
+/*
+ *	Constructor
+ */
+SysTrayXDaemon::SysTrayXDaemon( Preferences* pref, QObject* parent ) : QLocalServer( parent )
+{
+    /*
+     *  Store preferences
+     */
+    m_pref = pref;
+
+    /*
+     *  Initialize
+     */
+    m_unread_mail = 0;
+    m_link_state = SysTrayXLink::LINK_CONNECTING;
+    m_lock_file = nullptr;
+
+    /*
+     *  Quit when no profile shows up, or the last one is gone for a while
+     */
+    m_linger_timer = new QTimer( this );
+    m_linger_timer->setSingleShot( true );
+    m_linger_timer->setInterval( LINGER_TIME );
+    connect( m_linger_timer, &QTimer::timeout, this, &SysTrayXDaemon::signalAllProfilesClosed );
+
+    /*
+     *  Drop the stubs that connect but never send their profile frame
+     */
+    m_stub_timer = new QTimer( this );
+    m_stub_timer->setInterval( PROFILE_TIMEOUT );
+    connect( m_stub_timer, &QTimer::timeout, this, &SysTrayXDaemon::slotStubTimeout );
+}
+
+
+/*
+ *	Destructor
+ */
+SysTrayXDaemon::~SysTrayXDaemon()
+{
+    /*
+     *  Cleanup
+     */
+    foreach( const Profile& profile, m_profiles )
+    {
+        delete profile.link;
+        delete profile.win_ctrl;
+    }
+
+    while( !m_stubs.isEmpty() )
+    {
+        removeStub( 0, true );
+    }
+
+    /*
+     *  Stop listening before the next daemon may take over the socket
+     */
+    close();
+    delete m_lock_file;
+}
+
+
+/*
+ *	Daemon mode enabled?
+ */
+bool    SysTrayXDaemon::isEnabled()
+{
+#ifdef Q_OS_UNIX
+    const char* value = std::getenv( DAEMON_ENV );
+
+    return value != nullptr && QByteArray( value ) == "1";
+#else
+    return false;
+#endif
+}
+
+
+/*
+ *	Get the path of the daemon socket
+ */
+QString SysTrayXDaemon::socketPath()
+{
+#ifdef Q_OS_UNIX
+    /*
+     *  Only in a runtime directory private to the user, a shared directory like /tmp
+     *  would let another user take the name first
+     */
+    QByteArray runtime_dir = qgetenv( "XDG_RUNTIME_DIR" );
+    if( runtime_dir.isEmpty() )
+    {
+        return QString();
+    }
+
+    struct stat info;
+    if( ::stat( runtime_dir.constData(), &info ) < 0 || !S_ISDIR( info.st_mode ) ||
+        info.st_uid != ::getuid() || ( info.st_mode & ( S_IRWXG | S_IRWXO ) ) != 0 )
+    {
+        return QString();
+    }
+
+    return QString::fromLocal8Bit( runtime_dir ) + "/SysTray-X.socket";
+#else
+    return QString( "SysTray-X" );
+#endif
+}
+
+
+/*
+ *	Forward the native messaging link to the daemon
+ */
+int SysTrayXDaemon::runStub( const char* program )
+{
+#ifdef Q_OS_UNIX
+    QByteArray path = socketPath().toLocal8Bit();
+    if( path.isEmpty() )
+    {
+        return -1;
+    }
+
+    int fd = connectDaemon( path );
+    if( fd < 0 )
+    {
+        /*
+         *  First profile, start the daemon and wait for it
+         */
+        spawnDaemon( program );
+
+        for( int waited = 0 ; fd < 0 && waited < CONNECT_TIMEOUT ; waited += 50 )
+        {
+            ::usleep( 50000 );
+            fd = connectDaemon( path );
+        }
+
+        if( fd < 0 )
+        {
+            return -1;
+        }
+    }
+
+    signal( SIGPIPE, SIG_IGN );
+
+    /*
+     *  Tell the daemon which Thunderbird we belong to, offer CBOR frames
+     */
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+    bool binary_offer = true;
+#else
+    bool binary_offer = false;
+#endif
+
+    QByteArray profile = QString( "{\"profile\":{\"pid\":%1,\"binary\":%2}}" )
+                         .arg( ::getppid() ).arg( binary_offer ? "true" : "false" ).toUtf8();
+    qint32 profile_len = profile.length();
+
+    if( !writeFully( fd, reinterpret_cast< const char* >( &profile_len ), sizeof( qint32 ) ) ||
+        !writeFully( fd, profile.constData(), profile_len ) )
+    {
+        ::close( fd );
+        return -1;
+    }
+
+    /*
+     *  The daemon answers the offer, an older daemon starts the link right away
+     */
+    QByteArray from_daemon;
+    QByteArray from_addon;
+    bool binary = false;
+
+    if( binary_offer && waitForFrame( fd, from_daemon, CONNECT_TIMEOUT ) )
+    {
+        const int header_len = static_cast< int >( sizeof( qint32 ) );
+
+        qint32 len;
+        memcpy( &len, from_daemon.constData(), sizeof( qint32 ) );
+
+        QByteArray frame = from_daemon.mid( header_len, len );
+        if( frame.startsWith( "{\"profileAck\"" ) )
+        {
+            binary = QJsonDocument::fromJson( frame ).object().value( "profileAck" ).toObject().value( "binary" ).toBool();
+            from_daemon.remove( 0, header_len + len );
+        }
+    }
+
+    /*
+     *  Relay the bytes as they are, the frames are handled by the daemon. With CBOR the
+     *  preferences frames are converted, the add-on only speaks JSON.
+     */
+    bool addon_framing = binary;
+    bool daemon_framing = binary;
+
+    if( !relayFrames( STDOUT_FILENO, from_daemon, toJsonFrame, daemon_framing ) )
+    {
+        ::close( fd );
+        return 0;
+    }
+
+    struct pollfd pfd[ 2 ];
+    pfd[ 0 ].fd = STDIN_FILENO;
+    pfd[ 0 ].events = POLLIN;
+    pfd[ 1 ].fd = fd;
+    pfd[ 1 ].events = POLLIN;
+
+    char buffer[ 64 * 1024 ];
+
+    forever
+    {
+        pfd[ 0 ].revents = 0;
+        pfd[ 1 ].revents = 0;
+
+        if( ::poll( pfd, 2, -1 ) < 0 )
+        {
+            if( errno == EINTR )
+            {
+                continue;
+            }
+            break;
+        }
+
+        if( pfd[ 0 ].revents )
+        {
+            ssize_t len = ::read( STDIN_FILENO, buffer, sizeof( buffer ) );
+
+            if( len > 0 )
+            {
+                bool written;
+                if( addon_framing )
+                {
+                    from_addon.append( buffer, static_cast< int >( len ) );
+                    written = relayFrames( fd, from_addon, toCborFrame, addon_framing );
+                }
+                else
+                {
+                    written = writeFully( fd, buffer, len );
+                }
+
+                if( !written )
+                {
+                    break;
+                }
+            }
+            else
+            if( len == 0 || errno != EINTR )
+            {
+                /*
+                 *  Thunderbird is gone, let the daemon drop the profile
+                 */
+                ::shutdown( fd, SHUT_WR );
+                pfd[ 0 ].fd = -1;
+            }
+        }
+
+        if( pfd[ 1 ].revents )
+        {
+            ssize_t len = ::read( fd, buffer, sizeof( buffer ) );
+
+            if( len > 0 )
+            {
+                bool written;
+                if( daemon_framing )
+                {
+                    from_daemon.append( buffer, static_cast< int >( len ) );
+                    written = relayFrames( STDOUT_FILENO, from_daemon, toJsonFrame, daemon_framing );
+                }
+                else
+                {
+                    written = writeFully( STDOUT_FILENO, buffer, len );
+                }
+
+                if( !written )
+                {
+                    break;
+                }
+            }
+            else
+            if( len == 0 || errno != EINTR )
+            {
+                break;
+            }
+        }
+    }
+
+    ::close( fd );
+
+    return 0;
+#else
+    Q_UNUSED( program )
+
+    return -1;
+#endif
+}
+
+
+/*
+ *	Start listening for stubs
+ */
+bool    SysTrayXDaemon::start()
+{
+    QString path = socketPath();
+    if( path.isEmpty() )
+    {
+        return false;
+    }
+
+    /*
+     *  Only one daemon, the lock of a crashed daemon is stale and taken over
+     */
+    m_lock_file = new QLockFile( path + ".lock" );
+    if( !m_lock_file->tryLock( 0 ) )
+    {
+        delete m_lock_file;
+        m_lock_file = nullptr;
+
+        return false;
+    }
+
+    /*
+     *  Remove a socket left by a crashed daemon, safe while holding the lock
+     */
+    QLocalServer::removeServer( path );
+    setSocketOptions( QLocalServer::UserAccessOption );
+
+    if( !listen( path ) )
+    {
+        return false;
+    }
+
+    m_linger_timer->start();
+
+    return true;
+}
+
+
+/*
+ *	Get the number of connected profiles
+ */
+int SysTrayXDaemon::getProfileCount() const
+{
+    return m_profiles.length();
+}
+
+
+/*
+ *	Get the total number of unread mails
+ */
+int SysTrayXDaemon::getUnreadMail() const
+{
+    return m_unread_mail;
+}
+
+
+/*
+ *	Handle a new stub
+ */
+void    SysTrayXDaemon::incomingConnection( quintptr socket_descriptor )
+{
+#ifdef Q_OS_UNIX
+    int fd = static_cast< int >( socket_descriptor );
+
+    if( !isPeerUser( fd ) )
+    {
+        ::close( fd );
+        return;
+    }
+
+    /*
+     *  Wait for the profile frame without blocking the GUI thread
+     */
+    int flags = fcntl( fd, F_GETFL );
+    fcntl( fd, F_SETFL, flags | O_NONBLOCK );
+
+    Stub stub;
+    stub.fd = fd;
+    stub.connected.start();
+
+    /*
+     *  (String based connect, the activated signal is overloaded in Qt 5.15)
+     */
+    stub.notifier = new QSocketNotifier( fd, QSocketNotifier::Read, this );
+    connect( stub.notifier, SIGNAL( activated( int ) ), this, SLOT( slotStubReadyRead( int ) ) );
+    stub.notifier->setEnabled( true );
+
+    m_stubs.append( stub );
+
+    if( !m_stub_timer->isActive() )
+    {
+        m_stub_timer->start();
+    }
+#else
+    Q_UNUSED( socket_descriptor )
+#endif
+}
+
+
+/*
+ *	Read the available part of the profile frame of a stub
+ */
+bool    SysTrayXDaemon::readProfile( Stub& stub, qint64& tb_pid, bool& binary_offer )
+{
+#ifdef Q_OS_UNIX
+    tb_pid = 0;
+    binary_offer = false;
+
+    forever
+    {
+        /*
+         *  The header first, then exactly the frame
+         */
+        int wanted = stub.frame_len == 0 ? static_cast< int >( sizeof( qint32 ) ) : stub.frame_len;
+        int offset = stub.data.length();
+
+        if( offset == wanted )
+        {
+            if( stub.frame_len != 0 )
+            {
+                break;
+            }
+
+            qint32 len = 0;
+            memcpy( &len, stub.data.constData(), sizeof( qint32 ) );
+
+            if( len <= 0 || len > MAX_PROFILE_SIZE )
+            {
+                return false;
+            }
+
+            stub.frame_len = len;
+            stub.data.clear();
+            continue;
+        }
+
+        stub.data.resize( wanted );
+        ssize_t count = ::read( stub.fd, stub.data.data() + offset, static_cast< size_t >( wanted - offset ) );
+
+        if( count > 0 )
+        {
+            stub.data.resize( offset + static_cast< int >( count ) );
+            continue;
+        }
+
+        stub.data.resize( offset );
+
+        if( count < 0 && errno == EINTR )
+        {
+            continue;
+        }
+
+        /*
+         *  Wait for the rest, or the stub is gone
+         */
+        return count < 0 && ( errno == EAGAIN || errno == EWOULDBLOCK );
+    }
+
+    QJsonObject profile = QJsonDocument::fromJson( stub.data ).object().value( "profile" ).toObject();
+    tb_pid = static_cast< qint64 >( profile.value( "pid" ).toDouble() );
+    binary_offer = profile.value( "binary" ).toBool();
+
+    return tb_pid > 0;
+#else
+    Q_UNUSED( stub )
+    Q_UNUSED( tb_pid )
+    Q_UNUSED( binary_offer )
+
+    return false;
+#endif
+}
+
+
+/*
+ *	Setup the link and window control of a profile
+ */
+void    SysTrayXDaemon::addProfile( int fd, qint64 tb_pid, bool binary_offer )
+{
+#ifdef Q_OS_UNIX
+    /*
+     *  Answer the CBOR offer of the stub before the link starts, older stubs do not expect it
+     */
+    bool binary = false;
+
+    if( binary_offer )
+    {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+        binary = true;
+#endif
+
+        QByteArray ack = QString( "{\"profileAck\":{\"binary\":%1}}" ).arg( binary ? "true" : "false" ).toUtf8();
+        qint32 ack_len = ack.length();
+
+        if( !writeFully( fd, reinterpret_cast< const char* >( &ack_len ), sizeof( qint32 ) ) ||
+            !writeFully( fd, ack.constData(), ack_len ) )
+        {
+            ::close( fd );
+            return;
+        }
+    }
+
+    Profile profile;
+    profile.tb_pid = tb_pid;
+    profile.link = new SysTrayXLink( m_pref, new SysTrayXLinkSocketTransport( fd, binary ) );
+    profile.win_ctrl = new WindowCtrl( m_pref, profile.tb_pid );
+
+    connect( profile.link, &SysTrayXLink::signalUnreadMail, this, &SysTrayXDaemon::slotProfileUnreadMail );
+    connect( profile.link, &SysTrayXLink::signalLinkState, this, &SysTrayXDaemon::slotProfileLinkState );
+    connect( profile.link, &SysTrayXLink::signalAccountUnread, this, &SysTrayXDaemon::slotProfileAccountUnread );
+    connect( profile.link, &SysTrayXLink::signalAddOnShutdown, this, &SysTrayXDaemon::slotProfileClosed );
+    connect( profile.link, &SysTrayXLink::signalConsole, this, &SysTrayXDaemon::signalConsole );
+    connect( profile.link, &SysTrayXLink::signalWindowState, profile.win_ctrl, &WindowCtrl::slotWindowState );
+    connect( profile.link, &SysTrayXLink::signalTitle, profile.win_ctrl, &WindowCtrl::slotWindowTitle );
+
+    connect( profile.win_ctrl, &WindowCtrl::signalConsole, this, &SysTrayXDaemon::signalConsole );
+    connect( profile.win_ctrl, &WindowCtrl::signalWindowNormal, profile.link, &SysTrayXLink::slotWindowNormal );
+    connect( profile.win_ctrl, &WindowCtrl::signalWindowMinimize, profile.link, &SysTrayXLink::slotWindowMinimize );
+    connect( profile.win_ctrl, &WindowCtrl::signalPollInterval, profile.link, &SysTrayXLink::slotPollInterval );
+
+    connect( m_pref, &Preferences::signalPreferencesChange, profile.win_ctrl, &WindowCtrl::slotPreferencesChange );
+    connect( m_pref, &Preferences::signalPreferencesChange, profile.link, &SysTrayXLink::slotPreferencesChange );
+
+    m_profiles.append( profile );
+    m_linger_timer->stop();
+
+    emit signalConsole( QString( "Daemon: profile of Thunderbird %1 connected%2" )
+                        .arg( profile.tb_pid ).arg( binary ? ", cbor framing" : "" ) );
+
+    /*
+     *  Start the handshake, the add-on answers with its preferences
+     */
+    profile.link->sendHello();
+#else
+    Q_UNUSED( fd )
+    Q_UNUSED( tb_pid )
+    Q_UNUSED( binary_offer )
+#endif
+}
+
+
+/*
+ *	Stop waiting for a stub
+ */
+void    SysTrayXDaemon::removeStub( int index, bool close_fd )
+{
+    Stub stub = m_stubs.takeAt( index );
+
+    /*
+     *  Still in a signal of the notifier
+     */
+    stub.notifier->setEnabled( false );
+    stub.notifier->deleteLater();
+
+#ifdef Q_OS_UNIX
+    if( close_fd )
+    {
+        ::close( stub.fd );
+    }
+#else
+    Q_UNUSED( close_fd )
+#endif
+
+    if( m_stubs.isEmpty() )
+    {
+        m_stub_timer->stop();
+    }
+}
+
+
+/*
+ *	Find the profile of a link
+ */
+int SysTrayXDaemon::findProfile( QObject* link ) const
+{
+    for( int i = 0 ; i < m_profiles.length() ; ++i )
+    {
+        if( m_profiles.at( i ).link == link )
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+
+/*
+ *	Signal a changed total of unread mails
+ */
+void    SysTrayXDaemon::updateUnreadMail()
+{
+    int unread_mail = 0;
+    foreach( const Profile& profile, m_profiles )
+    {
+        unread_mail += profile.unread_mail;
+    }
+
+    if( unread_mail != m_unread_mail )
+    {
+        m_unread_mail = unread_mail;
+
+        emit signalUnreadMail( m_unread_mail );
+    }
+}
+
+
+/*
+ *	Signal a changed worst link state
+ */
+void    SysTrayXDaemon::updateLinkState()
+{
+    /*
+     *  A link going down is removed with its profile
+     */
+    SysTrayXLink::LinkState link_state = SysTrayXLink::LINK_CONNECTING;
+    foreach( const Profile& profile, m_profiles )
+    {
+        if( profile.link_state != SysTrayXLink::LINK_DOWN && profile.link_state > link_state )
+        {
+            link_state = profile.link_state;
+        }
+    }
+
+    if( link_state != m_link_state )
+    {
+        m_link_state = link_state;
+
+        emit signalLinkState( m_link_state );
+    }
+}
+
+
+/*
+ *	Signal the unread mails per account of all profiles
+ */
+void    SysTrayXDaemon::updateAccountUnread()
+{
+    /*
+     *  Accounts with the same name in several profiles are added up
+     */
+    QMap< QString, int > accounts;
+    foreach( const Profile& profile, m_profiles )
+    {
+        for( QMap< QString, int >::const_iterator it = profile.accounts.constBegin() ; it != profile.accounts.constEnd() ; ++it )
+        {
+            accounts[ it.key() ] += it.value();
+        }
+    }
+
+    emit signalAccountUnread( accounts );
+}
+
+
+/*
+ *	Show / hide the windows of all profiles
+ */
+void    SysTrayXDaemon::slotShowHide()
+{
+    foreach( const Profile& profile, m_profiles )
+    {
+        profile.win_ctrl->slotShowHide();
+    }
+}
+
+
+/*
+ *	Close the windows of all profiles
+ */
+void    SysTrayXDaemon::slotClose()
+{
+    foreach( const Profile& profile, m_profiles )
+    {
+        profile.win_ctrl->slotClose();
+    }
+}
+
+
+/*
+ *	Show the profiles
+ */
+void    SysTrayXDaemon::slotStatistics()
+{
+    emit signalConsole( QString( "Daemon: %1 profiles, %2 unread mails" ).arg( m_profiles.length() ).arg( m_unread_mail ) );
+
+    foreach( const Profile& profile, m_profiles )
+    {
+        emit signalConsole( QString( "Daemon: Thunderbird %1, %2 unread mails" ).arg( profile.tb_pid ).arg( profile.unread_mail ) );
+
+        profile.link->slotStatistics();
+    }
+}
+
+
+/*
+ *	Run the link benchmarks
+ */
+void    SysTrayXDaemon::slotBenchmark()
+{
+    /*
+     *  The benchmarks do not depend on the profile, run them once
+     */
+    if( m_profiles.isEmpty() )
+    {
+        emit signalConsole( "Daemon: no profile connected, no link to benchmark" );
+        return;
+    }
+
+    m_profiles.first().link->slotBenchmark();
+}
+
+
+/*
+ *	Run the window search benchmark
+ */
+void    SysTrayXDaemon::slotWindowBenchmark()
+{
+    foreach( const Profile& profile, m_profiles )
+    {
+        emit signalConsole( QString( "Daemon: Thunderbird %1" ).arg( profile.tb_pid ) );
+
+        profile.win_ctrl->slotWindowTest3();
+    }
+}
+
+
+/*
+ *	Handle the unread mails of a profile
+ */
+void    SysTrayXDaemon::slotProfileUnreadMail( int unread_mail )
+{
+    int index = findProfile( sender() );
+    if( index < 0 )
+    {
+        return;
+    }
+
+    m_profiles[ index ].unread_mail = unread_mail;
+
+    updateUnreadMail();
+}
+
+
+/*
+ *	Handle the link state of a profile
+ */
+void    SysTrayXDaemon::slotProfileLinkState( SysTrayXLink::LinkState state )
+{
+    int index = findProfile( sender() );
+    if( index < 0 )
+    {
+        return;
+    }
+
+    m_profiles[ index ].link_state = state;
+
+    updateLinkState();
+}
+
+
+/*
+ *	Handle the unread mails per account of a profile
+ */
+void    SysTrayXDaemon::slotProfileAccountUnread( const QMap< QString, int >& accounts )
+{
+    int index = findProfile( sender() );
+    if( index < 0 )
+    {
+        return;
+    }
+
+    m_profiles[ index ].accounts = accounts;
+
+    updateAccountUnread();
+}
+
+
+/*
+ *	Handle the end of a profile link
+ */
+void    SysTrayXDaemon::slotProfileClosed()
+{
+    int index = findProfile( sender() );
+    if( index < 0 )
+    {
+        return;
+    }
+
+    Profile profile = m_profiles.takeAt( index );
+
+    emit signalConsole( QString( "Daemon: profile of Thunderbird %1 closed" ).arg( profile.tb_pid ) );
+
+    /*
+     *  Still in a signal of the link
+     */
+    profile.link->deleteLater();
+    profile.win_ctrl->deleteLater();
+
+    updateUnreadMail();
+    updateLinkState();
+
+    if( !profile.accounts.isEmpty() )
+    {
+        updateAccountUnread();
+    }
+
+    if( m_profiles.isEmpty() )
+    {
+        m_linger_timer->start();
+    }
+}
+
+
+/*
+ *	Read the profile frame of a stub
+ */
+void    SysTrayXDaemon::slotStubReadyRead( int fd )
+{
+    int index = -1;
+    for( int i = 0 ; i < m_stubs.length() ; ++i )
+    {
+        if( m_stubs.at( i ).fd == fd )
+        {
+            index = i;
+            break;
+        }
+    }
+
+    if( index < 0 )
+    {
+        return;
+    }
+
+    qint64 tb_pid = 0;
+    bool binary_offer = false;
+    if( !readProfile( m_stubs[ index ], tb_pid, binary_offer ) )
+    {
+        removeStub( index, true );
+        return;
+    }
+
+    if( tb_pid > 0 )
+    {
+        /*
+         *  The socket now belongs to the link
+         */
+        removeStub( index, false );
+        addProfile( fd, tb_pid, binary_offer );
+    }
+}
+
+
+/*
+ *	Drop the stubs that did not send their profile frame in time
+ */
+void    SysTrayXDaemon::slotStubTimeout()
+{
+    for( int i = m_stubs.length() - 1 ; i >= 0 ; --i )
+    {
+        if( m_stubs.at( i ).connected.hasExpired( PROFILE_TIMEOUT ) )
+        {
+            removeStub( i, true );
+        }
+    }
+}
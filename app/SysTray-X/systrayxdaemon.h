@@ -0,0 +1,429 @@
+#ifndef SYSTRAYXDAEMON_H
+#define SYSTRAYXDAEMON_H
+
+/*
+ *	Local includes
+ */
+#include "systrayxlink.h"
+
+/*
+ *	Qt includes
+ */
+#include <QLocalServer>
+#include <QElapsedTimer>
+#include <QByteArray>
+#include <QList>
+#include <QMap>
+#include <QString>
+
+/*
+ *	Predefines
+ */
+class QTimer;
+class QLockFile;
+class QSocketNotifier;
+
+class Preferences;
+class WindowCtrl;
+
+
+/**
+ * @brief The SysTrayXDaemon class. Resident tray shared by the Thunderbird profiles.
+ *
+ *  The native messaging host started by each Thunderbird becomes a stub forwarding the link
+ *  over a local socket. The daemon runs one link and window control per profile, one tray icon
+ *  shows the total number of unread mails.
+ */
+class SysTrayXDaemon : public QLocalServer
+{
+    Q_OBJECT
+
+    public:
+
+        /**
+         * @brief DAEMON_ARGUMENT. Command line argument to start the daemon.
+         */
+        static const char* const    DAEMON_ARGUMENT;
+
+        /**
+         * @brief DAEMON_ENV. Environment variable enabling the daemon mode.
+         */
+        static const char* const    DAEMON_ENV;
+
+        /**
+         * @brief LINGER_TIME. Time the daemon stays after the last profile has gone (ms).
+         */
+        static const int LINGER_TIME = 10000;
+
+        /**
+         * @brief CONNECT_TIMEOUT. Time a stub waits for a starting daemon (ms).
+         */
+        static const int CONNECT_TIMEOUT = 5000;
+
+        /**
+         * @brief PROFILE_TIMEOUT. Time to wait for the profile frame of a stub (ms).
+         */
+        static const int PROFILE_TIMEOUT = 1000;
+
+        /**
+         * @brief MAX_PROFILE_SIZE. Maximum size of the profile frame of a stub.
+         */
+        static const int MAX_PROFILE_SIZE = 1024;
+
+        /**
+         * @brief The Stub class. A connected stub, waiting for its profile frame.
+         */
+        class Stub
+        {
+            public:
+
+                Stub()
+                {
+                    fd = -1;
+                    notifier = nullptr;
+                    frame_len = 0;
+                }
+
+                /**
+                 * @brief fd. The socket.
+                 */
+                int fd;
+
+                /**
+                 * @brief notifier. Notifier for the readable socket.
+                 */
+                QSocketNotifier*    notifier;
+
+                /**
+                 * @brief frame_len. Length of the profile frame, 0 while the header is incomplete.
+                 */
+                int frame_len;
+
+                /**
+                 * @brief data. The bytes received so far.
+                 */
+                QByteArray  data;
+
+                /**
+                 * @brief connected. Time since the connect.
+                 */
+                QElapsedTimer   connected;
+        };
+
+        /**
+         * @brief The Profile class. A connected Thunderbird profile.
+         */
+        class Profile
+        {
+            public:
+
+                Profile()
+                {
+                    link = nullptr;
+                    win_ctrl = nullptr;
+                    tb_pid = 0;
+                    unread_mail = 0;
+                    link_state = SysTrayXLink::LINK_CONNECTING;
+                }
+
+                /**
+                 * @brief link. The link to the add-on.
+                 */
+                SysTrayXLink*   link;
+
+                /**
+                 * @brief win_ctrl. The window control of the profile.
+                 */
+                WindowCtrl* win_ctrl;
+
+                /**
+                 * @brief tb_pid. Pid of the Thunderbird process.
+                 */
+                qint64  tb_pid;
+
+                /**
+                 * @brief unread_mail. Number of unread mails of the profile.
+                 */
+                int unread_mail;
+
+                /**
+                 * @brief link_state. State of the link to the add-on.
+                 */
+                SysTrayXLink::LinkState link_state;
+
+                /**
+                 * @brief accounts. Unread mails per account of the profile.
+                 */
+                QMap< QString, int >    accounts;
+        };
+
+    public:
+
+        /**
+         * @brief SysTrayXDaemon. Constructor, destructor.
+         *
+         *  @param pref     Pointer to the preferences storage.
+         *  @param parent   My parent.
+         */
+        explicit SysTrayXDaemon( Preferences* pref, QObject* parent = nullptr );
+        ~SysTrayXDaemon();
+
+        /**
+         * @brief isEnabled. Check if the daemon mode is enabled.
+         *
+         *  @return     The state.
+         */
+        static bool isEnabled();
+
+        /**
+         * @brief socketPath. Get the path of the daemon socket.
+         *
+         *  @return     The path, empty if there is no private runtime directory.
+         */
+        static QString  socketPath();
+
+        /**
+         * @brief runStub. Forward the native messaging link to the daemon, start it if needed.
+         *
+         *  Runs without a QApplication.
+         *
+         *  @param program  Path of this executable.
+         *
+         *  @return     The exit code, -1 if no daemon is available.
+         */
+        static int  runStub( const char* program );
+
+        /**
+         * @brief start. Start listening for stubs.
+         *
+         *  @return     False if another daemon is running or the socket is unusable.
+         */
+        bool    start();
+
+        /**
+         * @brief getProfileCount. Get the number of connected profiles.
+         *
+         *  @return     The count.
+         */
+        int getProfileCount() const;
+
+        /**
+         * @brief getUnreadMail. Get the total number of unread mails.
+         *
+         *  @return     The count.
+         */
+        int getUnreadMail() const;
+
+    protected:
+
+        /**
+         * @brief incomingConnection. Handle a new stub.
+         *
+         *  @param socket_descriptor    The connected socket.
+         */
+        void    incomingConnection( quintptr socket_descriptor ) override;
+
+    private:
+
+        /**
+         * @brief readProfile. Read the available part of the profile frame send by a stub.
+         *
+         *  Never reads past the frame, the rest of the stream belongs to the link.
+         *
+         *  @param stub     The stub.
+         *  @param tb_pid   Storage for the pid of the Thunderbird process, 0 while the frame is incomplete.
+         *  @param binary_offer     Storage for the CBOR offer of the stub.
+         *
+         *  @return     False if the stub is gone or the frame is invalid.
+         */
+        bool    readProfile( Stub& stub, qint64& tb_pid, bool& binary_offer );
+
+        /**
+         * @brief addProfile. Setup the link and window control of a profile.
+         *
+         *  The stub offering CBOR gets an answer, it converts the preferences frames from then on.
+         *
+         *  @param fd       The socket.
+         *  @param tb_pid   The pid of the Thunderbird process.
+         *  @param binary_offer     The stub offered CBOR frames.
+         */
+        void    addProfile( int fd, qint64 tb_pid, bool binary_offer );
+
+        /**
+         * @brief removeStub. Stop waiting for a stub.
+         *
+         *  @param index    The index.
+         *  @param close_fd     Close the socket.
+         */
+        void    removeStub( int index, bool close_fd );
+
+        /**
+         * @brief findProfile. Find the profile of a link.
+         *
+         *  @param link     The link.
+         *
+         *  @return     The index, -1 if not found.
+         */
+        int findProfile( QObject* link ) const;
+
+        /**
+         * @brief updateUnreadMail. Signal a change in the total number of unread mails.
+         */
+        void    updateUnreadMail();
+
+        /**
+         * @brief updateLinkState. Signal a change in the worst link state of the profiles.
+         */
+        void    updateLinkState();
+
+        /**
+         * @brief updateAccountUnread. Signal the unread mails per account of all profiles.
+         */
+        void    updateAccountUnread();
+
+    signals:
+
+        /**
+         * @brief signalUnreadMail. Signal the total number of unread mails.
+         *
+         *  @param unread_mail  The number of unread mails.
+         */
+        void    signalUnreadMail( int unread_mail );
+
+        /**
+         * @brief signalAccountUnread. Signal the unread mails per account of all profiles.
+         *
+         *  @param accounts     The counts by account name.
+         */
+        void    signalAccountUnread( const QMap< QString, int >& accounts );
+
+        /**
+         * @brief signalLinkState. Signal the worst link state of the profiles.
+         *
+         *  @param state    The state.
+         */
+        void    signalLinkState( SysTrayXLink::LinkState state );
+
+        /**
+         * @brief signalConsole. Send a console message.
+         *
+         *  @param message      The message.
+         */
+        void    signalConsole( QString message );
+
+        /**
+         * @brief signalAllProfilesClosed. Signal the daemon is no longer needed.
+         */
+        void    signalAllProfilesClosed();
+
+    public slots:
+
+        /**
+         * @brief slotShowHide. Show / hide the windows of all profiles.
+         */
+        void    slotShowHide();
+
+        /**
+         * @brief slotClose. Close the windows of all profiles.
+         */
+        void    slotClose();
+
+        /**
+         * @brief slotStatistics. Show the profiles.
+         */
+        void    slotStatistics();
+
+        /**
+         * @brief slotBenchmark. Run the link benchmarks, once for all profiles.
+         */
+        void    slotBenchmark();
+
+        /**
+         * @brief slotWindowBenchmark. Run the window search benchmark for each profile.
+         */
+        void    slotWindowBenchmark();
+
+    private slots:
+
+        /**
+         * @brief slotProfileUnreadMail. Handle the unread mails of a profile.
+         *
+         *  @param unread_mail  The number of unread mails.
+         */
+        void    slotProfileUnreadMail( int unread_mail );
+
+        /**
+         * @brief slotProfileLinkState. Handle the link state of a profile.
+         *
+         *  @param state    The state.
+         */
+        void    slotProfileLinkState( SysTrayXLink::LinkState state );
+
+        /**
+         * @brief slotProfileAccountUnread. Handle the unread mails per account of a profile.
+         *
+         *  @param accounts     The counts by account name.
+         */
+        void    slotProfileAccountUnread( const QMap< QString, int >& accounts );
+
+        /**
+         * @brief slotProfileClosed. Handle the end of a profile link.
+         */
+        void    slotProfileClosed();
+
+        /**
+         * @brief slotStubReadyRead. Read the profile frame of a stub.
+         *
+         *  @param fd   The socket.
+         */
+        void    slotStubReadyRead( int fd );
+
+        /**
+         * @brief slotStubTimeout. Drop the stubs that did not send their profile frame in time.
+         */
+        void    slotStubTimeout();
+
+    private:
+
+        /**
+         * @brief m_pref. Pointer to the preferences storage.
+         */
+        Preferences*    m_pref;
+
+        /**
+         * @brief m_profiles. The connected profiles.
+         */
+        QList< Profile >    m_profiles;
+
+        /**
+         * @brief m_stubs. The stubs waiting for their profile frame.
+         */
+        QList< Stub >   m_stubs;
+
+        /**
+         * @brief m_stub_timer. Timeout timer, runs while stubs are waiting.
+         */
+        QTimer* m_stub_timer;
+
+        /**
+         * @brief m_lock_file. Lock held by the running daemon.
+         */
+        QLockFile*  m_lock_file;
+
+        /**
+         * @brief m_unread_mail. Last signalled total of unread mails.
+         */
+        int m_unread_mail;
+
+        /**
+         * @brief m_link_state. Last signalled worst link state.
+         */
+        SysTrayXLink::LinkState m_link_state;
+
+        /**
+         * @brief m_linger_timer. Quit timer, runs while no profile is connected.
+         */
+        QTimer* m_linger_timer;
+};
+
+#endif // SYSTRAYXDAEMON_H
@@ -14,6 +14,7 @@
  *	Qt includes
  */
 #include <QPainter>
+#include <QStringList>
 
 
 /*
@@ -29,6 +30,7 @@ SysTrayXIcon::SysTrayXIcon( SysTrayXLink* link, Preferences* pref, QObject* pare
     m_pref = pref;
 
     m_unread_mail = 0;
+    m_link_state = SysTrayXLink::LINK_CONNECTING;
 
     connect( this, &QSystemTrayIcon::activated, this, &SysTrayXIcon::slotIconActivated );
 }
@@ -175,6 +177,27 @@ void    SysTrayXIcon::renderIcon()
 }
 
 
+/*
+ *  Set the tool tip
+ */
+void    SysTrayXIcon::updateToolTip()
+{
+    QString tool_tip = m_account_tool_tip;
+
+    if( m_link_state == SysTrayXLink::LINK_DEGRADED )
+    {
+        if( !tool_tip.isEmpty() )
+        {
+            tool_tip.append( "\n" );
+        }
+
+        tool_tip.append( tr( "Thunderbird is not responding" ) );
+    }
+
+    setToolTip( tool_tip );
+}
+
+
 /*
  *  Handle unread mail signal
  */
@@ -185,21 +208,64 @@ void    SysTrayXIcon::slotSetUnreadMail( int unread_mail )
 
 
 /*
- *  Handle the icon type change signal
+ *  Handle the unread mails per account
  */
-void    SysTrayXIcon::slotIconTypeChange()
+void    SysTrayXIcon::slotSetAccountUnread( const QMap< QString, int >& accounts )
 {
-    setIconType( m_pref->getIconType() );
+    QStringList lines;
+    for( QMap< QString, int >::const_iterator it = accounts.constBegin() ; it != accounts.constEnd() ; ++it )
+    {
+        lines.append( QString( "%1: %2" ).arg( it.key() ).arg( it.value() ) );
+    }
+
+    m_account_tool_tip = lines.join( "\n" );
+
+    updateToolTip();
 }
 
 
 /*
- *  Handle the icon data change signal
+ *  Handle a change of the link state
  */
-void    SysTrayXIcon::slotIconDataChange()
+void    SysTrayXIcon::slotLinkState( SysTrayXLink::LinkState state )
 {
-    setIconMime( m_pref->getIconMime() );
-    setIconData( m_pref->getIconData() );
+    m_link_state = state;
+
+    updateToolTip();
+}
+
+
+/*
+ *  Handle the preferences change signal
+ */
+void    SysTrayXIcon::slotPreferencesChange( quint32 changes )
+{
+    bool render = false;
+
+    if( ( changes & Preferences::PREF_ICON_TYPE_CHANGE ) && m_icon_type != m_pref->getIconType() )
+    {
+        m_icon_type = m_pref->getIconType();
+        render = true;
+    }
+
+    if( changes & Preferences::PREF_ICON_DATA_CHANGE )
+    {
+        m_icon_mime = m_pref->getIconMime();
+
+        if( m_icon_data != m_pref->getIconData() )
+        {
+            m_icon_data = m_pref->getIconData();
+            render = true;
+        }
+    }
+
+    /*
+     *  Render and set a new icon in the tray, once for all changes
+     */
+    if( render )
+    {
+        renderIcon();
+    }
 }
 
 
@@ -5,16 +5,14 @@
  *	Local includes
  */
 #include "preferences.h"
+#include "systrayxlink.h"
 
 /*
  *	Qt includes
  */
 #include <QSystemTrayIcon>
-
-/*
- *	Predefines
- */
-class SysTrayXLink;
+#include <QMap>
+#include <QString>
 
 
 /**
@@ -68,6 +66,11 @@ class SysTrayXIcon : public QSystemTrayIcon
          */
         void    renderIcon();
 
+        /**
+         * @brief updateToolTip. Show the unread mails per account and a not responding add-on.
+         */
+        void    updateToolTip();
+
     signals:
 
         /**
@@ -85,14 +88,25 @@ class SysTrayXIcon : public QSystemTrayIcon
         void    slotSetUnreadMail( int unread_mail );
 
         /**
-         * @brief slotIconTypeChange. Slot for handling icon type change signals.
+         * @brief slotSetAccountUnread. Show the unread mails per account in the tool tip.
+         *
+         *  @param accounts     The counts by account name.
+         */
+        void    slotSetAccountUnread( const QMap< QString, int >& accounts );
+
+        /**
+         * @brief slotLinkState. Show a not responding add-on in the tool tip.
+         *
+         *  @param state    The link state.
          */
-        void    slotIconTypeChange();
+        void    slotLinkState( SysTrayXLink::LinkState state );
 
         /**
-         * @brief slotIconDataChange. Slot for handling icon data change signals.
+         * @brief slotPreferencesChange. Slot for handling preferences change signals.
+         *
+         *  @param changes  The changes (bits, Preferences::PrefChange).
          */
-        void    slotIconDataChange();
+        void    slotPreferencesChange( quint32 changes );
 
     private slots:
 
@@ -134,6 +148,16 @@ class SysTrayXIcon : public QSystemTrayIcon
          * @brief m_unread_mail. Storage for the number of unread mails.
          */
         int m_unread_mail;
+
+        /**
+         * @brief m_account_tool_tip. The unread mails per account.
+         */
+        QString m_account_tool_tip;
+
+        /**
+         * @brief m_link_state. The state of the link to the add-on.
+         */
+        SysTrayXLink::LinkState m_link_state;
 };
 
 #endif // SYSTRAYXICON_H
@@ -5,15 +5,17 @@
  *	Local includes
  */
 #include "preferences.h"
+#include "systrayxlinkdecoder.h"
+#include "systrayxbase64.h"
 
 
 /*
  *  System includes
  */
-#include <iostream>
-#ifdef Q_OS_WIN
-#include <fcntl.h>
-#include <io.h>
+#include <cstring>
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#include <sys/uio.h>
 #endif
 
 
@@ -27,11 +29,33 @@
 #include <QVariant>
 #include <QJsonValue>
 #include <QJsonObject>
+#include <QVariantMap>
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+#include <QCborValue>
+#include <QCborMap>
+#endif
+
+
+/*
+ *  Constants
+ */
+const QList< QByteArray >   SysTrayXLink::REPEAT_PREFIXES = QList< QByteArray >()
+        << QByteArray( "{\"unreadMail\":" );
+
+const QByteArray    SysTrayXLink::WINDOW_NORMAL_FRAME = QByteArray( "{\"window\":\"normal\"}" );
+const QByteArray    SysTrayXLink::WINDOW_MINIMIZED_FRAME = QByteArray( "{\"window\":\"minimized\"}" );
+
+const char* const   SysTrayXLink::LINK_STATE_NAMES[] = { "connecting", "up", "degraded", "down" };
+
+const char* const   SysTrayXLink::HEARTBEAT_ENV = "SYSTRAY_X_HEARTBEAT";
+
+static_assert( SysTrayXLinkRingBuffer::DEFAULT_MAX_FRAME_SIZE > ( Preferences::MAX_ICON_SIZE + 2 ) / 3 * 4 + 64 * 1024,
+               "The preferences frame with the largest custom icon has to fit" );
 
 
 /*****************************************************************************
  *
- *  SysTrayXLinkReader Class
+ *  SysTrayXLinkRingBuffer Class
  *
  *****************************************************************************/
 
@@ -39,119 +63,317 @@
 /*
  *	Constructor
  */
-SysTrayXLinkReader::SysTrayXLinkReader()
+SysTrayXLinkRingBuffer::SysTrayXLinkRingBuffer( int max_frame_size )
 {
     /*
-     *  Set stdin to binary
+     *  Initialize
      */
-#ifdef Q_OS_WIN
-    _setmode( _fileno( stdin ), _O_BINARY);
-#endif
+    m_data = QByteArray( INITIAL_CAPACITY, 0 );
+    m_scratch = QByteArray();
+    m_mask = INITIAL_CAPACITY - 1;
+    m_head = 0;
+    m_used = 0;
+    m_max_frame_size = max_frame_size;
+    m_resyncing = false;
+    m_binary_framing = false;
+    m_resync_count = 0;
+    m_skipped_bytes = 0;
+    m_oversized_frames = 0;
+}
 
-    /*
-     *	Setup the timer
-     */
-    m_timer = new QTimer( this );
-    m_timer->setSingleShot( true );
-    connect( m_timer, &QTimer::timeout, this, &SysTrayXLinkReader::slotWorker );
+
+/*
+ *	Get the largest accepted frame size
+ */
+int SysTrayXLinkRingBuffer::getMaxFrameSize() const
+{
+    return m_max_frame_size;
 }
 
 
 /*
- *	Destructor
+ *	Accept CBOR frames
  */
-SysTrayXLinkReader::~SysTrayXLinkReader()
+void    SysTrayXLinkRingBuffer::setBinaryFraming( bool state )
 {
-    /*
-     *  Cleanup
-     */
-    m_timer->stop();
-    delete m_timer;
+    m_binary_framing = state;
 }
 
 
 /*
- *	Start reading
+ *	Read as much data as fits from a file descriptor
  */
-void    SysTrayXLinkReader::startThread()
+qint64  SysTrayXLinkRingBuffer::readFrom( int fd )
 {
-    /*
-     *	Start the work
-     */
-    m_doWork = true;
+#ifdef Q_OS_UNIX
+    if( m_used == 0 )
+    {
+        /*
+         *  Restart at the beginning, keeps most frames contiguous
+         */
+        m_head = 0;
+    }
 
-    /*
-     *	Start the worker
-     */
-    m_timer->start();
+    if( m_used == m_data.size() )
+    {
+        reserve( m_data.size() + 1 );
+    }
+
+    int capacity = m_data.size();
+    int tail = ( m_head + m_used ) & m_mask;
+    int space = capacity - m_used;
+    int first = qMin( space, capacity - tail );
+
+    struct iovec iov[ 2 ];
+    iov[ 0 ].iov_base = m_data.data() + tail;
+    iov[ 0 ].iov_len = static_cast< size_t >( first );
+    iov[ 1 ].iov_base = m_data.data();
+    iov[ 1 ].iov_len = static_cast< size_t >( space - first );
+
+    ssize_t len = ::readv( fd, iov, space > first ? 2 : 1 );
+    if( len > 0 )
+    {
+        m_used += static_cast< int >( len );
+    }
+
+    return len;
+#else
+    Q_UNUSED( fd )
+
+    return -1;
+#endif
 }
 
 
 /*
- *	Stop viewing
+ *	Append data to the buffer
  */
-void    SysTrayXLinkReader::stopThread()
+void    SysTrayXLinkRingBuffer::append( const char* data, int len )
 {
-    /*
-     *	Stop working
-     */
-    m_doWork = false;
+    if( m_used == 0 )
+    {
+        m_head = 0;
+    }
+
+    reserve( m_used + len );
+
+    int capacity = m_data.size();
+    int tail = ( m_head + m_used ) & m_mask;
+    int first = qMin( len, capacity - tail );
+
+    memcpy( m_data.data() + tail, data, static_cast< size_t >( first ) );
+    memcpy( m_data.data(), data + first, static_cast< size_t >( len - first ) );
+
+    m_used += len;
 }
 
 
 /*
- *	Read the data
+ *	Get the next complete frame
  */
-void    SysTrayXLinkReader::slotWorker()
+bool    SysTrayXLinkRingBuffer::nextFrame( const char** data, int* len )
 {
-    int error_count = 0;
+    const int header_len = static_cast< int >( sizeof( qint32 ) );
 
-    while( m_doWork )
+    while( m_used >= header_len )
     {
+        /*
+         *  Check the header
+         */
         qint32 data_len;
-        std::cin.read( reinterpret_cast< char* >( &data_len ), sizeof( qint32 ) );
+        peek( 0, reinterpret_cast< char* >( &data_len ), header_len );
 
-        if( data_len > 0)
+        if( data_len <= 0 || data_len > m_max_frame_size )
         {
-            QByteArray data( data_len, 0 );
-            std::cin.read( data.data(), data_len );
-
             /*
-             *  Send the data to my parent
+             *  A frame boundary announcing too much data, not random bytes while resyncing
              */
-            emit signalReceivedMessage( data );
+            if( data_len > m_max_frame_size && !m_resyncing )
+            {
+                m_oversized_frames++;
+            }
 
+            resync();
+            continue;
+        }
+
+        /*
+         *  A message is a JSON object or a CBOR map, check the first byte as soon as we have it
+         */
+        if( m_used == header_len )
+        {
+            return false;
+        }
+
+        char first = byteAt( header_len );
+        bool binary = m_binary_framing && SysTrayXLinkDecoder::isCbor( first );
+
+        if( first != '{' && !binary )
+        {
+            resync();
+            continue;
+        }
+
+        /*
+         *  Wait for the complete frame
+         */
+        int frame_len = header_len + data_len;
+
+        reserve( frame_len );
+
+        if( m_used < frame_len )
+        {
+            return false;
+        }
+
+        if( !binary && byteAt( frame_len - 1 ) != '}' )
+        {
+            resync();
+            continue;
+        }
+
+        /*
+         *  Got a valid frame
+         */
+        m_resyncing = false;
+
+        int start = ( m_head + header_len ) & m_mask;
+        if( start + data_len <= m_data.size() )
+        {
+            *data = m_data.constData() + start;
+        }
+        else
+        {
             /*
-             *  Send the data to my parent
+             *  The frame wraps, make it contiguous
              */
-            if( data.at( 0 ) == '{' )
+            if( m_scratch.size() < data_len )
             {
-                emit signalReceivedMessage( data );
-
-                error_count = 0;
+                m_scratch.resize( data_len );
             }
-            else
-            {
-                error_count++;
+            peek( header_len, m_scratch.data(), data_len );
 
-                if( error_count > 20 )
-                {
-                    emit signalAddOnShutdown();
-                }
-            }
+            *data = m_scratch.constData();
         }
+
+        *len = data_len;
+
+        skip( frame_len );
+
+        return true;
+    }
+
+    return false;
+}
+
+
+/*
+ *	Get the number of corruptions recovered from
+ */
+quint64 SysTrayXLinkRingBuffer::getResyncCount() const
+{
+    return m_resync_count;
+}
+
+
+/*
+ *	Get the number of bytes dropped while resyncing
+ */
+quint64 SysTrayXLinkRingBuffer::getSkippedBytes() const
+{
+    return m_skipped_bytes;
+}
+
+
+/*
+ *	Get the number of frames dropped for exceeding the largest accepted size
+ */
+quint64 SysTrayXLinkRingBuffer::getOversizedFrames() const
+{
+    return m_oversized_frames;
+}
+
+
+/*
+ *	Copy data from the buffer
+ */
+void    SysTrayXLinkRingBuffer::peek( int offset, char* dest, int len ) const
+{
+    int start = ( m_head + offset ) & m_mask;
+    int first = qMin( len, m_data.size() - start );
+
+    memcpy( dest, m_data.constData() + start, static_cast< size_t >( first ) );
+    memcpy( dest + first, m_data.constData(), static_cast< size_t >( len - first ) );
+}
+
+
+/*
+ *	Get a byte from the buffer
+ */
+char    SysTrayXLinkRingBuffer::byteAt( int offset ) const
+{
+    return m_data.at( ( m_head + offset ) & m_mask );
+}
+
+
+/*
+ *	Remove data from the buffer
+ */
+void    SysTrayXLinkRingBuffer::skip( int len )
+{
+    m_head = ( m_head + len ) & m_mask;
+    m_used -= len;
+}
+
+
+/*
+ *	Drop a byte of corrupted data and search for the next valid frame
+ */
+void    SysTrayXLinkRingBuffer::resync()
+{
+    if( !m_resyncing )
+    {
+        m_resyncing = true;
+        m_resync_count++;
+    }
+
+    m_skipped_bytes++;
+
+    skip( 1 );
+}
+
+
+/*
+ *	Make sure the buffer can hold the data
+ */
+void    SysTrayXLinkRingBuffer::reserve( int len )
+{
+    if( len <= m_data.size() )
+    {
+        return;
+    }
+
+    int capacity = m_data.size();
+    while( capacity < len )
+    {
+        capacity *= 2;
     }
 
     /*
-     *	Quit this thread
+     *  Move the pending data to the start of the new buffer
      */
-    QThread::currentThread()->quit();
+    QByteArray data( capacity, 0 );
+    peek( 0, data.data(), m_used );
+
+    m_data = data;
+    m_mask = capacity - 1;
+    m_head = 0;
 }
 
 
 /*****************************************************************************
  *
- *  SysTrayXLink Class
+ *  SysTrayXLinkReader Class
  *
  *****************************************************************************/
 
@@ -159,120 +381,1180 @@ void    SysTrayXLinkReader::slotWorker()
 /*
  *	Constructor
  */
-SysTrayXLink::SysTrayXLink( Preferences* pref )
+SysTrayXLinkReader::SysTrayXLinkReader( SysTrayXLinkFrameQueue* queue, SysTrayXLinkFrameQueue* bulk_queue, SysTrayXLinkTransport* transport )
 {
     /*
-     *  Store preferences
+     *  Initialize
      */
-    m_pref = pref;
+    m_timer = nullptr;
+    m_transport = transport;
+    m_transport->setParent( this );
+    m_queue = queue;
+    m_bulk_queue = bulk_queue;
+    m_eof = false;
+    m_doWork = false;
+    m_reported_resyncs = 0;
+    m_reported_skipped = 0;
+    m_reported_oversized = 0;
 
     /*
-     *  Open dump.txt
+     *  Only a transport that negotiated it carries CBOR frames
      */
-//    m_dump = new QFile( "dump.txt", this );
-//    m_dump->open( QIODevice::WriteOnly );
+    m_ring.setBinaryFraming( m_transport->isBinaryFraming() );
 
-    /*
-     *  Setup the reader thread
-     */
-    m_reader_thread = new QThread( this );
+    if( m_transport->isBlocking() )
+    {
+        /*
+         *	Setup the timer
+         */
+        m_timer = new QTimer( this );
+        m_timer->setSingleShot( true );
+        connect( m_timer, &QTimer::timeout, this, &SysTrayXLinkReader::slotWorker );
+    }
+}
 
-    SysTrayXLinkReader* reader = new SysTrayXLinkReader;
-    reader->moveToThread( m_reader_thread );
 
-    connect( m_reader_thread, &QThread::finished, reader, &QObject::deleteLater );
-    connect( reader, &SysTrayXLinkReader::signalReceivedMessage, this, &SysTrayXLink::slotLinkRead );
-    connect( reader, &SysTrayXLinkReader::signalAddOnShutdown, this, &SysTrayXLink::slotAddOnShutdown );
+/*
+ *	Destructor
+ */
+SysTrayXLinkReader::~SysTrayXLinkReader()
+{
+    /*
+     *  Cleanup
+     */
+    if( m_timer )
+    {
+        m_timer->stop();
+        delete m_timer;
+    }
 
-    connect( m_reader_thread, &QThread::started, reader, &SysTrayXLinkReader::startThread, Qt::QueuedConnection );
-    m_reader_thread->start();
+    m_transport->setReadEnabled( false );
 }
 
 
 /*
- *	Destructor
+ *	Start reading
  */
-SysTrayXLink::~SysTrayXLink()
+void    SysTrayXLinkReader::startThread()
 {
     /*
-     *  Cleanup
+     *	Start the work
      */
-//    m_dump->close();
-//    delete m_dump;
+    m_doWork = true;
+
+    if( m_transport->isBlocking() )
+    {
+        /*
+         *	Start the worker
+         */
+        m_timer->start();
+    }
+    else
+    {
+        /*
+         *  Wait for data in the event loop of this thread, handle what is already there
+         */
+        connect( m_transport, &SysTrayXLinkTransport::signalReadyRead, this, &SysTrayXLinkReader::slotReadyRead );
+        m_transport->startReading();
+
+        slotReadyRead();
+    }
 }
 
 
 /*
- *  Write a message to the link
+ *	Stop viewing
  */
-void    SysTrayXLink::linkWrite( const QByteArray& message )
+void    SysTrayXLinkReader::stopThread()
 {
-    qint32  msglen = message.length();
-    std::cout.write( reinterpret_cast< char* >( &msglen ), sizeof( qint32 ) );
-    std::cout.write( message.data(), msglen ) << std::flush;
+    /*
+     *	Stop working
+     */
+    m_doWork = false;
+
+    m_transport->setReadEnabled( false );
 }
 
 
 /*
- *  Send the preferences to the add-on
+ *	Read the data (blocking transports, no event loop)
  */
-void    SysTrayXLink::sendPreferences()
+void    SysTrayXLinkReader::slotWorker()
 {
+    while( m_doWork )
+    {
+        if( m_transport->read( m_ring ) != SysTrayXLinkTransport::READ_DATA )
+        {
+            break;
+        }
+
+        /*
+         *  Wait for the GUI thread to make room
+         */
+        while( !processFrames() && m_doWork )
+        {
+            QThread::msleep( 1 );
+        }
+    }
+
     /*
-     *  Enacode the preferences into a JSON doc
+     *  End of stream?
      */
-    EncodePreferences( *m_pref );
+    if( m_doWork )
+    {
+        linkClosed();
+    }
 
     /*
-     *  Send them to the add-on
+     *	Quit this thread
      */
-    linkWrite( m_pref_json_doc.toJson( QJsonDocument::Compact ) );
+    QThread::currentThread()->quit();
+}
+
+
+/*
+ *	Read all available data from the transport
+ */
+void    SysTrayXLinkReader::slotReadyRead()
+{
+    if( m_eof )
+    {
+        return;
+    }
+
+    forever
+    {
+        /*
+         *  Handle the frames before reading on, keeps the buffer small
+         */
+        if( !processFrames() )
+        {
+            /*
+             *  Queue full, wait for the resume
+             */
+            m_transport->setReadEnabled( false );
+            break;
+        }
+
+        SysTrayXLinkTransport::ReadResult result = m_transport->read( m_ring );
+
+        if( result == SysTrayXLinkTransport::READ_DATA )
+        {
+            continue;
+        }
+        else
+        if( result == SysTrayXLinkTransport::READ_WAIT )
+        {
+            /*
+             *  All available data read
+             */
+            break;
+        }
+        else
+        {
+            /*
+             *  End of stream or read error, deliver what is left first
+             */
+            m_eof = true;
+            m_transport->setReadEnabled( false );
+
+            if( processFrames() )
+            {
+                linkClosed();
+            }
+            break;
+        }
+    }
+}
+
+
+/*
+ *	Continue after the queue has been drained
+ */
+void    SysTrayXLinkReader::slotResume()
+{
+    if( !m_doWork )
+    {
+        return;
+    }
+
+    if( m_eof )
+    {
+        if( processFrames() )
+        {
+            linkClosed();
+        }
+    }
+    else
+    if( !m_transport->isBlocking() )
+    {
+        m_transport->setReadEnabled( true );
+        slotReadyRead();
+    }
+}
+
+
+/*
+ *	Queue all complete frames
+ */
+bool    SysTrayXLinkReader::processFrames()
+{
+    bool queued = false;
+    bool bulk_queued = false;
+    bool stalled = false;
+
+    forever
+    {
+        /*
+         *  The lane of the next frame is not known yet, wait for room in both
+         */
+        if( isStalled() )
+        {
+            stalled = true;
+            break;
+        }
+
+        /*
+         *  Frame passing transports first, no copy
+         */
+        QByteArray frame;
+        if( !m_transport->takeFrame( frame ) )
+        {
+            const char* data;
+            int data_len;
+
+            if( !m_ring.nextFrame( &data, &data_len ) )
+            {
+                break;
+            }
+
+            /*
+             *  One copy per frame, the queues are drained by other threads while the ring is refilled
+             */
+            frame = QByteArray( data, data_len );
+        }
+
+        /*
+         *  Preferences and icons go to the bulk worker, control messages are not held up by them
+         */
+        if( SysTrayXLinkDecoder::isBulk( frame.constData(), frame.size() ) )
+        {
+            m_bulk_queue->push( frame );
+            bulk_queued = true;
+        }
+        else
+        {
+            m_queue->push( frame );
+            queued = true;
+        }
+    }
+
+    reportResync();
+
+    /*
+     *  Wake the consumers, once for the whole batch
+     */
+    if( ( queued || stalled ) && m_queue->requestWakeup() )
+    {
+        emit signalFramesReady();
+    }
+
+    if( ( bulk_queued || stalled ) && m_bulk_queue->requestWakeup() )
+    {
+        emit signalBulkFramesReady();
+    }
+
+    return !stalled;
+}
+
+
+/*
+ *	Check for a full queue
+ */
+bool    SysTrayXLinkReader::isStalled()
+{
+    if( !m_queue->isFull() && !m_bulk_queue->isFull() )
+    {
+        return false;
+    }
+
+    /*
+     *  Check again after setting the flags, the consumers could have drained the queues meanwhile
+     */
+    m_queue->setStalled();
+    m_bulk_queue->setStalled();
+
+    return m_queue->isFull() || m_bulk_queue->isFull();
+}
+
+
+/*
+ *	Signal changed resync counters, once per batch
+ */
+void    SysTrayXLinkReader::reportResync()
+{
+    if( m_ring.getResyncCount() == m_reported_resyncs && m_ring.getSkippedBytes() == m_reported_skipped &&
+        m_ring.getOversizedFrames() == m_reported_oversized )
+    {
+        return;
+    }
+
+    m_reported_resyncs = m_ring.getResyncCount();
+    m_reported_skipped = m_ring.getSkippedBytes();
+    m_reported_oversized = m_ring.getOversizedFrames();
+
+    emit signalResync( m_reported_resyncs, m_reported_skipped, m_reported_oversized );
+}
+
+
+/*
+ *	Handle the end of the input stream
+ */
+void    SysTrayXLinkReader::linkClosed()
+{
+    /*
+     *  Stop reading
+     */
+    stopThread();
+
+    /*
+     *  Tell my parent
+     */
+    emit signalLinkClosed();
+}
+
+
+/*****************************************************************************
+ *
+ *  SysTrayXLinkBulkWorker Class
+ *
+ *****************************************************************************/
+
+
+/*
+ *	Constructor
+ */
+SysTrayXLinkBulkWorker::SysTrayXLinkBulkWorker( SysTrayXLinkFrameQueue* queue, std::atomic< int >* in_flight )
+{
+    /*
+     *  Initialize
+     */
+    m_queue = queue;
+    m_in_flight = in_flight;
+}
+
+
+/*
+ *	Decode the queued frames
+ */
+void    SysTrayXLinkBulkWorker::slotDecode()
+{
+    /*
+     *  Acknowledge the wakeup before draining, frames queued from now on trigger a new one
+     */
+    m_queue->clearWakeup();
+
+    /*
+     *  Stop when the GUI thread is behind, it signals when there is room again
+     */
+    SysTrayXLinkBulkFrame bulk;
+    while( m_in_flight->load() < MAX_IN_FLIGHT && m_queue->pop( bulk.frame ) )
+    {
+        QElapsedTimer timer;
+        timer.start();
+
+        bulk.message = SysTrayXLinkDecoder::Message();
+        bulk.valid = SysTrayXLink::decodeFrame( bulk.frame, bulk.message );
+
+        /*
+         *  Decode the icon here, the GUI thread only has to store it
+         */
+        SysTrayXLinkDecoder::Message& msg = bulk.message;
+        if( bulk.valid && ( msg.pref_keys & ( 1u << SysTrayXLinkDecoder::PREF_ICON ) ) && !msg.raw_icon )
+        {
+            msg.pref[ SysTrayXLinkDecoder::PREF_ICON ] = SysTrayXBase64::decode( msg.pref[ SysTrayXLinkDecoder::PREF_ICON ] );
+            msg.raw_icon = true;
+        }
+
+        bulk.decode_time = timer.nsecsElapsed() / 1000;
+
+        m_in_flight->fetch_add( 1 );
+        emit signalDecoded( bulk );
+    }
+
+    /*
+     *  Let the reader continue if it was waiting for room
+     */
+    if( m_queue->takeStalled() )
+    {
+        emit signalResumeReader();
+    }
+}
+
+
+/*****************************************************************************
+ *
+ *  SysTrayXLinkBenchmark Class
+ *
+ *****************************************************************************/
+
+
+/*
+ *  Run the benchmarks
+ */
+void    SysTrayXLinkBenchmark::slotRun()
+{
+    foreach( const QString& line, SysTrayXLinkDecoder::benchmark( 10000 ) )
+    {
+        emit signalConsole( line );
+    }
+
+    foreach( const QString& line, SysTrayXLinkDecoder::benchmarkFraming( 200 ) )
+    {
+        emit signalConsole( line );
+    }
+
+    foreach( const QString& line, SysTrayXBase64::benchmark() )
+    {
+        emit signalConsole( line );
+    }
+
+    foreach( const QString& line, SysTrayXLinkTransport::benchmark() )
+    {
+        emit signalConsole( line );
+    }
+
+    emit signalDone();
+}
+
+
+/*****************************************************************************
+ *
+ *  SysTrayXLinkWriter Class
+ *
+ *****************************************************************************/
+
+
+/*
+ *	Constructor
+ */
+SysTrayXLinkWriter::SysTrayXLinkWriter( SysTrayXLinkWriteQueue* queue, SysTrayXLinkWriteSlot* slots, SysTrayXLinkTransport* transport )
+{
+    /*
+     *  Initialize
+     */
+    m_queue = queue;
+    m_slots = slots;
+    m_transport = transport;
+    m_written_sequence = 0;
+    m_frames_written.store( 0 );
+    m_batches_written.store( 0 );
+    m_latency_last.store( 0 );
+    m_latency_max.store( 0 );
+    m_latency_total.store( 0 );
+
+    for( int key = 0 ; key < SysTrayXLinkWriteItem::KEY_COUNT ; ++key )
+    {
+        m_pending[ key ] = nullptr;
+    }
+}
+
+
+/*
+ *  Destructor
+ */
+SysTrayXLinkWriter::~SysTrayXLinkWriter()
+{
+    for( int key = 0 ; key < SysTrayXLinkWriteItem::KEY_COUNT ; ++key )
+    {
+        delete m_pending[ key ];
+    }
+}
+
+
+/*
+ *	Get the number of written frames
+ */
+quint64 SysTrayXLinkWriter::getFramesWritten() const
+{
+    return m_frames_written.load();
+}
+
+
+/*
+ *	Get the number of write calls
+ */
+quint64 SysTrayXLinkWriter::getBatchesWritten() const
+{
+    return m_batches_written.load();
+}
+
+
+/*
+ *	Get the queue to written time of the last frame
+ */
+quint64 SysTrayXLinkWriter::getLatencyLast() const
+{
+    return m_latency_last.load();
+}
+
+
+/*
+ *	Get the largest queue to written time
+ */
+quint64 SysTrayXLinkWriter::getLatencyMax() const
+{
+    return m_latency_max.load();
+}
+
+
+/*
+ *	Get the average queue to written time
+ */
+quint64 SysTrayXLinkWriter::getLatencyAverage() const
+{
+    quint64 frames = m_frames_written.load();
+
+    return frames > 0 ? m_latency_total.load() / frames : 0;
+}
+
+
+/*
+ *	Write all queued frames
+ */
+void    SysTrayXLinkWriter::slotWrite()
+{
+    /*
+     *  Acknowledge the wakeup before draining, frames queued from now on trigger a new one
+     */
+    m_queue->clearWakeup();
+
+    SysTrayXLinkWriteItem items[ WRITE_BATCH ];
+
+    forever
+    {
+        /*
+         *  Take the newest frame of each message type, it replaces a held back older one
+         */
+        for( int key = 0 ; key < SysTrayXLinkWriteItem::KEY_COUNT ; ++key )
+        {
+            SysTrayXLinkWriteItem* item = m_slots[ key ].exchange( nullptr );
+            if( item )
+            {
+                if( m_pending[ key ] )
+                {
+                    /*
+                     *  The GUI thread never saw the held back frame, let it encode the fields it carried again
+                     */
+                    quint32 dropped = m_pending[ key ]->fields & ~item->fields;
+                    if( dropped )
+                    {
+                        emit signalFieldsDropped( dropped );
+                    }
+
+                    delete m_pending[ key ];
+                }
+                m_pending[ key ] = item;
+            }
+        }
+
+        /*
+         *  Merge by sequence, a coalesced frame never overtakes a queued frame sent before it
+         */
+        quint64 written = m_written_sequence;
+        int count = takePending( items, 0, written );
+
+        while( count + SysTrayXLinkWriteItem::KEY_COUNT < WRITE_BATCH && m_queue->pop( items[ count ] ) )
+        {
+            written = items[ count ].sequence;
+            count = takePending( items, count + 1, written );
+        }
+
+        if( count == 0 )
+        {
+            break;
+        }
+
+        if( !writeFrames( items, count ) )
+        {
+            emit signalWriteError();
+            return;
+        }
+
+        m_written_sequence = written;
+
+        /*
+         *  Update the statistics
+         */
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+        for( int i = 0 ; i < count ; ++i )
+        {
+            quint64 latency = static_cast< quint64 >( std::chrono::duration_cast< std::chrono::microseconds >( now - items[ i ].queued ).count() );
+
+            m_latency_total += latency;
+            if( latency > m_latency_max.load() )
+            {
+                m_latency_max.store( latency );
+            }
+
+            items[ i ].frame = QByteArray();
+        }
+
+        m_latency_last.store( static_cast< quint64 >( std::chrono::duration_cast< std::chrono::microseconds >( now - items[ count - 1 ].queued ).count() ) );
+        m_frames_written += count;
+        m_batches_written++;
+    }
+
+    /*
+     *  Let the GUI thread continue if it was waiting for room
+     */
+    if( m_queue->takeStalled() )
+    {
+        emit signalWriteDone();
+    }
+}
+
+
+/*
+ *	Add the held back coalesced frames that may be written now
+ */
+int SysTrayXLinkWriter::takePending( SysTrayXLinkWriteItem* items, int count, quint64 written )
+{
+    for( int key = 0 ; key < SysTrayXLinkWriteItem::KEY_COUNT ; ++key )
+    {
+        if( m_pending[ key ] && m_pending[ key ]->sequence <= written )
+        {
+            items[ count++ ] = *m_pending[ key ];
+
+            delete m_pending[ key ];
+            m_pending[ key ] = nullptr;
+        }
+    }
+
+    return count;
+}
+
+
+/*
+ *	Write a batch of frames
+ */
+bool    SysTrayXLinkWriter::writeFrames( const SysTrayXLinkWriteItem* items, int count )
+{
+    QByteArray frames[ WRITE_BATCH ];
+
+    for( int i = 0 ; i < count ; ++i )
+    {
+        frames[ i ] = items[ i ].frame;
+    }
+
+    return m_transport->write( frames, count );
+}
+
+
+/*****************************************************************************
+ *
+ *  SysTrayXLink Class
+ *
+ *****************************************************************************/
+
+
+/*
+ *	Constructor
+ */
+SysTrayXLink::SysTrayXLink( Preferences* pref, SysTrayXLinkTransport* transport ) : m_queue( FRAME_QUEUE_SIZE ),
+    m_bulk_queue( BULK_QUEUE_SIZE ), m_write_queue( WRITE_QUEUE_SIZE )
+{
+    /*
+     *  Store preferences
+     */
+    m_pref = pref;
+
+    /*
+     *  Initialize
+     */
+    for( int i = 0 ; i < REPEAT_PREFIXES.length() ; ++i )
+    {
+        m_last_frames.append( QByteArray() );
+    }
+    m_suppressed_frames = 0;
+
+    for( int key = 0 ; key < SysTrayXLinkWriteItem::KEY_COUNT ; ++key )
+    {
+        m_write_slots[ key ].store( nullptr );
+    }
+    m_coalesced_frames = 0;
+    m_resent_frames = 0;
+    m_write_sequence = 0;
+
+    m_resync_count = 0;
+    m_skipped_bytes = 0;
+    m_oversized_frames = 0;
+
+    m_bulk_in_flight.store( 0 );
+    m_bulk_frames = 0;
+    m_bulk_decode_last = 0;
+    m_bulk_decode_max = 0;
+
+    m_benchmark_thread = nullptr;
+
+    m_unread_snapshots = 0;
+    m_unread_deltas = 0;
+    m_poll_interval = -1;
+
+    /*
+     *  The unread model reports through the link
+     */
+    m_unread_model = new SysTrayXUnreadModel( this );
+    connect( m_unread_model, &SysTrayXUnreadModel::signalUnreadMail, this, &SysTrayXLink::signalUnreadMail );
+    connect( m_unread_model, &SysTrayXUnreadModel::signalAccountUnread, this, &SysTrayXLink::signalAccountUnread );
+
+    m_capabilities = 0;
+    m_addon_version = 0;
+    m_handshake_latency = -1;
+
+    m_link_state = LINK_CONNECTING;
+    m_heartbeat_interval = HEARTBEAT_INTERVAL;
+    m_heartbeat_deadline = HEARTBEAT_DEADLINE;
+    m_deadline_reported = false;
+    m_deadline_down = false;
+    m_ping_sequence = 0;
+    m_heartbeat_rtt = -1;
+    m_last_receive.start();
+
+    /*
+     *  Liveness check, started when the add-on supports the heartbeat
+     */
+    m_heartbeat_timer = new QTimer( this );
+    m_heartbeat_timer->setInterval( m_heartbeat_interval );
+    connect( m_heartbeat_timer, &QTimer::timeout, this, &SysTrayXLink::slotHeartbeat );
+
+    /*
+     *  Heartbeat timing from the environment, "interval,deadline[,down]" in ms
+     */
+    QList< QByteArray > heartbeat = qgetenv( HEARTBEAT_ENV ).split( ',' );
+    if( heartbeat.length() >= 2 && heartbeat.at( 0 ).toInt() > 0 && heartbeat.at( 1 ).toInt() > 0 )
+    {
+        setHeartbeat( heartbeat.at( 0 ).toInt(), heartbeat.at( 1 ).toInt(), heartbeat.length() > 2 && heartbeat.at( 2 ) == "down" );
+    }
+
+    if( transport == nullptr )
+    {
+        transport = new SysTrayXLinkStdioTransport();
+    }
+    m_transport = transport;
+    m_transport_name = transport->getName();
+    m_binary_framing = transport->isBinaryFraming();
+
+    /*
+     *  Open dump.txt
+     */
+//    m_dump = new QFile( "dump.txt", this );
+//    m_dump->open( QIODevice::WriteOnly );
+
+    /*
+     *  Setup the bulk decode thread
+     */
+    qRegisterMetaType< SysTrayXLinkBulkFrame >();
+
+    m_bulk_thread = new QThread( this );
+
+    SysTrayXLinkBulkWorker* bulk_worker = new SysTrayXLinkBulkWorker( &m_bulk_queue, &m_bulk_in_flight );
+    bulk_worker->moveToThread( m_bulk_thread );
+
+    connect( m_bulk_thread, &QThread::finished, bulk_worker, &QObject::deleteLater );
+    connect( bulk_worker, &SysTrayXLinkBulkWorker::signalDecoded, this, &SysTrayXLink::slotBulkFrame );
+    connect( this, &SysTrayXLink::signalDecodeBulk, bulk_worker, &SysTrayXLinkBulkWorker::slotDecode );
+
+    m_bulk_thread->start();
+
+    /*
+     *  Setup the reader thread
+     */
+    m_reader_thread = new QThread( this );
+
+    SysTrayXLinkReader* reader = new SysTrayXLinkReader( &m_queue, &m_bulk_queue, transport );
+    reader->moveToThread( m_reader_thread );
+
+    connect( m_reader_thread, &QThread::finished, reader, &QObject::deleteLater );
+    connect( reader, &SysTrayXLinkReader::signalFramesReady, this, &SysTrayXLink::slotLinkRead );
+    connect( reader, &SysTrayXLinkReader::signalBulkFramesReady, bulk_worker, &SysTrayXLinkBulkWorker::slotDecode );
+    connect( bulk_worker, &SysTrayXLinkBulkWorker::signalResumeReader, reader, &SysTrayXLinkReader::slotResume );
+    connect( this, &SysTrayXLink::signalResumeReader, reader, &SysTrayXLinkReader::slotResume );
+    connect( reader, &SysTrayXLinkReader::signalLinkClosed, this, &SysTrayXLink::slotLinkClosed );
+    connect( reader, &SysTrayXLinkReader::signalResync, this, &SysTrayXLink::slotResync );
+    connect( this, &SysTrayXLink::signalStopReader, reader, &SysTrayXLinkReader::stopThread );
+
+    connect( m_reader_thread, &QThread::started, reader, &SysTrayXLinkReader::startThread, Qt::QueuedConnection );
+    m_reader_thread->start();
+
+    /*
+     *  Setup the writer thread
+     */
+    m_writer_thread = new QThread( this );
+
+    m_writer = new SysTrayXLinkWriter( &m_write_queue, m_write_slots, transport );
+    m_writer->moveToThread( m_writer_thread );
+
+    connect( m_writer_thread, &QThread::finished, m_writer, &QObject::deleteLater );
+    connect( this, &SysTrayXLink::signalWriteFrames, m_writer, &SysTrayXLinkWriter::slotWrite );
+    connect( m_writer, &SysTrayXLinkWriter::signalWriteDone, this, &SysTrayXLink::slotWriteDone );
+    connect( m_writer, &SysTrayXLinkWriter::signalWriteError, this, &SysTrayXLink::slotLinkClosed );
+    connect( m_writer, &SysTrayXLinkWriter::signalFieldsDropped, this, &SysTrayXLink::slotFieldsDropped );
+
+    m_writer_thread->start();
+}
+
+
+/*
+ *	Destructor
+ */
+SysTrayXLink::~SysTrayXLink()
+{
+    /*
+     *  Cleanup
+     */
+//    m_dump->close();
+//    delete m_dump;
+
+    /*
+     *  A running benchmark ends by itself, it uses its own transports
+     */
+    if( m_benchmark_thread )
+    {
+        m_benchmark_thread->wait();
+    }
+
+    /*
+     *  Wake the threads blocked in a read or write of a hung peer,
+     *  the transport lives until the reader thread has finished
+     */
+    m_transport->cancel();
+
+    /*
+     *  Stop the threads, the writer first, the reader owns the transport
+     */
+    QThread* threads[] = { m_writer_thread, m_reader_thread, m_bulk_thread };
+    for( QThread* thread : threads )
+    {
+        thread->quit();
+        thread->wait();
+    }
+
+    for( int key = 0 ; key < SysTrayXLinkWriteItem::KEY_COUNT ; ++key )
+    {
+        delete m_write_slots[ key ].exchange( nullptr );
+    }
+}
+
+
+/*
+ *  Write a message to the link
+ */
+void    SysTrayXLink::linkWrite( const QByteArray& message, SysTrayXLinkWriteItem::WriteKey key, quint32 fields )
+{
+    if( m_link_state == LINK_DOWN )
+    {
+        return;
+    }
+
+    SysTrayXLinkWriteItem item;
+    item.frame = message;
+    item.queued = std::chrono::steady_clock::now();
+    item.fields = fields;
+
+    if( key != SysTrayXLinkWriteItem::KEY_NONE )
+    {
+        /*
+         *  Written after the frames queued before it
+         */
+        item.sequence = m_write_sequence;
+
+        /*
+         *  Replace the unsent frame of this type, if any
+         */
+        SysTrayXLinkWriteItem* old_item = m_write_slots[ key ].exchange( new SysTrayXLinkWriteItem( item ) );
+        if( old_item )
+        {
+            m_coalesced_frames++;
+            delete old_item;
+        }
+    }
+    else
+    {
+        item.sequence = ++m_write_sequence;
+
+        /*
+         *  Keep the order, only use the queue directly when nothing is waiting
+         */
+        if( !flushWriteBacklog() || !m_write_queue.push( item ) )
+        {
+            m_write_backlog.append( item );
+
+            /*
+             *  Try again after setting the flag, the writer could have drained the queue meanwhile
+             */
+            m_write_queue.setStalled();
+            flushWriteBacklog();
+        }
+    }
+
+    /*
+     *  Wake the writer, once for the whole batch
+     */
+    if( m_write_queue.requestWakeup() )
+    {
+        emit signalWriteFrames();
+    }
+}
+
+
+/*
+ *  Move the waiting frames into the write queue
+ */
+bool    SysTrayXLink::flushWriteBacklog()
+{
+    while( !m_write_backlog.isEmpty() )
+    {
+        if( !m_write_queue.push( m_write_backlog.first() ) )
+        {
+            return false;
+        }
+
+        m_write_backlog.removeFirst();
+    }
+
+    return true;
+}
+
+
+/*
+ *  Start the handshake
+ */
+void    SysTrayXLink::sendHello()
+{
+    QJsonObject helloObject;
+    helloObject.insert("version", PROTOCOL_VERSION );
+    helloObject.insert("capabilities", CAPABILITIES );
+
+    QJsonObject messageObject;
+    messageObject.insert("hello", helloObject );
+
+    m_hello_timer.start();
+
+    linkWrite( QJsonDocument( messageObject ).toJson( QJsonDocument::Compact ) );
+}
+
+
+/*
+ *  Get the negotiated capabilities
+ */
+int     SysTrayXLink::getCapabilities() const
+{
+    return m_capabilities;
+}
+
+
+/*
+ *  Get the link state
+ */
+SysTrayXLink::LinkState SysTrayXLink::getLinkState() const
+{
+    return m_link_state;
+}
+
+
+/*
+ *  Set the heartbeat timing
+ */
+void    SysTrayXLink::setHeartbeat( int interval, int deadline, bool deadline_down )
+{
+    m_heartbeat_interval = interval;
+    m_heartbeat_deadline = deadline;
+    m_deadline_down = deadline_down;
+
+    m_heartbeat_timer->setInterval( m_heartbeat_interval );
+}
+
+
+/*
+ *  Change the link state
+ */
+void    SysTrayXLink::setLinkState( LinkState state )
+{
+    if( m_link_state == state )
+    {
+        return;
+    }
+
+    m_link_state = state;
+
+    emit signalConsole( QString( "Link: %1" ).arg( LINK_STATE_NAMES[ state ] ) );
+    emit signalLinkState( state );
+}
+
+
+/*
+ *  Get the handshake latency
+ */
+qint64  SysTrayXLink::getHandshakeLatency() const
+{
+    return m_handshake_latency;
+}
+
+
+/*
+ *  Send the preferences to the add-on
+ */
+void    SysTrayXLink::sendPreferences( quint32 fields )
+{
+    /*
+     *  Fall back to the full preferences for an add-on without the fast paths
+     */
+    if( !( m_capabilities & CAP_DELTA_PREFS ) )
+    {
+        fields |= ALL_PREF_FIELDS;
+    }
+
+    if( !( m_capabilities & CAP_ICON_DIGESTS ) && ( fields & ( 1u << SysTrayXLinkDecoder::PREF_ICON_DIGEST ) ) )
+    {
+        fields |= 1u << SysTrayXLinkDecoder::PREF_ICON;
+    }
+
+    /*
+     *  Take back the unsent preferences, the new frame has to carry their fields too
+     */
+    SysTrayXLinkWriteItem* pending = m_write_slots[ SysTrayXLinkWriteItem::KEY_PREFERENCES ].exchange( nullptr );
+    if( pending )
+    {
+        fields |= pending->fields;
+        m_coalesced_frames++;
+        delete pending;
+    }
+
+    /*
+     *  Encode the changed preferences into a JSON doc, or CBOR if the transport carries it
+     */
+    QByteArray frame = EncodePreferences( *m_pref, fields, m_binary_framing );
+
+    /*
+     *  Send them to the add-on
+     */
+    linkWrite( frame, SysTrayXLinkWriteItem::KEY_PREFERENCES, fields );
+}
+
+
+/*
+ *  Request icon data from the add-on
+ */
+void    SysTrayXLink::sendIconRequest( const QByteArray& digest )
+{
+    QJsonObject requestObject;
+    requestObject.insert("iconRequest", QJsonValue::fromVariant( QString::fromLatin1( digest ) ) );
+
+    linkWrite( QJsonDocument( requestObject ).toJson( QJsonDocument::Compact ) );
+}
+
+
+/*
+ *  Send the recommended poll interval
+ */
+void    SysTrayXLink::sendPollInterval( int interval )
+{
+    m_poll_interval = interval;
+
+    if( m_capabilities & CAP_POLL_HINT )
+    {
+        linkWrite( QString( "{\"pollInterval\":%1}" ).arg( interval ).toUtf8() );
+    }
+}
+
+
+/*
+ *  Send the window normal command
+ */
+void    SysTrayXLink::sendWindowNormal()
+{
+    linkWrite( WINDOW_NORMAL_FRAME, SysTrayXLinkWriteItem::KEY_WINDOW );
+}
+
+
+/*
+ *  Send the window minimize command
+ */
+void    SysTrayXLink::sendWindowMinimize()
+{
+    linkWrite( WINDOW_MINIMIZED_FRAME, SysTrayXLinkWriteItem::KEY_WINDOW );
+}
+
+
+/*
+ *  Get the number of unsent frames replaced by a newer one
+ */
+quint64 SysTrayXLink::getCoalescedFrames() const
+{
+    return m_coalesced_frames;
+}
+
+
+/*
+ *  Get the number of dropped repeated frames
+ */
+quint64 SysTrayXLink::getSuppressedFrames() const
+{
+    return m_suppressed_frames;
+}
+
+
+/*
+ *  Get the unread mails per account and folder
+ */
+const SysTrayXUnreadModel*  SysTrayXLink::getUnreadModel() const
+{
+    return m_unread_model;
 }
 
 
 /*
- *  Send the window normal command
+ *  Check for a repeat of the last frame of the same type
  */
-void    SysTrayXLink::sendWindowNormal()
+bool    SysTrayXLink::isRepeatedFrame( const QByteArray& message )
 {
-    /*
-     *  Create command
-     */
-    QJsonObject windowObject;
-    windowObject.insert( "window", "normal" );
+    for( int i = 0 ; i < REPEAT_PREFIXES.length() ; ++i )
+    {
+        if( message.startsWith( REPEAT_PREFIXES.at( i ) ) )
+        {
+            if( m_last_frames.at( i ) == message )
+            {
+                return true;
+            }
 
-    /*
-     *  Create doc
-     */
-    QJsonDocument doc( windowObject );
+            m_last_frames[ i ] = message;
+            return false;
+        }
+    }
 
-    /*
-     *  Send the command
-     */
-    linkWrite( doc.toJson( QJsonDocument::Compact ) );
+    return false;
 }
 
 
 /*
- *  Send the window minimize command
+ *  Decode a JSON or CBOR frame
  */
-void    SysTrayXLink::sendWindowMinimize()
+bool    SysTrayXLink::decodeFrame( const QByteArray& frame, SysTrayXLinkDecoder::Message& message )
 {
-    /*
-     *  Create command
-     */
-    QJsonObject windowObject;
-    windowObject.insert("window", "minimized" );
-
-    /*
-     *  Create doc
-     */
-    QJsonDocument doc( windowObject );
+    if( !frame.isEmpty() && SysTrayXLinkDecoder::isCbor( frame.at( 0 ) ) )
+    {
+        /*
+         *  Binary framing
+         */
+        return SysTrayXLinkDecoder::decodeCbor( frame, message );
+    }
 
     /*
-     *  Send the command
+     *  Try the fast decoder first, fall back to a full JSON parse for unknown shapes
      */
-    linkWrite( doc.toJson( QJsonDocument::Compact ) );
+    return SysTrayXLinkDecoder::decode( frame, message ) || SysTrayXLinkDecoder::decodeJson( frame, message );
 }
 
 
@@ -281,40 +1563,98 @@ void    SysTrayXLink::sendWindowMinimize()
  */
 void    SysTrayXLink::DecodeMessage( const QByteArray& message )
 {
-    QJsonParseError jsonError;
-    QJsonDocument jsonResponse = QJsonDocument::fromJson( message, &jsonError );
+    SysTrayXLinkDecoder::Message msg;
+    if( decodeFrame( message, msg ) )
+    {
+        HandleMessage( msg );
+    }
+}
 
-    if( jsonError.error == QJsonParseError::NoError )
+
+/*
+ *  Handle a decoded message
+ */
+void    SysTrayXLink::HandleMessage( const SysTrayXLinkDecoder::Message& msg )
+{
+    if( msg.keys & SysTrayXLinkDecoder::KEY_HELLO_ACK )
     {
-        QJsonObject jsonObject = jsonResponse.object();
+        /*
+         *  Handshake done, enable the fast paths supported by both sides
+         */
+        m_addon_version = msg.version;
+        m_capabilities = CAPABILITIES & msg.capabilities;
+        m_handshake_latency = m_hello_timer.isValid() ? m_hello_timer.nsecsElapsed() / 1000 : -1;
 
-        if( jsonObject.contains( "unreadMail" ) && jsonObject[ "unreadMail" ].isDouble() )
-        {
-            int unreadMail = jsonObject[ "unreadMail" ].toInt();
-            emit signalUnreadMail( unreadMail );
-        }
+        emit signalConsole( QString( "Link: handshake version %1, capabilities 0x%2, latency %3 us" )
+                            .arg( m_addon_version ).arg( m_capabilities, 0, 16 ).arg( m_handshake_latency ) );
 
-        if( jsonObject.contains( "title" ) && jsonObject[ "title" ].isString() )
+        if( m_capabilities & CAP_HEARTBEAT )
         {
-            QString title = jsonObject[ "title" ].toString();
-            emit signalTitle( title );
+            m_heartbeat_timer->start();
         }
 
-        if( jsonObject.contains( "shutdown" ) && jsonObject[ "shutdown" ].isString() )
+        /*
+         *  Poll interval recommended before the handshake
+         */
+        if( m_poll_interval > 0 )
         {
-            emit signalAddOnShutdown();
+            sendPollInterval( m_poll_interval );
         }
+    }
 
-        if( jsonObject.contains( "window" ) && jsonObject[ "window" ].isString() )
+    if( msg.keys & SysTrayXLinkDecoder::KEY_PONG )
+    {
+        if( msg.pong == m_ping_sequence )
         {
-            QString window_state = jsonObject[ "window" ].toString();
-            emit signalWindowState( window_state );
+            m_heartbeat_rtt = m_ping_timer.nsecsElapsed() / 1000;
         }
+    }
 
-        if( jsonObject.contains( "preferences" ) && jsonObject[ "preferences" ].isObject() )
-        {
-            DecodePreferences( jsonObject[ "preferences" ].toObject() );
-        }
+    if( msg.keys & SysTrayXLinkDecoder::KEY_UNREAD_MAIL )
+    {
+        emit signalUnreadMail( msg.unread_mail );
+    }
+
+    if( msg.keys & SysTrayXLinkDecoder::KEY_UNREAD_FOLDERS )
+    {
+        DecodeUnreadFolders( msg, true );
+    }
+    else
+    if( msg.keys & SysTrayXLinkDecoder::KEY_UNREAD_DELTA )
+    {
+        DecodeUnreadFolders( msg, false );
+    }
+
+    if( msg.keys & SysTrayXLinkDecoder::KEY_TITLE )
+    {
+        QString title = QString::fromUtf8( msg.title );
+        emit signalTitle( title );
+    }
+
+    if( msg.keys & SysTrayXLinkDecoder::KEY_SHUTDOWN )
+    {
+        slotLinkClosed();
+        return;
+    }
+
+    if( msg.keys & SysTrayXLinkDecoder::KEY_WINDOW )
+    {
+        QString window_state = QString::fromUtf8( msg.window );
+        emit signalWindowState( window_state );
+    }
+
+    if( msg.keys & SysTrayXLinkDecoder::KEY_PREFERENCES )
+    {
+        DecodePreferences( msg );
+    }
+
+    if( msg.keys & SysTrayXLinkDecoder::KEY_ICON_REQUEST )
+    {
+        /*
+         *  The add-on does not know our icon, send the data with its digest
+         */
+        sendPreferences( ( 1u << SysTrayXLinkDecoder::PREF_ICON_MIME ) | ( 1u << SysTrayXLinkDecoder::PREF_ICON ) |
+                         ( 1u << SysTrayXLinkDecoder::PREF_ICON_DIGEST ) );
     }
 }
 
@@ -322,14 +1662,19 @@ void    SysTrayXLink::DecodeMessage( const QByteArray& message )
 /*
  *  Decode preferences from JSON message
  */
-void    SysTrayXLink::DecodePreferences( const QJsonObject& pref )
+void    SysTrayXLink::DecodePreferences( const SysTrayXLinkDecoder::Message& pref )
 { 
+    /*
+     *  Apply all received preferences at once
+     */
+    m_pref->beginUpdate();
+
     /*
      *  Check the received object
      */
-    if( pref.contains( "iconType" ) && pref[ "iconType" ].isString() )
+    if( pref.pref_keys & ( 1u << SysTrayXLinkDecoder::PREF_ICON_TYPE ) )
     {
-        Preferences::IconType icon_type = static_cast< Preferences::IconType >( pref[ "iconType" ].toString().toInt() );
+        Preferences::IconType icon_type = static_cast< Preferences::IconType >( pref.pref[ SysTrayXLinkDecoder::PREF_ICON_TYPE ].toInt() );
 
         /*
          *  Store the new icon type
@@ -337,9 +1682,9 @@ void    SysTrayXLink::DecodePreferences( const QJsonObject& pref )
         m_pref->setIconType( icon_type );
     }
 
-    if( pref.contains( "iconMime" ) && pref[ "iconMime" ].isString() )
+    if( pref.pref_keys & ( 1u << SysTrayXLinkDecoder::PREF_ICON_MIME ) )
     {
-        QString icon_mime = pref[ "iconMime" ].toString();
+        QString icon_mime = QString::fromUtf8( pref.pref[ SysTrayXLinkDecoder::PREF_ICON_MIME ] );
 
         /*
          *  Store the new icon mime
@@ -347,19 +1692,35 @@ void    SysTrayXLink::DecodePreferences( const QJsonObject& pref )
         m_pref->setIconMime( icon_mime );
     }
 
-    if( pref.contains( "icon" ) && pref[ "icon" ].isString() )
+    if( pref.pref_keys & ( 1u << SysTrayXLinkDecoder::PREF_ICON ) )
     {
-        QString icon_base64 = pref[ "icon" ].toString();
-
         /*
          *  Store the new icon data
          */
-        m_pref->setIconData( QByteArray::fromBase64( icon_base64.toUtf8() ) );
+        const QByteArray& icon = pref.pref[ SysTrayXLinkDecoder::PREF_ICON ];
+        m_pref->setIconData( pref.raw_icon ? icon : SysTrayXBase64::decode( icon ) );
+    }
+    else if( pref.pref_keys & ( 1u << SysTrayXLinkDecoder::PREF_ICON_DIGEST ) )
+    {
+        /*
+         *  Only the digest, use the local store or ask for the data
+         */
+        const QByteArray& digest = pref.pref[ SysTrayXLinkDecoder::PREF_ICON_DIGEST ];
+
+        QByteArray icon_data;
+        if( m_pref->findIcon( digest, icon_data ) )
+        {
+            m_pref->setIconData( icon_data );
+        }
+        else
+        {
+            sendIconRequest( digest );
+        }
     }
 
-    if( pref.contains( "hideOnMinimize" ) && pref[ "hideOnMinimize" ].isString() )
+    if( pref.pref_keys & ( 1u << SysTrayXLinkDecoder::PREF_HIDE_ON_MINIMIZE ) )
     {
-        bool hide_minimize = pref[ "hideOnMinimize" ].toString() == "true";
+        bool hide_minimize = pref.pref[ SysTrayXLinkDecoder::PREF_HIDE_ON_MINIMIZE ] == "true";
 
         /*
          *  Store the new hide on minimize state
@@ -367,9 +1728,9 @@ void    SysTrayXLink::DecodePreferences( const QJsonObject& pref )
         m_pref->setHideOnMinimize( hide_minimize );
     }
 
-    if( pref.contains( "startMinimized" ) && pref[ "startMinimized" ].isString() )
+    if( pref.pref_keys & ( 1u << SysTrayXLinkDecoder::PREF_START_MINIMIZED ) )
     {
-        bool start_minimized = pref[ "startMinimized" ].toString() == "true";
+        bool start_minimized = pref.pref[ SysTrayXLinkDecoder::PREF_START_MINIMIZED ] == "true";
 
         /*
          *  Store the new start minimized state
@@ -377,121 +1738,428 @@ void    SysTrayXLink::DecodePreferences( const QJsonObject& pref )
         m_pref->setStartMinimized( start_minimized );
     }
 
-    if( pref.contains( "debug" ) && pref[ "debug" ].isString() )
+    if( pref.pref_keys & ( 1u << SysTrayXLinkDecoder::PREF_DEBUG ) )
     {
-        bool debug = pref[ "debug" ].toString() == "true";
+        bool debug = pref.pref[ SysTrayXLinkDecoder::PREF_DEBUG ] == "true";
 
         /*
          *  Store the new debug state
          */
         m_pref->setDebug( debug );
     }
+
+    m_pref->commitUpdate();
 }
 
 
 /*
- *  Encode preferences to JSON message
+ *  Apply the unread folders to the model
  */
-void    SysTrayXLink::EncodePreferences( const Preferences& pref )
+void    SysTrayXLink::DecodeUnreadFolders( const SysTrayXLinkDecoder::Message& msg, bool snapshot )
 {
     /*
-     *  Setup the preferences JSON
+     *  Signal the new totals once for the whole message
      */
-    QJsonObject prefObject;
-    prefObject.insert("debug", QJsonValue::fromVariant( QString( pref.getDebug() ? "true" : "false" ) ) );
-    prefObject.insert("hideOnMinimize", QJsonValue::fromVariant( QString( pref.getHideOnMinimize() ? "true" : "false" ) ) );
-    prefObject.insert("startMinimized", QJsonValue::fromVariant( QString( pref.getStartMinimized() ? "true" : "false" ) ) );
-    prefObject.insert("iconType", QJsonValue::fromVariant( QString::number( pref.getIconType() ) ) );
-    prefObject.insert("iconMime", QJsonValue::fromVariant( pref.getIconMime() ) );
-    prefObject.insert("icon", QJsonValue::fromVariant( QString( pref.getIconData().toBase64() ) ) );
+    m_unread_model->beginUpdate();
+
+    if( snapshot )
+    {
+        m_unread_model->clear();
+        m_unread_snapshots++;
+    }
+    else
+    {
+        m_unread_deltas++;
+    }
+
+    foreach( const SysTrayXLinkDecoder::UnreadFolder& folder, msg.unread_folders )
+    {
+        m_unread_model->setUnread( QString::fromUtf8( folder.account ), QString::fromUtf8( folder.name ),
+                                   QString::fromUtf8( folder.folder ), folder.unread );
+    }
+
+    m_unread_model->commitUpdate();
+}
 
-    QJsonObject preferencesObject;
-    preferencesObject.insert("preferences", prefObject );
 
+/*
+ *  Encode preferences to JSON or CBOR message
+ */
+QByteArray  SysTrayXLink::EncodePreferences( const Preferences& pref, quint32 fields, bool binary )
+{
     /*
-     *  Store the new document
+     *  Setup the preferences, only the requested fields
      */
-    m_pref_json_doc = QJsonDocument( preferencesObject );
+    QVariantMap prefMap;
+
+    if( fields & ( 1u << SysTrayXLinkDecoder::PREF_DEBUG ) )
+    {
+        prefMap.insert("debug", QString( pref.getDebug() ? "true" : "false" ) );
+    }
+
+    if( fields & ( 1u << SysTrayXLinkDecoder::PREF_HIDE_ON_MINIMIZE ) )
+    {
+        prefMap.insert("hideOnMinimize", QString( pref.getHideOnMinimize() ? "true" : "false" ) );
+    }
+
+    if( fields & ( 1u << SysTrayXLinkDecoder::PREF_START_MINIMIZED ) )
+    {
+        prefMap.insert("startMinimized", QString( pref.getStartMinimized() ? "true" : "false" ) );
+    }
+
+    if( fields & ( 1u << SysTrayXLinkDecoder::PREF_ICON_TYPE ) )
+    {
+        prefMap.insert("iconType", QString::number( pref.getIconType() ) );
+    }
+
+    if( fields & ( 1u << SysTrayXLinkDecoder::PREF_ICON_MIME ) )
+    {
+        prefMap.insert("iconMime", pref.getIconMime() );
+    }
+
+    if( fields & ( 1u << SysTrayXLinkDecoder::PREF_ICON ) )
+    {
+        /*
+         *  CBOR carries the icon as a byte string, JSON as base64
+         */
+        if( binary )
+        {
+            prefMap.insert("icon", pref.getIconData() );
+        }
+        else
+        {
+            prefMap.insert("icon", QString::fromLatin1( SysTrayXBase64::encode( pref.getIconData() ) ) );
+        }
+    }
+
+    if( ( fields & ( 1u << SysTrayXLinkDecoder::PREF_ICON_DIGEST ) ) && !pref.getIconData().isEmpty() )
+    {
+        prefMap.insert("iconDigest", QString::fromLatin1( pref.getIconDigest() ) );
+    }
+
+    QVariantMap preferencesMap;
+    preferencesMap.insert("preferences", prefMap );
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+    if( binary )
+    {
+        return QCborValue( QCborMap::fromVariantMap( preferencesMap ) ).toCbor();
+    }
+#endif
+
+    return QJsonDocument( QJsonObject::fromVariantMap( preferencesMap ) ).toJson( QJsonDocument::Compact );
 }
 
 
 /*
- *  Relay shutdown signal
+ *  Start the link benchmarks on a worker thread
  */
-void    SysTrayXLink::slotAddOnShutdown()
+void    SysTrayXLink::slotBenchmark()
 {
-    emit signalAddOnShutdown();
+    if( m_benchmark_thread )
+    {
+        emit signalConsole( "Benchmark already running" );
+        return;
+    }
+
+    m_benchmark_thread = new QThread( this );
+
+    SysTrayXLinkBenchmark* benchmark = new SysTrayXLinkBenchmark();
+    benchmark->moveToThread( m_benchmark_thread );
+
+    connect( m_benchmark_thread, &QThread::started, benchmark, &SysTrayXLinkBenchmark::slotRun );
+    connect( m_benchmark_thread, &QThread::finished, benchmark, &QObject::deleteLater );
+    connect( m_benchmark_thread, &QThread::finished, this, &SysTrayXLink::slotBenchmarkDone );
+    connect( benchmark, &SysTrayXLinkBenchmark::signalConsole, this, &SysTrayXLink::signalConsole );
+    connect( benchmark, &SysTrayXLinkBenchmark::signalDone, m_benchmark_thread, &QThread::quit );
+
+    m_benchmark_thread->start();
 }
 
 
 /*
- *  Read the input
+ *  Cleanup the benchmark thread
+ */
+void    SysTrayXLink::slotBenchmarkDone()
+{
+    m_benchmark_thread->deleteLater();
+    m_benchmark_thread = nullptr;
+}
+
+
+/*
+ *  Show the link statistics
+ */
+void    SysTrayXLink::slotStatistics()
+{
+    emit signalConsole( QString( "Link: transport %1, protocol version %2, capabilities 0x%3, handshake latency %4 us" )
+                        .arg( m_transport_name ).arg( m_addon_version ).arg( m_capabilities, 0, 16 ).arg( m_handshake_latency ) );
+    emit signalConsole( QString( "Link: state %1, last frame %2 ms ago, heartbeat round trip %3 us" )
+                        .arg( LINK_STATE_NAMES[ m_link_state ] ).arg( m_last_receive.elapsed() ).arg( m_heartbeat_rtt ) );
+    emit signalConsole( QString( "Link: suppressed repeated frames %1" ).arg( m_suppressed_frames ) );
+    emit signalConsole( QString( "Link: resyncs %1, skipped bytes %2, oversized frames %3" )
+                        .arg( m_resync_count ).arg( m_skipped_bytes ).arg( m_oversized_frames ) );
+    emit signalConsole( QString( "Link: unread model %1 mails in %2 folders, snapshots %3, deltas %4" )
+                        .arg( m_unread_model->getTotal() ).arg( m_unread_model->getFolderCount() )
+                        .arg( m_unread_snapshots ).arg( m_unread_deltas ) );
+    emit signalConsole( QString( "Link: bulk frames %1, pending %2, decode last %3 us, max %4 us" )
+                        .arg( m_bulk_frames ).arg( m_bulk_queue.size() + m_bulk_in_flight.load() )
+                        .arg( m_bulk_decode_last ).arg( m_bulk_decode_max ) );
+    emit signalConsole( QString( "Link: write queue depth %1, backlog %2, coalesced frames %3, resent preferences %4" )
+                        .arg( m_write_queue.size() ).arg( m_write_backlog.length() ).arg( m_coalesced_frames ).arg( m_resent_frames ) );
+    emit signalConsole( QString( "Link: written frames %1 in %2 writes, latency last %3 us, avg %4 us, max %5 us" )
+                        .arg( m_writer->getFramesWritten() ).arg( m_writer->getBatchesWritten() )
+                        .arg( m_writer->getLatencyLast() ).arg( m_writer->getLatencyAverage() )
+                        .arg( m_writer->getLatencyMax() ) );
+}
+
+
+/*
+ *  The writer made room in the queue
+ */
+void    SysTrayXLink::slotWriteDone()
+{
+    if( !flushWriteBacklog() )
+    {
+        m_write_queue.setStalled();
+        flushWriteBacklog();
+    }
+
+    if( m_write_queue.requestWakeup() )
+    {
+        emit signalWriteFrames();
+    }
+}
+
+
+/*
+ *  Send the preference fields of a replaced held back frame again
+ */
+void    SysTrayXLink::slotFieldsDropped( quint32 fields )
+{
+    m_resent_frames++;
+
+    sendPreferences( fields );
+}
+
+
+/*
+ *  Report the corrupted data dropped by the reader
+ */
+void    SysTrayXLink::slotResync( quint64 resync_count, quint64 skipped_bytes, quint64 oversized_frames )
+{
+    if( oversized_frames > m_oversized_frames )
+    {
+        emit signalConsole( QString( "Link: dropped %1 frames larger than %2 bytes" )
+                            .arg( oversized_frames - m_oversized_frames ).arg( SysTrayXLinkRingBuffer::DEFAULT_MAX_FRAME_SIZE ) );
+    }
+    else
+    if( resync_count > m_resync_count )
+    {
+        emit signalConsole( QString( "Link: dropped corrupted data, %1 resyncs" ).arg( resync_count - m_resync_count ) );
+    }
+
+    m_resync_count = resync_count;
+    m_skipped_bytes = skipped_bytes;
+    m_oversized_frames = oversized_frames;
+}
+
+
+/*
+ *  The add-on closed the link, nobody left to talk to
  */
-void    SysTrayXLink::slotLinkRead( QByteArray message )
+void    SysTrayXLink::slotLinkClosed()
 {
     /*
-     *  Decode the message
+     *  End of stream, read or write error or shutdown message, only tear down once
      */
-    DecodeMessage( message );
+    if( m_link_state == LINK_DOWN )
+    {
+        return;
+    }
+
+    setLinkState( LINK_DOWN );
+
+    m_heartbeat_timer->stop();
+    emit signalStopReader();
+
+    emit signalAddOnShutdown();
 }
 
 
 /*
- *  Handle a debug state change signal
+ *  Check the liveness of the add-on
  */
-void    SysTrayXLink::slotDebugChange()
+void    SysTrayXLink::slotHeartbeat()
 {
-    if( m_pref->getAppPrefChanged() )
+    qint64 idle = m_last_receive.elapsed();
+
+    /*
+     *  A busy Thunderbird is no reason to quit, keep pinging until it answers unless told otherwise
+     */
+    if( idle >= m_heartbeat_deadline && !m_deadline_reported )
+    {
+        m_deadline_reported = true;
+
+        emit signalConsole( QString( "Link: no frames from the add-on for %1 ms" ).arg( idle ) );
+
+        if( m_deadline_down )
+        {
+            slotLinkClosed();
+            return;
+        }
+    }
+
+    if( idle >= 2 * m_heartbeat_interval )
+    {
+        /*
+         *  The last ping has not been answered
+         */
+        setLinkState( LINK_DEGRADED );
+    }
+
+    if( idle >= m_heartbeat_interval )
     {
-        sendPreferences();
+        m_ping_sequence++;
+        m_ping_timer.start();
+
+        linkWrite( QString( "{\"ping\":%1}" ).arg( m_ping_sequence ).toUtf8() );
     }
 }
 
 
 /*
- *  Handle a hide on minimize state change signal
+ *  Read the input
  */
-void    SysTrayXLink::slotHideOnMinimizeChange()
+void    SysTrayXLink::slotLinkRead()
 {
-    if( m_pref->getAppPrefChanged() )
+    /*
+     *  Acknowledge the wakeup before draining, frames queued from now on trigger a new one
+     */
+    m_queue.clearWakeup();
+
+    /*
+     *  Decode all pending messages
+     */
+    QByteArray message;
+    while( m_link_state != LINK_DOWN && m_queue.pop( message ) )
+    {
+        markReceived();
+
+        /*
+         *  Drop unchanged status updates before doing any work
+         */
+        if( isRepeatedFrame( message ) )
+        {
+            m_suppressed_frames++;
+            continue;
+        }
+
+        DecodeMessage( message );
+    }
+
+    /*
+     *  Let the reader continue if it was waiting for room
+     */
+    if( m_queue.takeStalled() )
     {
-        sendPreferences();
+        emit signalResumeReader();
     }
 }
 
 
 /*
- *  Handle a start minimized state change signal
+ *  Handle a decoded bulk frame
  */
-void    SysTrayXLink::slotStartMinimizedChange()
+void    SysTrayXLink::slotBulkFrame( const SysTrayXLinkBulkFrame& frame )
 {
-    if( m_pref->getAppPrefChanged() )
+    /*
+     *  Let the worker continue if it was waiting for room
+     */
+    if( m_bulk_in_flight.fetch_sub( 1 ) == SysTrayXLinkBulkWorker::MAX_IN_FLIGHT )
+    {
+        emit signalDecodeBulk();
+    }
+
+    /*
+     *  A shutdown may have overtaken the frame
+     */
+    if( m_link_state == LINK_DOWN )
+    {
+        return;
+    }
+
+    markReceived();
+
+    m_bulk_frames++;
+    m_bulk_decode_last = frame.decode_time;
+    m_bulk_decode_max = qMax( m_bulk_decode_max, frame.decode_time );
+
+    if( frame.valid )
     {
-        sendPreferences();
+        HandleMessage( frame.message );
     }
 }
 
 
 /*
- *  Handle the icon type change signal
+ *  The add-on is alive
  */
-void    SysTrayXLink::slotIconTypeChange()
+void    SysTrayXLink::markReceived()
 {
-    if( m_pref->getAppPrefChanged() )
+    m_last_receive.start();
+    m_deadline_reported = false;
+
+    if( m_link_state != LINK_UP )
     {
-        sendPreferences();
+        setLinkState( LINK_UP );
     }
 }
 
 
 /*
- *  Handle the icon data change signal
+ *  Handle a change in preferences
  */
-void    SysTrayXLink::slotIconDataChange()
+void    SysTrayXLink::slotPreferencesChange( quint32 changes )
 {
-    if( m_pref->getAppPrefChanged() )
+    if( !m_pref->getAppPrefChanged() )
+    {
+        return;
+    }
+
+    quint32 fields = 0;
+
+    if( changes & Preferences::PREF_DEBUG_CHANGE )
+    {
+        fields |= 1u << SysTrayXLinkDecoder::PREF_DEBUG;
+    }
+
+    if( changes & Preferences::PREF_HIDE_ON_MINIMIZE_CHANGE )
+    {
+        fields |= 1u << SysTrayXLinkDecoder::PREF_HIDE_ON_MINIMIZE;
+    }
+
+    if( changes & Preferences::PREF_START_MINIMIZED_CHANGE )
+    {
+        fields |= 1u << SysTrayXLinkDecoder::PREF_START_MINIMIZED;
+    }
+
+    if( changes & Preferences::PREF_ICON_TYPE_CHANGE )
+    {
+        fields |= 1u << SysTrayXLinkDecoder::PREF_ICON_TYPE;
+    }
+
+    if( changes & Preferences::PREF_ICON_DATA_CHANGE )
+    {
+        fields |= ( 1u << SysTrayXLinkDecoder::PREF_ICON_MIME ) | ( 1u << SysTrayXLinkDecoder::PREF_ICON_DIGEST );
+    }
+
+    /*
+     *  One message for the whole transaction
+     */
+    if( fields )
     {
-        sendPreferences();
+        sendPreferences( fields );
     }
 }
 
@@ -512,3 +2180,12 @@ void    SysTrayXLink::slotWindowMinimize()
 {
     sendWindowMinimize();
 }
+
+
+/*
+ *  Handle the poll interval signal
+ */
+void    SysTrayXLink::slotPollInterval( int interval )
+{
+    sendPollInterval( interval );
+}
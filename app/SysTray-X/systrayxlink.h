@@ -6,13 +6,29 @@
  *	Local includes
  */
 #include "preferences.h"
+#include "systrayxlinkqueue.h"
+#include "systrayxlinkdecoder.h"
+#include "systrayxlinktransport.h"
+#include "systrayxunreadmodel.h"
+
+
+/*
+ *  System includes
+ */
+#include <atomic>
+#include <chrono>
 
 
 /*
  *	Qt includes
  */
 #include <QObject>
+#include <QList>
+#include <QByteArray>
 #include <QJsonDocument>
+#include <QElapsedTimer>
+#include <QMetaType>
+#include <QMap>
 
 
 /*
@@ -23,215 +39,1378 @@ class QTimer;
 class QThread;
 
 
+/*
+ *  Queue of received frames, reader thread to GUI thread
+ */
+typedef SysTrayXLinkQueue< QByteArray > SysTrayXLinkFrameQueue;
+
+
 /**
- * @brief The SysTrayXLinkReader class. Reader thread.
+ * @brief The SysTrayXLinkBulkFrame class. A bulk frame decoded by the bulk worker.
  */
-class SysTrayXLinkReader : public QObject
+class SysTrayXLinkBulkFrame
 {
-    Q_OBJECT
+    public:
+
+        SysTrayXLinkBulkFrame()
+        {
+            valid = false;
+            decode_time = 0;
+        }
+
+        /**
+         * @brief frame. The frame, keeps the data referenced by the message.
+         */
+        QByteArray  frame;
+
+        /**
+         * @brief message. The decoded message, the icon is binary.
+         */
+        SysTrayXLinkDecoder::Message    message;
+
+        /**
+         * @brief valid. The frame could be decoded.
+         */
+        bool    valid;
+
+        /**
+         * @brief decode_time. Time needed to decode the frame (us).
+         */
+        qint64  decode_time;
+};
+
+Q_DECLARE_METATYPE( SysTrayXLinkBulkFrame )
+
+
+/**
+ * @brief The SysTrayXLinkWriteItem class. A frame waiting to be written.
+ */
+class SysTrayXLinkWriteItem
+{
+    public:
+
+        /*
+         *  Message types where only the newest unsent frame is written
+         */
+        enum WriteKey
+        {
+            KEY_NONE = -1,
+            KEY_WINDOW = 0,
+            KEY_PREFERENCES,
+            KEY_COUNT
+        };
 
     public:
 
+        SysTrayXLinkWriteItem()
+        {
+            fields = 0;
+            sequence = 0;
+        }
+
         /**
-         * @brief Reader. Constructor, destructor.
+         * @brief frame. The frame data.
          */
-        SysTrayXLinkReader();
-        ~SysTrayXLinkReader();
+        QByteArray  frame;
 
         /**
-         * @brief stopThread. Stop the thread.
+         * @brief queued. Time the frame was queued.
          */
-        void    stopThread();
+        std::chrono::steady_clock::time_point   queued;
 
-    public slots:
+        /**
+         * @brief fields. Content of the frame (preference field bits).
+         */
+        quint32 fields;
 
         /**
-         * @brief startThread. Start the thread.
+         * @brief sequence. Order of a queued frame.
+         *                  A coalesced frame holds the sequence of the queued frame it has to follow.
          */
-        void	startThread();
+        quint64 sequence;
+};
+
+
+/*
+ *  Queue of frames to be send, GUI thread to writer thread
+ */
+typedef SysTrayXLinkQueue< SysTrayXLinkWriteItem >  SysTrayXLinkWriteQueue;
+
+
+/*
+ *  Newest unsent frame of a message type, GUI thread to writer thread
+ */
+typedef std::atomic< SysTrayXLinkWriteItem* >   SysTrayXLinkWriteSlot;
+
+
+/**
+ * @brief The SysTrayXLinkRingBuffer class. Reusable receive buffer and frame splitter.
+ */
+class SysTrayXLinkRingBuffer
+{
+    public:
 
         /**
-         * @brief slotWorker. The worker thread started by a "timer".
+         * @brief INITIAL_CAPACITY. Initial size of the buffer (power of 2).
          */
-        void	slotWorker();
+        static const int INITIAL_CAPACITY = 64 * 1024;
 
-    signals:
+        /**
+         * @brief DEFAULT_MAX_FRAME_SIZE. Default largest accepted frame.
+         *
+         *  Room for the preferences with the largest custom icon in base64 and for large unread folder lists.
+         */
+        static const int DEFAULT_MAX_FRAME_SIZE = 4 * 1024 * 1024;
+
+    public:
 
         /**
-         * @brief signalReceivedMessage. Signal the received message.
+         * @brief SysTrayXLinkRingBuffer. Constructor.
          *
-         *  @param message  The received message.
+         *  @param max_frame_size   The largest accepted frame.
          */
-        void    signalReceivedMessage( QByteArray message );
+        SysTrayXLinkRingBuffer( int max_frame_size = DEFAULT_MAX_FRAME_SIZE );
 
         /**
-         * @brief signalAddOnShutdown. Signal to shutdown the app.
+         * @brief getMaxFrameSize. Get the largest accepted frame size.
+         *
+         *  @return     The size.
          */
-        void    signalAddOnShutdown();
+        int getMaxFrameSize() const;
+
+        /**
+         * @brief setBinaryFraming. Accept CBOR frames next to JSON frames.
+         *
+         *  @param state    The state.
+         */
+        void    setBinaryFraming( bool state );
+
+        /**
+         * @brief readFrom. Read as much data as fits from a file descriptor.
+         *
+         *  @param fd   The file descriptor.
+         *
+         *  @return     Number of bytes read, 0 at end of stream, -1 on error (errno).
+         */
+        qint64  readFrom( int fd );
+
+        /**
+         * @brief append. Append data to the buffer.
+         *
+         *  @param data     The data.
+         *  @param len      The length of the data.
+         */
+        void    append( const char* data, int len );
+
+        /**
+         * @brief nextFrame. Get the next complete frame and remove it from the buffer.
+         *                   The frame stays valid until new data is added to the buffer.
+         *
+         *  @param data     Pointer to the frame data.
+         *  @param len      Length of the frame.
+         *
+         *  @return     Frame available.
+         */
+        bool    nextFrame( const char** data, int* len );
+
+        /**
+         * @brief getResyncCount. Get the number of corruptions recovered from.
+         *
+         *  @return     The count.
+         */
+        quint64 getResyncCount() const;
+
+        /**
+         * @brief getSkippedBytes. Get the number of bytes dropped while resyncing.
+         *
+         *  @return     The count.
+         */
+        quint64 getSkippedBytes() const;
+
+        /**
+         * @brief getOversizedFrames. Get the number of frames dropped for exceeding the largest accepted size.
+         *
+         *  @return     The count.
+         */
+        quint64 getOversizedFrames() const;
 
     private:
 
         /**
-         * @brief m_timer. Worker timer.
+         * @brief peek. Copy data from the buffer without removing it.
+         *
+         *  @param offset   Offset from the start of the pending data.
+         *  @param dest     The destination.
+         *  @param len      The number of bytes to copy.
          */
-        QTimer* m_timer;
+        void    peek( int offset, char* dest, int len ) const;
 
         /**
-         * @brief m_doWork. Status of the worker thread.
+         * @brief byteAt. Get a byte from the buffer.
+         *
+         *  @param offset   Offset from the start of the pending data.
+         *
+         *  @return     The byte.
          */
-        bool	m_doWork;
+        char    byteAt( int offset ) const;
+
+        /**
+         * @brief skip. Remove data from the buffer.
+         *
+         *  @param len      The number of bytes.
+         */
+        void    skip( int len );
+
+        /**
+         * @brief resync. Drop a byte of corrupted data.
+         */
+        void    resync();
+
+        /**
+         * @brief reserve. Make sure the buffer can hold the data.
+         *
+         *  @param len      The number of bytes.
+         */
+        void    reserve( int len );
+
+    private:
+
+        /**
+         * @brief m_data. The buffer storage.
+         */
+        QByteArray  m_data;
+
+        /**
+         * @brief m_scratch. Storage for frames wrapping around the end of the buffer.
+         */
+        QByteArray  m_scratch;
+
+        /**
+         * @brief m_mask. Index mask (capacity - 1).
+         */
+        int m_mask;
+
+        /**
+         * @brief m_head. Index of the first pending byte.
+         */
+        int m_head;
+
+        /**
+         * @brief m_used. Number of pending bytes.
+         */
+        int m_used;
+
+        /**
+         * @brief m_max_frame_size. The largest accepted frame.
+         */
+        int m_max_frame_size;
+
+        /**
+         * @brief m_resyncing. Searching for the next valid frame.
+         */
+        bool    m_resyncing;
+
+        /**
+         * @brief m_binary_framing. Accept CBOR frames.
+         */
+        bool    m_binary_framing;
+
+        /**
+         * @brief m_resync_count. Number of corruptions recovered from.
+         */
+        quint64 m_resync_count;
+
+        /**
+         * @brief m_skipped_bytes. Number of bytes dropped while resyncing.
+         */
+        quint64 m_skipped_bytes;
+
+        /**
+         * @brief m_oversized_frames. Number of frames dropped for exceeding the largest accepted size.
+         */
+        quint64 m_oversized_frames;
 };
 
 
 /**
- * @brief The SysTrayXLink class. Handles the communications link.
+ * @brief The SysTrayXLinkReader class. Reader thread.
  */
-class SysTrayXLink : public QObject
+class SysTrayXLinkReader : public QObject
 {
     Q_OBJECT
 
     public:
 
         /**
-         * @brief SysTrayXLink. Constructor, destructor.
+         * @brief Reader. Constructor, destructor.
+         *
+         *  @param queue        The queue for the received control frames.
+         *  @param bulk_queue   The queue for the received bulk frames.
+         *  @param transport    The transport, owned by the reader from now on.
          */
-        SysTrayXLink( Preferences* pref );
-        ~SysTrayXLink();
+        SysTrayXLinkReader( SysTrayXLinkFrameQueue* queue, SysTrayXLinkFrameQueue* bulk_queue, SysTrayXLinkTransport* transport );
+        ~SysTrayXLinkReader();
 
         /**
-         * @brief linkWrite. Write a message to the link.
-         *
-         *  @param message  Message to be written.
+         * @brief stopThread. Stop the thread.
          */
-        void    linkWrite( const QByteArray& message );
+        void    stopThread();
+
+    public slots:
 
         /**
-         * @brief sendPreferences. Send the preferences to the add-on.
+         * @brief startThread. Start the thread.
          */
-        void    sendPreferences();
+        void	startThread();
 
         /**
-         * @brief sendWindowNormal. Send the window normal command.
+         * @brief slotWorker. The worker thread started by a "timer".
          */
-        void sendWindowNormal();
+        void	slotWorker();
 
         /**
-         * @brief sendWindowMinimize. Send the window minimize command.
+         * @brief slotReadyRead. Read all available data from the transport.
          */
-        void    sendWindowMinimize();
+        void    slotReadyRead();
+
+        /**
+         * @brief slotResume. Continue after the queue has been drained.
+         */
+        void    slotResume();
 
     private:
 
         /**
-         * @brief MessageDecode. Decode a JSON message.
+         * @brief processFrames. Queue all complete frames from the buffer.
          *
-         * @param message   The message.
+         *  @return     False if a queue is full.
          */
-        void    DecodeMessage( const QByteArray& message );
+        bool    processFrames();
 
         /**
-         * @brief DecodePreferences. Decode a JSON preference object.
+         * @brief isStalled. Check for a full queue, marks the queues as stalled.
          *
-         * @param pref  The JSON preferences.
+         *  @return     True if the reader has to wait.
          */
-        void    DecodePreferences( const QJsonObject& pref );
+        bool    isStalled();
 
         /**
-         * @brief EncodePreferences. Encode the preferences into a JSON document.
-         *
-         *  @param pref     The preferences.
+         * @brief linkClosed. Handle the end of the input stream.
+         */
+        void    linkClosed();
+
+        /**
+         * @brief reportResync. Signal changed resync counters of the buffer.
          */
-        void    EncodePreferences( const Preferences& pref );
+        void    reportResync();
 
     signals:
 
         /**
-         * @brief signalTitle. Signal to title the app.
+         * @brief signalFramesReady. Signal new frames in the queue (once per batch).
          */
-        void    signalTitle( QString title );
+        void    signalFramesReady();
 
         /**
-         * @brief signalAddOnShutdown. Signal to shutdown the app.
+         * @brief signalBulkFramesReady. Signal new frames in the bulk queue (once per batch).
          */
-        void    signalAddOnShutdown();
+        void    signalBulkFramesReady();
 
         /**
-         * @brief signalWindowState. Signal a change in the window state.
+         * @brief signalLinkClosed. Signal the input stream has been closed.
          */
-        void    signalWindowState( QString state );
+        void    signalLinkClosed();
 
         /**
-         * @brief signalUnreadMail. Signal numder of unread mails.
+         * @brief signalResync. Signal the buffer dropped corrupted data.
          *
-         * @param unreadMail    The number of unread mails.
+         *  @param resync_count     Number of corruptions recovered from.
+         *  @param skipped_bytes    Number of bytes dropped while resyncing.
+         *  @param oversized_frames     Number of frames dropped for exceeding the largest accepted size.
          */
-        void    signalUnreadMail( int unread_mail );
+        void    signalResync( quint64 resync_count, quint64 skipped_bytes, quint64 oversized_frames );
 
-    public slots:
+    private:
 
         /**
-         * @brief slotDebugChange. Handle a change in debug state.
+         * @brief m_timer. Worker timer.
          */
-        void    slotDebugChange();
+        QTimer* m_timer;
 
         /**
-         * @brief slotHideOnMinimizeChange. Handle a change in hide on minimize state.
+         * @brief m_transport. Pointer to the transport.
          */
-        void    slotHideOnMinimizeChange();
+        SysTrayXLinkTransport*  m_transport;
 
         /**
-         * @brief slotStartMinimizeChange. Handle a change in start minimized state.
+         * @brief m_ring. Storage for the received, not yet handled, data.
          */
-        void    slotStartMinimizedChange();
+        SysTrayXLinkRingBuffer  m_ring;
 
         /**
-         * @brief slotIconTypeChange. Slot for handling icon type change signals.
+         * @brief m_queue. Pointer to the queue for the received control frames.
          */
-        void    slotIconTypeChange();
+        SysTrayXLinkFrameQueue* m_queue;
 
         /**
-         * @brief slotIconDataChange. Slot for handling icon data change signals.
+         * @brief m_bulk_queue. Pointer to the queue for the received bulk frames.
          */
-        void    slotIconDataChange();
+        SysTrayXLinkFrameQueue* m_bulk_queue;
 
         /**
-         * @brief slotWindowNormal. Slot for handling window normal signals.
+         * @brief m_eof. End of the input stream reached.
          */
-        void    slotWindowNormal();
+        bool    m_eof;
 
         /**
-         * @brief slotWindowMinimize. Slot for handling window minimize signals.
+         * @brief m_doWork. Status of the worker thread.
          */
-        void    slotWindowMinimize();
+        bool	m_doWork;
 
-     private slots:
+        /**
+         * @brief m_reported_resyncs. Resync count of the last signalResync.
+         */
+        quint64 m_reported_resyncs;
+
+        /**
+         * @brief m_reported_skipped. Skipped bytes of the last signalResync.
+         */
+        quint64 m_reported_skipped;
+
+        /**
+         * @brief m_reported_oversized. Oversized frames of the last signalResync.
+         */
+        quint64 m_reported_oversized;
+};
+
+
+/**
+ * @brief The SysTrayXLinkBulkWorker class. Decodes the bulk frames off the GUI thread.
+ */
+class SysTrayXLinkBulkWorker : public QObject
+{
+    Q_OBJECT
+
+    public:
+
+        /**
+         * @brief MAX_IN_FLIGHT. Maximum number of decoded frames waiting for the GUI thread.
+         */
+        static const int MAX_IN_FLIGHT = 4;
+
+    public:
+
+        /**
+         * @brief SysTrayXLinkBulkWorker. Constructor.
+         *
+         *  @param queue        The queue for the received bulk frames.
+         *  @param in_flight    Number of decoded frames not yet handled by the GUI thread.
+         */
+        SysTrayXLinkBulkWorker( SysTrayXLinkFrameQueue* queue, std::atomic< int >* in_flight );
+
+    public slots:
+
+        /**
+         * @brief slotDecode. Decode the queued frames.
+         */
+        void    slotDecode();
+
+    signals:
 
         /**
-         * @brief slotLinkRead. Read the link.
+         * @brief signalDecoded. Signal a decoded frame.
+         *
+         *  @param frame    The frame.
          */
-        void    slotLinkRead( QByteArray message );
+        void    signalDecoded( const SysTrayXLinkBulkFrame& frame );
 
         /**
-         * @brief slotAddOnShutdown. Handle sahutdown signal from reader thread.
+         * @brief signalResumeReader. Signal the reader there is room in the queue again.
          */
-        void    slotAddOnShutdown();
+        void    signalResumeReader();
 
     private:
 
         /**
-         * @brief m_reader_thread. Pointer to the reader thread.
+         * @brief m_queue. Pointer to the queue for the received bulk frames.
          */
-        QThread*    m_reader_thread;
+        SysTrayXLinkFrameQueue* m_queue;
 
         /**
-         * @brief m_pref. Pointer to the preferences storage.
+         * @brief m_in_flight. Pointer to the number of decoded frames not yet handled.
          */
-        Preferences*    m_pref;
+        std::atomic< int >* m_in_flight;
+};
+
+
+/**
+ * @brief The SysTrayXLinkBenchmark class. Runs the link benchmarks off the GUI thread.
+ */
+class SysTrayXLinkBenchmark : public QObject
+{
+    Q_OBJECT
+
+    public slots:
+
+        /**
+         * @brief slotRun. Run the decoder, base64 and transport benchmarks.
+         */
+        void    slotRun();
+
+    signals:
+
+        /**
+         * @brief signalConsole. Send a result line.
+         *
+         *  @param message  The line.
+         */
+        void    signalConsole( QString message );
+
+        /**
+         * @brief signalDone. Signal the benchmarks are done.
+         */
+        void    signalDone();
+};
+
+
+/**
+ * @brief The SysTrayXLinkWriter class. Writer thread.
+ */
+class SysTrayXLinkWriter : public QObject
+{
+    Q_OBJECT
+
+    public:
+
+        /**
+         * @brief WRITE_BATCH. Maximum number of frames per write.
+         */
+        static const int WRITE_BATCH = SysTrayXLinkStreamTransport::WRITE_BATCH;
+
+    public:
+
+        /**
+         * @brief SysTrayXLinkWriter. Constructor.
+         *
+         *  @param queue        The queue with the frames to be send.
+         *  @param slots        The newest frame per message type (KEY_COUNT entries).
+         *  @param transport    The transport, owned by the reader.
+         */
+        SysTrayXLinkWriter( SysTrayXLinkWriteQueue* queue, SysTrayXLinkWriteSlot* slots, SysTrayXLinkTransport* transport );
+
+        /**
+         * @brief ~SysTrayXLinkWriter. Destructor.
+         */
+        ~SysTrayXLinkWriter();
+
+        /**
+         * @brief getFramesWritten. Get the number of written frames.
+         *
+         *  @return     The count.
+         */
+        quint64 getFramesWritten() const;
+
+        /**
+         * @brief getBatchesWritten. Get the number of write calls.
+         *
+         *  @return     The count.
+         */
+        quint64 getBatchesWritten() const;
+
+        /**
+         * @brief getLatencyLast. Get the queue to written time of the last frame.
+         *
+         *  @return     The time in microseconds.
+         */
+        quint64 getLatencyLast() const;
+
+        /**
+         * @brief getLatencyMax. Get the largest queue to written time.
+         *
+         *  @return     The time in microseconds.
+         */
+        quint64 getLatencyMax() const;
+
+        /**
+         * @brief getLatencyAverage. Get the average queue to written time.
+         *
+         *  @return     The time in microseconds.
+         */
+        quint64 getLatencyAverage() const;
+
+    public slots:
+
+        /**
+         * @brief slotWrite. Write all queued frames.
+         */
+        void    slotWrite();
+
+    private:
+
+        /**
+         * @brief writeFrames. Write a batch of frames.
+         *
+         *  @param items    The frames.
+         *  @param count    The number of frames.
+         *
+         *  @return     Success.
+         */
+        bool    writeFrames( const SysTrayXLinkWriteItem* items, int count );
+
+        /**
+         * @brief takePending. Add the held back coalesced frames that may be written now.
+         *
+         *  @param items    The batch.
+         *  @param count    The number of frames in the batch.
+         *  @param written  The sequence of the last queued frame in the batch.
+         *
+         *  @return     The new number of frames in the batch.
+         */
+        int takePending( SysTrayXLinkWriteItem* items, int count, quint64 written );
+
+    signals:
+
+        /**
+         * @brief signalWriteDone. Signal there is room in the queue again.
+         */
+        void    signalWriteDone();
+
+        /**
+         * @brief signalWriteError. Signal the output stream failed.
+         */
+        void    signalWriteError();
+
+        /**
+         * @brief signalFieldsDropped. Signal a held back preferences frame was replaced by one without all its fields.
+         *
+         *  @param fields   The preference field bits missing from the newer frame.
+         */
+        void    signalFieldsDropped( quint32 fields );
+
+    private:
+
+        /**
+         * @brief m_queue. Pointer to the queue with the frames to be send.
+         */
+        SysTrayXLinkWriteQueue* m_queue;
+
+        /**
+         * @brief m_slots. Pointer to the newest frame per message type.
+         */
+        SysTrayXLinkWriteSlot*  m_slots;
+
+        /**
+         * @brief m_transport. Pointer to the transport.
+         */
+        SysTrayXLinkTransport*  m_transport;
+
+        /**
+         * @brief m_pending. Coalesced frames waiting for the queued frame they follow.
+         */
+        SysTrayXLinkWriteItem*  m_pending[ SysTrayXLinkWriteItem::KEY_COUNT ];
+
+        /**
+         * @brief m_written_sequence. Sequence of the last written queued frame.
+         */
+        quint64 m_written_sequence;
+
+        /**
+         * @brief m_frames_written. Number of written frames.
+         */
+        std::atomic< quint64 >  m_frames_written;
+
+        /**
+         * @brief m_batches_written. Number of write calls.
+         */
+        std::atomic< quint64 >  m_batches_written;
+
+        /**
+         * @brief m_latency_last. Queue to written time of the last frame (us).
+         */
+        std::atomic< quint64 >  m_latency_last;
+
+        /**
+         * @brief m_latency_max. Largest queue to written time (us).
+         */
+        std::atomic< quint64 >  m_latency_max;
+
+        /**
+         * @brief m_latency_total. Sum of the queue to written times (us).
+         */
+        std::atomic< quint64 >  m_latency_total;
+};
+
+
+/**
+ * @brief The SysTrayXLink class. Handles the communications link.
+ */
+class SysTrayXLink : public QObject
+{
+    Q_OBJECT
+
+    public:
+
+        /**
+         * @brief FRAME_QUEUE_SIZE. Number of received frames waiting for the GUI thread.
+         */
+        static const int FRAME_QUEUE_SIZE = 256;
+
+        /**
+         * @brief BULK_QUEUE_SIZE. Number of received bulk frames waiting for the bulk worker.
+         */
+        static const int BULK_QUEUE_SIZE = 16;
+
+        /*
+         *  Protocol capabilities (bits)
+         */
+        enum Capability
+        {
+            CAP_DELTA_PREFS = 0x01,
+            CAP_ICON_DIGESTS = 0x04,
+            CAP_PUSH_UNREAD = 0x08,
+            CAP_HEARTBEAT = 0x10,
+            CAP_UNREAD_MODEL = 0x20,
+            CAP_POLL_HINT = 0x40
+        };
+
+        /*
+         *  Link states
+         */
+        enum LinkState
+        {
+            LINK_CONNECTING = 0,
+            LINK_UP,
+            LINK_DEGRADED,
+            LINK_DOWN
+        };
+
+        /**
+         * @brief PROTOCOL_VERSION. Version of the link protocol.
+         */
+        static const int PROTOCOL_VERSION = 1;
+
+        /**
+         * @brief CAPABILITIES. Capabilities supported by the app.
+         */
+        static const int CAPABILITIES = CAP_DELTA_PREFS | CAP_ICON_DIGESTS | CAP_PUSH_UNREAD | CAP_HEARTBEAT | CAP_UNREAD_MODEL |
+                                        CAP_POLL_HINT;
+
+        /**
+         * @brief LINK_STATE_NAMES. The link state names.
+         */
+        static const char* const    LINK_STATE_NAMES[];
+
+        /**
+         * @brief HEARTBEAT_ENV. Environment variable overriding the heartbeat timing, "interval,deadline[,down]".
+         */
+        static const char* const    HEARTBEAT_ENV;
+
+        /**
+         * @brief HEARTBEAT_INTERVAL. Default time without received frames before a ping is send (ms).
+         */
+        static const int HEARTBEAT_INTERVAL = 5000;
+
+        /**
+         * @brief HEARTBEAT_DEADLINE. Default time without received frames before the add-on is reported unresponsive (ms).
+         */
+        static const int HEARTBEAT_DEADLINE = 60000;
+
+        /**
+         * @brief WRITE_QUEUE_SIZE. Number of frames waiting for the writer thread.
+         */
+        static const int WRITE_QUEUE_SIZE = 256;
+
+        /**
+         * @brief WINDOW_NORMAL_FRAME. Pre-encoded window normal command.
+         */
+        static const QByteArray WINDOW_NORMAL_FRAME;
+
+        /**
+         * @brief WINDOW_MINIMIZED_FRAME. Pre-encoded window minimize command.
+         */
+        static const QByteArray WINDOW_MINIMIZED_FRAME;
+
+        /**
+         * @brief ALL_PREF_FIELDS. All preference fields (bits, 1 << SysTrayXLinkDecoder::PrefKey).
+         *
+         *  The icon data itself is only send on request, the digest identifies it.
+         */
+        static const quint32 ALL_PREF_FIELDS = ( ( 1u << SysTrayXLinkDecoder::PREF_KEY_COUNT ) - 1 ) &
+                                               ~( 1u << SysTrayXLinkDecoder::PREF_ICON );
+
+        /**
+         * @brief REPEAT_PREFIXES. Frame starts of the message types where repeated frames are dropped.
+         */
+        static const QList< QByteArray >    REPEAT_PREFIXES;
+
+    public:
+
+        /**
+         * @brief SysTrayXLink. Constructor, destructor.
+         *
+         *  @param pref         The preferences.
+         *  @param transport    The transport, nullptr for stdin / stdout. The link takes ownership.
+         */
+        SysTrayXLink( Preferences* pref, SysTrayXLinkTransport* transport = nullptr );
+        ~SysTrayXLink();
+
+        /**
+         * @brief linkWrite. Queue a message for the writer thread, never blocks.
+         *
+         *  @param message  Message to be written.
+         *  @param key      Message type, a newer message replaces an unsent one of the same type.
+         *  @param fields   Content of the message.
+         */
+        void    linkWrite( const QByteArray& message, SysTrayXLinkWriteItem::WriteKey key = SysTrayXLinkWriteItem::KEY_NONE,
+                           quint32 fields = 0 );
+
+        /**
+         * @brief sendHello. Start the handshake, the add-on answers with its capabilities and preferences.
+         */
+        void    sendHello();
+
+        /**
+         * @brief getCapabilities. Get the capabilities supported by both sides.
+         *
+         *  @return     The capabilities (bits, Capability), 0 before the handshake.
+         */
+        int     getCapabilities() const;
+
+        /**
+         * @brief getLinkState. Get the state of the link.
+         *
+         *  @return     The state.
+         */
+        LinkState   getLinkState() const;
+
+        /**
+         * @brief setHeartbeat. Set the heartbeat timing, used when the add-on supports it.
+         *
+         *  After interval ms without received frames a ping is send, after two intervals the link
+         *  is degraded, after deadline ms the add-on is reported unresponsive. By default only the
+         *  end of the stream or a read / write error takes the link down, a Thunderbird busy with a
+         *  large folder would otherwise lose its tray icon.
+         *
+         *  @param interval     The ping interval in ms.
+         *  @param deadline     The deadline in ms.
+         *  @param deadline_down    Take the link down when the deadline is missed.
+         */
+        void    setHeartbeat( int interval, int deadline, bool deadline_down );
+
+        /**
+         * @brief getHandshakeLatency. Get the time between hello and the answer.
+         *
+         *  @return     The latency in us, -1 before the handshake.
+         */
+        qint64  getHandshakeLatency() const;
+
+        /**
+         * @brief sendPreferences. Send the changed preferences to the add-on.
+         *
+         *  @param fields   The changed preference fields.
+         */
+        void    sendPreferences( quint32 fields = ALL_PREF_FIELDS );
+
+        /**
+         * @brief sendIconRequest. Request icon data unknown to the app from the add-on.
+         *
+         *  @param digest   The digest of the icon.
+         */
+        void    sendIconRequest( const QByteArray& digest );
+
+        /**
+         * @brief sendPollInterval. Send the recommended unread mail poll interval.
+         *
+         *  Send after the handshake if the add-on supports it.
+         *
+         *  @param interval     The interval in ms.
+         */
+        void    sendPollInterval( int interval );
+
+        /**
+         * @brief sendWindowNormal. Send the window normal command.
+         */
+        void sendWindowNormal();
+
+        /**
+         * @brief sendWindowMinimize. Send the window minimize command.
+         */
+        void    sendWindowMinimize();
+
+        /**
+         * @brief getCoalescedFrames. Get the number of unsent frames replaced by a newer one.
+         *
+         *  @return     The count.
+         */
+        quint64 getCoalescedFrames() const;
+
+        /**
+         * @brief getSuppressedFrames. Get the number of dropped repeated frames.
+         *
+         *  @return     The count.
+         */
+        quint64 getSuppressedFrames() const;
+
+        /**
+         * @brief getUnreadModel. Get the unread mails per account and folder.
+         *
+         *  @return     The model, only filled when the add-on supports it.
+         */
+        const SysTrayXUnreadModel*  getUnreadModel() const;
+
+        /**
+         * @brief decodeFrame. Decode a JSON or CBOR frame.
+         *
+         *  @param frame    The frame.
+         *  @param message  Storage for the decoded message.
+         *
+         *  @return     False if the frame could not be decoded.
+         */
+        static bool decodeFrame( const QByteArray& frame, SysTrayXLinkDecoder::Message& message );
+
+    private:
+
+        /**
+         * @brief isRepeatedFrame. Check for a repeat of the last frame of the same type.
+         *
+         *  @param message  The message.
+         *
+         *  @return     True if the frame can be dropped.
+         */
+        bool    isRepeatedFrame( const QByteArray& message );
+
+        /**
+         * @brief setLinkState. Change the link state.
+         *
+         *  @param state    The new state.
+         */
+        void    setLinkState( LinkState state );
+
+        /**
+         * @brief flushWriteBacklog. Move the waiting frames into the write queue.
+         *
+         *  @return     True if all frames are queued.
+         */
+        bool    flushWriteBacklog();
+
+        /**
+         * @brief MessageDecode. Decode a JSON message.
+         *
+         * @param message   The message.
+         */
+        void    DecodeMessage( const QByteArray& message );
+
+        /**
+         * @brief HandleMessage. Handle a decoded message.
+         *
+         * @param msg   The decoded message.
+         */
+        void    HandleMessage( const SysTrayXLinkDecoder::Message& msg );
+
+        /**
+         * @brief markReceived. The add-on is alive, a frame has been received.
+         */
+        void    markReceived();
+
+        /**
+         * @brief DecodePreferences. Decode the preferences of a message.
+         *
+         * @param pref  The decoded message.
+         */
+        void    DecodePreferences( const SysTrayXLinkDecoder::Message& pref );
+
+        /**
+         * @brief DecodeUnreadFolders. Apply the unread folders of a message to the model.
+         *
+         * @param msg       The decoded message.
+         * @param snapshot  The message contains all folders.
+         */
+        void    DecodeUnreadFolders( const SysTrayXLinkDecoder::Message& msg, bool snapshot );
+
+        /**
+         * @brief EncodePreferences. Encode the preferences into a message.
+         *
+         *  @param pref     The preferences.
+         *  @param fields   The preference fields to encode.
+         *
+         *  @param binary   Encode as CBOR instead of JSON.
+         *
+         *  @return     The message.
+         */
+        QByteArray  EncodePreferences( const Preferences& pref, quint32 fields, bool binary );
+
+    signals:
+
+        /**
+         * @brief signalTitle. Signal to title the app.
+         */
+        void    signalTitle( QString title );
+
+        /**
+         * @brief signalAddOnShutdown. Signal to shutdown the app.
+         */
+        void    signalAddOnShutdown();
+
+        /**
+         * @brief signalWindowState. Signal a change in the window state.
+         */
+        void    signalWindowState( QString state );
+
+        /**
+         * @brief signalUnreadMail. Signal numder of unread mails.
+         *
+         * @param unreadMail    The number of unread mails.
+         */
+        void    signalUnreadMail( int unread_mail );
+
+        /**
+         * @brief signalAccountUnread. Signal the unread mails per account.
+         *
+         *  @param accounts     The counts by account name.
+         */
+        void    signalAccountUnread( const QMap< QString, int >& accounts );
+
+        /**
+         * @brief signalConsole. Send a console message.
+         *
+         *  @param message      The message.
+         */
+        void    signalConsole( QString message );
+
+        /**
+         * @brief signalWriteFrames. Signal the writer there are frames in the queue.
+         */
+        void    signalWriteFrames();
+
+        /**
+         * @brief signalResumeReader. Signal the reader there is room in the queue again.
+         */
+        void    signalResumeReader();
+
+        /**
+         * @brief signalStopReader. Signal the reader to stop.
+         */
+        void    signalStopReader();
+
+        /**
+         * @brief signalDecodeBulk. Signal the bulk worker there is room for decoded frames again.
+         */
+        void    signalDecodeBulk();
+
+        /**
+         * @brief signalLinkState. Signal a change of the link state.
+         *
+         *  @param state    The new state.
+         */
+        void    signalLinkState( SysTrayXLink::LinkState state );
+
+    public slots:
+
+        /**
+         * @brief slotPreferencesChange. Handle a change in preferences.
+         *
+         *  @param changes  The changes (bits, Preferences::PrefChange).
+         */
+        void    slotPreferencesChange( quint32 changes );
+
+        /**
+         * @brief slotWindowNormal. Slot for handling window normal signals.
+         */
+        void    slotWindowNormal();
+
+        /**
+         * @brief slotWindowMinimize. Slot for handling window minimize signals.
+         */
+        void    slotWindowMinimize();
+
+        /**
+         * @brief slotPollInterval. Slot for handling poll interval signals.
+         *
+         *  @param interval     The interval in ms.
+         */
+        void    slotPollInterval( int interval );
+
+        /**
+         * @brief slotBenchmark. Start the link benchmarks on a worker thread.
+         */
+        void    slotBenchmark();
+
+        /**
+         * @brief slotStatistics. Show the link statistics.
+         */
+        void    slotStatistics();
+
+     private slots:
+
+        /**
+         * @brief slotLinkRead. Handle all queued control frames.
+         */
+        void    slotLinkRead();
+
+        /**
+         * @brief slotBulkFrame. Handle a decoded bulk frame.
+         *
+         *  @param frame    The frame.
+         */
+        void    slotBulkFrame( const SysTrayXLinkBulkFrame& frame );
+
+        /**
+         * @brief slotLinkClosed. Handle the closing of the link by the add-on, tears the link down once.
+         */
+        void    slotLinkClosed();
+
+        /**
+         * @brief slotBenchmarkDone. Cleanup the benchmark thread.
+         */
+        void    slotBenchmarkDone();
+
+        /**
+         * @brief slotHeartbeat. Check the liveness of the add-on.
+         */
+        void    slotHeartbeat();
+
+        /**
+         * @brief slotWriteDone. Handle room in the write queue.
+         */
+        void    slotWriteDone();
+
+        /**
+         * @brief slotFieldsDropped. Send the preference fields lost by the writer again.
+         *
+         *  @param fields   The preference field bits.
+         */
+        void    slotFieldsDropped( quint32 fields );
+
+        /**
+         * @brief slotResync. Report the corrupted data dropped by the reader.
+         *
+         *  @param resync_count     Number of corruptions recovered from.
+         *  @param skipped_bytes    Number of bytes dropped while resyncing.
+         *  @param oversized_frames     Number of frames dropped for exceeding the largest accepted size.
+         */
+        void    slotResync( quint64 resync_count, quint64 skipped_bytes, quint64 oversized_frames );
+
+    private:
+
+        /**
+         * @brief m_reader_thread. Pointer to the reader thread.
+         */
+        QThread*    m_reader_thread;
+
+        /**
+         * @brief m_writer_thread. Pointer to the writer thread.
+         */
+        QThread*    m_writer_thread;
+
+        /**
+         * @brief m_bulk_thread. Pointer to the bulk decode thread.
+         */
+        QThread*    m_bulk_thread;
+
+        /**
+         * @brief m_benchmark_thread. Pointer to the benchmark thread, nullptr when idle.
+         */
+        QThread*    m_benchmark_thread;
+
+        /**
+         * @brief m_writer. Pointer to the writer.
+         */
+        SysTrayXLinkWriter* m_writer;
+
+        /**
+         * @brief m_transport. Pointer to the transport, owned by the reader.
+         */
+        SysTrayXLinkTransport*  m_transport;
+
+        /**
+         * @brief m_transport_name. Name of the transport.
+         */
+        QString m_transport_name;
+
+        /**
+         * @brief m_binary_framing. The transport carries CBOR frames.
+         */
+        bool    m_binary_framing;
+
+        /**
+         * @brief m_queue. Queue for the received control frames.
+         */
+        SysTrayXLinkFrameQueue  m_queue;
+
+        /**
+         * @brief m_bulk_queue. Queue for the received bulk frames.
+         */
+        SysTrayXLinkFrameQueue  m_bulk_queue;
+
+        /**
+         * @brief m_bulk_in_flight. Number of decoded bulk frames not yet handled.
+         */
+        std::atomic< int >  m_bulk_in_flight;
+
+        /**
+         * @brief m_bulk_frames. Number of handled bulk frames.
+         */
+        quint64 m_bulk_frames;
+
+        /**
+         * @brief m_bulk_decode_last. Decode time of the last bulk frame (us).
+         */
+        qint64  m_bulk_decode_last;
+
+        /**
+         * @brief m_bulk_decode_max. Maximum decode time of a bulk frame (us).
+         */
+        qint64  m_bulk_decode_max;
+
+        /**
+         * @brief m_write_queue. Queue for the frames to be send.
+         */
+        SysTrayXLinkWriteQueue  m_write_queue;
+
+        /**
+         * @brief m_write_backlog. Frames waiting for room in the write queue.
+         */
+        QList< SysTrayXLinkWriteItem >  m_write_backlog;
+
+        /**
+         * @brief m_write_slots. Newest unsent frame per message type.
+         */
+        SysTrayXLinkWriteSlot   m_write_slots[ SysTrayXLinkWriteItem::KEY_COUNT ];
+
+        /**
+         * @brief m_coalesced_frames. Number of unsent frames replaced by a newer one.
+         */
+        quint64 m_coalesced_frames;
+
+        /**
+         * @brief m_resent_frames. Number of preferences frames send again for the fields of a replaced held back frame.
+         */
+        quint64 m_resent_frames;
+
+        /**
+         * @brief m_resync_count. Number of corruptions the reader recovered from.
+         */
+        quint64 m_resync_count;
+
+        /**
+         * @brief m_skipped_bytes. Number of bytes the reader dropped while resyncing.
+         */
+        quint64 m_skipped_bytes;
+
+        /**
+         * @brief m_oversized_frames. Number of frames the reader dropped for exceeding the largest accepted size.
+         */
+        quint64 m_oversized_frames;
+
+        /**
+         * @brief m_write_sequence. Sequence of the last queued frame.
+         */
+        quint64 m_write_sequence;
+
+        /**
+         * @brief m_pref. Pointer to the preferences storage.
+         */
+        Preferences*    m_pref;
+
+        /**
+         * @brief m_last_frames. The last frame of each type in REPEAT_PREFIXES.
+         */
+        QList< QByteArray > m_last_frames;
+
+        /**
+         * @brief m_suppressed_frames. Number of dropped repeated frames.
+         */
+        quint64 m_suppressed_frames;
+
+        /**
+         * @brief m_unread_model. Unread mails per account and folder.
+         */
+        SysTrayXUnreadModel*    m_unread_model;
+
+        /**
+         * @brief m_unread_snapshots. Number of received unread folder snapshots.
+         */
+        quint64 m_unread_snapshots;
+
+        /**
+         * @brief m_unread_deltas. Number of received unread folder changes.
+         */
+        quint64 m_unread_deltas;
+
+        /**
+         * @brief m_poll_interval. Last recommended poll interval (ms), -1 if none.
+         */
+        int m_poll_interval;
+
+        /**
+         * @brief m_capabilities. Capabilities supported by both sides.
+         */
+        int m_capabilities;
+
+        /**
+         * @brief m_addon_version. Protocol version of the add-on.
+         */
+        int m_addon_version;
+
+        /**
+         * @brief m_hello_timer. Time since the hello.
+         */
+        QElapsedTimer   m_hello_timer;
+
+        /**
+         * @brief m_handshake_latency. Time between the hello and the answer (us).
+         */
+        qint64  m_handshake_latency;
+
+        /**
+         * @brief m_link_state. State of the link.
+         */
+        LinkState   m_link_state;
+
+        /**
+         * @brief m_heartbeat_timer. Liveness check timer.
+         */
+        QTimer* m_heartbeat_timer;
+
+        /**
+         * @brief m_heartbeat_interval. Time without received frames before a ping (ms).
+         */
+        int m_heartbeat_interval;
+
+        /**
+         * @brief m_heartbeat_deadline. Time without received frames before the add-on is reported unresponsive (ms).
+         */
+        int m_heartbeat_deadline;
+
+        /**
+         * @brief m_deadline_reported. The missed deadline has been reported.
+         */
+        bool    m_deadline_reported;
+
+        /**
+         * @brief m_deadline_down. Take the link down when the deadline is missed.
+         */
+        bool    m_deadline_down;
+
+        /**
+         * @brief m_last_receive. Time since the last received frame.
+         */
+        QElapsedTimer   m_last_receive;
+
+        /**
+         * @brief m_ping_timer. Time since the last ping.
+         */
+        QElapsedTimer   m_ping_timer;
+
+        /**
+         * @brief m_ping_sequence. Sequence number of the last ping.
+         */
+        int m_ping_sequence;
 
         /**
-         * @brief m_pref_json_doc. Temporary storage for the preferences to be send.
+         * @brief m_heartbeat_rtt. Round trip time of the last answered ping (us).
          */
-        QJsonDocument   m_pref_json_doc;
+        qint64  m_heartbeat_rtt;
 };
 
 #endif // SYSTRAYXLINK_H
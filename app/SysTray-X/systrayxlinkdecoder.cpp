@@ -0,0 +1,1191 @@
+#include "systrayxlinkdecoder.h"
+
+/*
+ *	Local includes
+ */
+
+
+/*
+ *  System includes
+ */
+#include <cstring>
+
+
+/*
+ *	Qt includes
+ */
+#include <QPair>
+#include <QList>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QJsonArray>
+#include <QElapsedTimer>
+#include <QVariantMap>
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+#include <QCborStreamReader>
+#include <QCborValue>
+#include <QCborMap>
+#endif
+
+
+/*
+ *  Constants
+ */
+const char* const   SysTrayXLinkDecoder::PREF_NAMES[ PREF_KEY_COUNT ] = {
+    "debug",
+    "hideOnMinimize",
+    "startMinimized",
+    "iconType",
+    "iconMime",
+    "icon",
+    "iconDigest"
+};
+
+
+/*
+ *  Decode a message by tokenizing it in place
+ */
+bool    SysTrayXLinkDecoder::decode( const QByteArray& frame, Message& message )
+{
+    const char* pos = frame.constData();
+    const char* end = pos + frame.size();
+
+    message = Message();
+
+    skipSpace( pos, end );
+    if( pos == end || *pos != '{' )
+    {
+        return false;
+    }
+
+    ++pos;
+    skipSpace( pos, end );
+
+    bool last = ( pos < end && *pos == '}' );
+    if( last )
+    {
+        ++pos;
+    }
+
+    while( !last )
+    {
+        const char* key;
+        int key_len;
+
+        if( !parseKey( pos, end, key, key_len ) )
+        {
+            return false;
+        }
+
+        /*
+         *  Dispatch on the key, the case labels are hashed at compile time.
+         *  A collision within the key set would be a duplicate case label.
+         */
+        switch( keyHashOf( key, key_len ) )
+        {
+            case keyHash( "unreadMail" ):
+            {
+                if( !isKey( key, key_len, "unreadMail" ) || !parseInt( pos, end, message.unread_mail ) )
+                {
+                    return false;
+                }
+
+                message.keys |= KEY_UNREAD_MAIL;
+                break;
+            }
+
+            case keyHash( "title" ):
+            {
+                if( !isKey( key, key_len, "title" ) || !parseString( pos, end, message.title ) )
+                {
+                    return false;
+                }
+
+                message.keys |= KEY_TITLE;
+                break;
+            }
+
+            case keyHash( "shutdown" ):
+            {
+                QByteArray shutdown;
+                if( !isKey( key, key_len, "shutdown" ) || !parseString( pos, end, shutdown ) )
+                {
+                    return false;
+                }
+
+                message.keys |= KEY_SHUTDOWN;
+                break;
+            }
+
+            case keyHash( "window" ):
+            {
+                if( !isKey( key, key_len, "window" ) || !parseString( pos, end, message.window ) )
+                {
+                    return false;
+                }
+
+                message.keys |= KEY_WINDOW;
+                break;
+            }
+
+            case keyHash( "iconRequest" ):
+            {
+                if( !isKey( key, key_len, "iconRequest" ) || !parseString( pos, end, message.icon_request ) )
+                {
+                    return false;
+                }
+
+                message.keys |= KEY_ICON_REQUEST;
+                break;
+            }
+
+            case keyHash( "pong" ):
+            {
+                if( !isKey( key, key_len, "pong" ) || !parseInt( pos, end, message.pong ) )
+                {
+                    return false;
+                }
+
+                message.keys |= KEY_PONG;
+                break;
+            }
+
+            case keyHash( "helloAck" ):
+            {
+                if( !isKey( key, key_len, "helloAck" ) || !parseHelloAck( pos, end, message ) )
+                {
+                    return false;
+                }
+
+                message.keys |= KEY_HELLO_ACK;
+                break;
+            }
+
+            case keyHash( "preferences" ):
+            {
+                if( !isKey( key, key_len, "preferences" ) || !parsePreferences( pos, end, message ) )
+                {
+                    return false;
+                }
+
+                message.keys |= KEY_PREFERENCES;
+                break;
+            }
+
+            default:
+            {
+                /*
+                 *  Unknown key
+                 */
+                return false;
+            }
+        }
+
+        if( !parseNext( pos, end, last ) )
+        {
+            return false;
+        }
+    }
+
+    skipSpace( pos, end );
+
+    return pos == end;
+}
+
+
+/*
+ *  Decode a message using QJsonDocument
+ */
+bool    SysTrayXLinkDecoder::decodeJson( const QByteArray& frame, Message& message )
+{
+    message = Message();
+
+    QJsonParseError jsonError;
+    QJsonDocument jsonResponse = QJsonDocument::fromJson( frame, &jsonError );
+
+    if( jsonError.error != QJsonParseError::NoError )
+    {
+        return false;
+    }
+
+    QJsonObject jsonObject = jsonResponse.object();
+
+    if( jsonObject.contains( "unreadMail" ) && jsonObject[ "unreadMail" ].isDouble() )
+    {
+        message.unread_mail = jsonObject[ "unreadMail" ].toInt();
+        message.keys |= KEY_UNREAD_MAIL;
+    }
+
+    if( jsonObject.contains( "title" ) && jsonObject[ "title" ].isString() )
+    {
+        message.title = jsonObject[ "title" ].toString().toUtf8();
+        message.keys |= KEY_TITLE;
+    }
+
+    if( jsonObject.contains( "shutdown" ) && jsonObject[ "shutdown" ].isString() )
+    {
+        message.keys |= KEY_SHUTDOWN;
+    }
+
+    if( jsonObject.contains( "window" ) && jsonObject[ "window" ].isString() )
+    {
+        message.window = jsonObject[ "window" ].toString().toUtf8();
+        message.keys |= KEY_WINDOW;
+    }
+
+    if( jsonObject.contains( "iconRequest" ) && jsonObject[ "iconRequest" ].isString() )
+    {
+        message.icon_request = jsonObject[ "iconRequest" ].toString().toUtf8();
+        message.keys |= KEY_ICON_REQUEST;
+    }
+
+    if( jsonObject.contains( "pong" ) && jsonObject[ "pong" ].isDouble() )
+    {
+        message.pong = jsonObject[ "pong" ].toInt();
+        message.keys |= KEY_PONG;
+    }
+
+    if( jsonObject.contains( "helloAck" ) && jsonObject[ "helloAck" ].isObject() )
+    {
+        QJsonObject hello = jsonObject[ "helloAck" ].toObject();
+
+        message.version = hello[ "version" ].toInt();
+        message.capabilities = hello[ "capabilities" ].toInt();
+        message.keys |= KEY_HELLO_ACK;
+    }
+
+    if( jsonObject.contains( "preferences" ) && jsonObject[ "preferences" ].isObject() )
+    {
+        QJsonObject pref = jsonObject[ "preferences" ].toObject();
+
+        for( int i = 0 ; i < PREF_KEY_COUNT ; ++i )
+        {
+            if( pref.contains( PREF_NAMES[ i ] ) && pref[ PREF_NAMES[ i ] ].isString() )
+            {
+                message.pref[ i ] = pref[ PREF_NAMES[ i ] ].toString().toUtf8();
+                message.pref_keys |= 1u << i;
+            }
+        }
+
+        message.keys |= KEY_PREFERENCES;
+    }
+
+    /*
+     *  Unread mails per folder, a full snapshot or only the changed folders
+     */
+    static const struct { const char* name; quint32 key; } UNREAD_KEYS[] = {
+        { "unreadFolders", KEY_UNREAD_FOLDERS },
+        { "unreadDelta", KEY_UNREAD_DELTA }
+    };
+
+    for( const auto& unread_key : UNREAD_KEYS )
+    {
+        if( !jsonObject.contains( unread_key.name ) || !jsonObject[ unread_key.name ].isArray() )
+        {
+            continue;
+        }
+
+        foreach( const QJsonValue& value, jsonObject[ unread_key.name ].toArray() )
+        {
+            QJsonObject entry = value.toObject();
+            if( !entry[ "account" ].isString() || !entry[ "unread" ].isDouble() )
+            {
+                continue;
+            }
+
+            UnreadFolder folder;
+            folder.account = entry[ "account" ].toString().toUtf8();
+            folder.name = entry[ "name" ].toString().toUtf8();
+            folder.folder = entry[ "folder" ].toString().toUtf8();
+            folder.unread = entry[ "unread" ].toInt();
+
+            message.unread_folders.append( folder );
+        }
+
+        message.keys |= unread_key.key;
+    }
+
+    return true;
+}
+
+
+/*
+ *  Decode a CBOR message
+ */
+bool    SysTrayXLinkDecoder::decodeCbor( const QByteArray& frame, Message& message )
+{
+    message = Message();
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+
+    QCborStreamReader reader( frame );
+    if( !reader.isMap() || !reader.enterContainer() )
+    {
+        return false;
+    }
+
+    while( reader.lastError() == QCborError::NoError && reader.hasNext() )
+    {
+        QByteArray key;
+        if( !reader.isString() || !readCborString( reader, key ) )
+        {
+            return false;
+        }
+
+        bool ok = true;
+        switch( keyHashOf( key.constData(), key.size() ) )
+        {
+            case keyHash( "unreadMail" ):
+            {
+                ok = isKey( key.constData(), key.size(), "unreadMail" ) && reader.isInteger();
+                if( ok )
+                {
+                    message.unread_mail = static_cast< int >( reader.toInteger() );
+                    message.keys |= KEY_UNREAD_MAIL;
+                    reader.next();
+                }
+                break;
+            }
+
+            case keyHash( "pong" ):
+            {
+                ok = isKey( key.constData(), key.size(), "pong" ) && reader.isInteger();
+                if( ok )
+                {
+                    message.pong = static_cast< int >( reader.toInteger() );
+                    message.keys |= KEY_PONG;
+                    reader.next();
+                }
+                break;
+            }
+
+            case keyHash( "title" ):
+            {
+                ok = isKey( key.constData(), key.size(), "title" ) && readCborString( reader, message.title );
+                message.keys |= KEY_TITLE;
+                break;
+            }
+
+            case keyHash( "shutdown" ):
+            {
+                QByteArray shutdown;
+                ok = isKey( key.constData(), key.size(), "shutdown" ) && readCborString( reader, shutdown );
+                message.keys |= KEY_SHUTDOWN;
+                break;
+            }
+
+            case keyHash( "window" ):
+            {
+                ok = isKey( key.constData(), key.size(), "window" ) && readCborString( reader, message.window );
+                message.keys |= KEY_WINDOW;
+                break;
+            }
+
+            case keyHash( "iconRequest" ):
+            {
+                ok = isKey( key.constData(), key.size(), "iconRequest" ) && readCborString( reader, message.icon_request );
+                message.keys |= KEY_ICON_REQUEST;
+                break;
+            }
+
+            case keyHash( "helloAck" ):
+            {
+                ok = isKey( key.constData(), key.size(), "helloAck" ) && readCborHelloAck( reader, message );
+                message.keys |= KEY_HELLO_ACK;
+                break;
+            }
+
+            case keyHash( "preferences" ):
+            {
+                ok = isKey( key.constData(), key.size(), "preferences" ) && readCborPreferences( reader, message );
+                message.keys |= KEY_PREFERENCES;
+                break;
+            }
+
+            default:
+            {
+                /*
+                 *  Unknown key, skip the value
+                 */
+                ok = reader.next();
+                break;
+            }
+        }
+
+        if( !ok )
+        {
+            return false;
+        }
+    }
+
+    return reader.lastError() == QCborError::NoError && reader.leaveContainer();
+
+#else
+
+    Q_UNUSED( frame )
+
+    return false;
+
+#endif
+}
+
+
+/*
+ *  Classify a frame
+ */
+bool    SysTrayXLinkDecoder::isBulk( const char* data, int len )
+{
+    static const char* const BULK_PREFIXES[] = {
+        "{\"preferences\"",
+        "\xA1\x6B" "preferences",
+        "{\"unreadFolders\"",
+        "{\"unreadDelta\""
+    };
+
+    if( len >= BULK_FRAME_SIZE )
+    {
+        return true;
+    }
+
+    /*
+     *  The add-on sends these as the only key
+     */
+    for( const char* prefix : BULK_PREFIXES )
+    {
+        int prefix_len = static_cast< int >( strlen( prefix ) );
+        if( len >= prefix_len && memcmp( data, prefix, prefix_len ) == 0 )
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+/*
+ *  Compare the decoders
+ */
+QStringList SysTrayXLinkDecoder::benchmark( int iterations )
+{
+    /*
+     *  Typical add-on messages
+     */
+    QByteArray icon( 4 * 1024, 0 );
+    for( int i = 0 ; i < icon.size() ; ++i )
+    {
+        icon[ i ] = static_cast< char >( i * 7 );
+    }
+
+    QList< QPair< QString, QByteArray > > frames;
+    frames.append( qMakePair( QString( "unreadMail" ), QByteArray( "{\"unreadMail\":42}" ) ) );
+    frames.append( qMakePair( QString( "title" ), QByteArray( "{\"title\":\"- Mozilla Thunderbird\"}" ) ) );
+    frames.append( qMakePair( QString( "window" ), QByteArray( "{\"window\":\"minimized\"}" ) ) );
+    frames.append( qMakePair( QString( "preferences" ), QByteArray( "{\"preferences\":{\"debug\":\"false\",\"hideOnMinimize\":\"true\","
+            "\"startMinimized\":\"false\",\"iconType\":\"2\",\"iconMime\":\"image/png\",\"icon\":\"" ) + icon.toBase64() + "\"}}" ) );
+
+    QStringList results;
+    results.append( QString( "Decoder benchmark, %1 iterations" ).arg( iterations ) );
+
+    for( int f = 0 ; f < frames.length() ; ++f )
+    {
+        const QByteArray& frame = frames.at( f ).second;
+
+        Message message;
+        quint32 check = 0;
+
+        QElapsedTimer timer;
+        timer.start();
+
+        for( int i = 0 ; i < iterations ; ++i )
+        {
+            decode( frame, message );
+            check += message.keys;
+        }
+
+        qint64 stream_ns = qMax( timer.nsecsElapsed(), Q_INT64_C( 1 ) );
+
+        timer.restart();
+
+        for( int i = 0 ; i < iterations ; ++i )
+        {
+            decodeJson( frame, message );
+            check -= message.keys;
+        }
+
+        qint64 json_ns = qMax( timer.nsecsElapsed(), Q_INT64_C( 1 ) );
+
+        double stream_rate = iterations * 1e9 / stream_ns;
+        double json_rate = iterations * 1e9 / json_ns;
+
+        results.append( QString( "%1 (%2 bytes): stream %3 frames/s, json %4 frames/s, speedup %5%6" )
+                        .arg( frames.at( f ).first )
+                        .arg( frame.size() )
+                        .arg( stream_rate, 0, 'f', 0 )
+                        .arg( json_rate, 0, 'f', 0 )
+                        .arg( stream_rate / json_rate, 0, 'f', 1 )
+                        .arg( check == 0 ? "" : " (MISMATCH)" ) );
+    }
+
+    return results;
+}
+
+
+/*
+ *  Compare JSON and CBOR framing of the preferences
+ */
+QStringList SysTrayXLinkDecoder::benchmarkFraming( int iterations )
+{
+    QStringList results;
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+
+    results.append( QString( "Framing benchmark, %1 iterations" ).arg( iterations ) );
+
+    const int sizes[] = { 4 * 1024, 64 * 1024, 256 * 1024 };
+
+    for( int s = 0 ; s < static_cast< int >( sizeof( sizes ) / sizeof( sizes[ 0 ] ) ) ; ++s )
+    {
+        QByteArray icon( sizes[ s ], 0 );
+        for( int i = 0 ; i < icon.size() ; ++i )
+        {
+            icon[ i ] = static_cast< char >( i * 7 );
+        }
+
+        QVariantMap pref;
+        pref.insert( "iconType", "2" );
+        pref.insert( "iconMime", "image/png" );
+
+        QVariantMap message;
+        QByteArray json_frame;
+        QByteArray cbor_frame;
+        Message decoded;
+        qint64 check = 0;
+
+        /*
+         *  Encode and decode as JSON with a base64 icon
+         */
+        QElapsedTimer timer;
+        timer.start();
+
+        for( int i = 0 ; i < iterations ; ++i )
+        {
+            pref.insert( "icon", QString::fromLatin1( icon.toBase64() ) );
+            message.insert( "preferences", pref );
+            json_frame = QJsonDocument( QJsonObject::fromVariantMap( message ) ).toJson( QJsonDocument::Compact );
+        }
+
+        qint64 json_enc_ns = qMax( timer.nsecsElapsed(), Q_INT64_C( 1 ) );
+
+        timer.restart();
+
+        for( int i = 0 ; i < iterations ; ++i )
+        {
+            decode( json_frame, decoded );
+            check += QByteArray::fromBase64( decoded.pref[ PREF_ICON ] ).size();
+        }
+
+        qint64 json_dec_ns = qMax( timer.nsecsElapsed(), Q_INT64_C( 1 ) );
+
+        /*
+         *  Encode and decode as CBOR with a binary icon
+         */
+        timer.restart();
+
+        for( int i = 0 ; i < iterations ; ++i )
+        {
+            pref.insert( "icon", icon );
+            message.insert( "preferences", pref );
+            cbor_frame = QCborValue( QCborMap::fromVariantMap( message ) ).toCbor();
+        }
+
+        qint64 cbor_enc_ns = qMax( timer.nsecsElapsed(), Q_INT64_C( 1 ) );
+
+        timer.restart();
+
+        for( int i = 0 ; i < iterations ; ++i )
+        {
+            decodeCbor( cbor_frame, decoded );
+            check -= decoded.pref[ PREF_ICON ].size();
+        }
+
+        qint64 cbor_dec_ns = qMax( timer.nsecsElapsed(), Q_INT64_C( 1 ) );
+
+        results.append( QString( "icon %1 KB: json %2 bytes, enc %3 us, dec %4 us; cbor %5 bytes, enc %6 us, dec %7 us%8" )
+                        .arg( sizes[ s ] / 1024 )
+                        .arg( json_frame.size() )
+                        .arg( json_enc_ns / 1000.0 / iterations, 0, 'f', 1 )
+                        .arg( json_dec_ns / 1000.0 / iterations, 0, 'f', 1 )
+                        .arg( cbor_frame.size() )
+                        .arg( cbor_enc_ns / 1000.0 / iterations, 0, 'f', 1 )
+                        .arg( cbor_dec_ns / 1000.0 / iterations, 0, 'f', 1 )
+                        .arg( check == 0 ? "" : " (MISMATCH)" ) );
+    }
+
+#else
+
+    Q_UNUSED( iterations )
+
+    results.append( "Framing benchmark: CBOR needs Qt 5.12" );
+
+#endif
+
+    return results;
+}
+
+
+/*
+ *  Hash of a key found in a frame
+ */
+quint32 SysTrayXLinkDecoder::keyHashOf( const char* key, int len )
+{
+    quint32 hash = 2166136261u;
+
+    for( int i = 0 ; i < len ; ++i )
+    {
+        hash = ( hash ^ static_cast< quint8 >( key[ i ] ) ) * 16777619u;
+    }
+
+    return hash;
+}
+
+
+/*
+ *  Compare a key found in a frame
+ */
+bool    SysTrayXLinkDecoder::isKey( const char* key, int len, const char* name )
+{
+    return static_cast< int >( strlen( name ) ) == len && memcmp( key, name, static_cast< size_t >( len ) ) == 0;
+}
+
+
+/*
+ *  Skip white space
+ */
+void    SysTrayXLinkDecoder::skipSpace( const char*& pos, const char* end )
+{
+    while( pos < end && ( *pos == ' ' || *pos == '\t' || *pos == '\n' || *pos == '\r' ) )
+    {
+        ++pos;
+    }
+}
+
+
+/*
+ *  Parse an object key and the following colon
+ */
+bool    SysTrayXLinkDecoder::parseKey( const char*& pos, const char* end, const char*& key, int& len )
+{
+    if( pos == end || *pos != '"' )
+    {
+        return false;
+    }
+
+    key = pos + 1;
+
+    const char* key_end = static_cast< const char* >( memchr( key, '"', static_cast< size_t >( end - key ) ) );
+    if( key_end == nullptr )
+    {
+        return false;
+    }
+
+    len = static_cast< int >( key_end - key );
+    pos = key_end + 1;
+
+    skipSpace( pos, end );
+    if( pos == end || *pos != ':' )
+    {
+        return false;
+    }
+
+    ++pos;
+    skipSpace( pos, end );
+
+    return pos < end;
+}
+
+
+/*
+ *  Parse the separator after an object value
+ */
+bool    SysTrayXLinkDecoder::parseNext( const char*& pos, const char* end, bool& last )
+{
+    skipSpace( pos, end );
+
+    if( pos == end )
+    {
+        return false;
+    }
+
+    if( *pos == ',' )
+    {
+        ++pos;
+        skipSpace( pos, end );
+
+        last = false;
+        return true;
+    }
+
+    if( *pos == '}' )
+    {
+        ++pos;
+
+        last = true;
+        return true;
+    }
+
+    return false;
+}
+
+
+/*
+ *  Parse a string
+ */
+bool    SysTrayXLinkDecoder::parseString( const char*& pos, const char* end, QByteArray& value )
+{
+    if( pos == end || *pos != '"' )
+    {
+        return false;
+    }
+
+    const char* start = pos + 1;
+    const char* quote = static_cast< const char* >( memchr( start, '"', static_cast< size_t >( end - start ) ) );
+    if( quote == nullptr )
+    {
+        return false;
+    }
+
+    if( memchr( start, '\\', static_cast< size_t >( quote - start ) ) == nullptr )
+    {
+        /*
+         *  No escapes, use the data in place
+         */
+        value = QByteArray::fromRawData( start, static_cast< int >( quote - start ) );
+        pos = quote + 1;
+
+        return true;
+    }
+
+    /*
+     *  Unescape the string
+     */
+    value = QByteArray();
+    value.reserve( static_cast< int >( quote - start ) );
+
+    const char* cur = start;
+    while( cur < end && *cur != '"' )
+    {
+        if( *cur != '\\' )
+        {
+            value.append( *cur++ );
+            continue;
+        }
+
+        if( ++cur == end )
+        {
+            return false;
+        }
+
+        switch( *cur++ )
+        {
+            case '"': value.append( '"' ); break;
+            case '\\': value.append( '\\' ); break;
+            case '/': value.append( '/' ); break;
+            case 'b': value.append( '\b' ); break;
+            case 'f': value.append( '\f' ); break;
+            case 'n': value.append( '\n' ); break;
+            case 'r': value.append( '\r' ); break;
+            case 't': value.append( '\t' ); break;
+
+            case 'u':
+            {
+                uint code = 0;
+                for( int surrogate = 0 ; ; ++surrogate )
+                {
+                    if( end - cur < 4 )
+                    {
+                        return false;
+                    }
+
+                    bool ok;
+                    uint unit = QByteArray::fromRawData( cur, 4 ).toUInt( &ok, 16 );
+                    if( !ok )
+                    {
+                        return false;
+                    }
+                    cur += 4;
+
+                    if( surrogate == 0 && unit >= 0xD800 && unit <= 0xDBFF )
+                    {
+                        /*
+                         *  High surrogate, the low one has to follow
+                         */
+                        if( end - cur < 2 || cur[ 0 ] != '\\' || cur[ 1 ] != 'u' )
+                        {
+                            return false;
+                        }
+                        cur += 2;
+
+                        code = unit;
+                        continue;
+                    }
+
+                    if( surrogate == 1 )
+                    {
+                        if( unit < 0xDC00 || unit > 0xDFFF )
+                        {
+                            return false;
+                        }
+
+                        code = 0x10000 + ( ( code - 0xD800 ) << 10 ) + ( unit - 0xDC00 );
+                    }
+                    else
+                    if( unit >= 0xDC00 && unit <= 0xDFFF )
+                    {
+                        return false;
+                    }
+                    else
+                    {
+                        code = unit;
+                    }
+
+                    break;
+                }
+
+                /*
+                 *  Store as UTF-8
+                 */
+                if( code < 0x80 )
+                {
+                    value.append( static_cast< char >( code ) );
+                }
+                else
+                if( code < 0x800 )
+                {
+                    value.append( static_cast< char >( 0xC0 | ( code >> 6 ) ) );
+                    value.append( static_cast< char >( 0x80 | ( code & 0x3F ) ) );
+                }
+                else
+                if( code < 0x10000 )
+                {
+                    value.append( static_cast< char >( 0xE0 | ( code >> 12 ) ) );
+                    value.append( static_cast< char >( 0x80 | ( ( code >> 6 ) & 0x3F ) ) );
+                    value.append( static_cast< char >( 0x80 | ( code & 0x3F ) ) );
+                }
+                else
+                {
+                    value.append( static_cast< char >( 0xF0 | ( code >> 18 ) ) );
+                    value.append( static_cast< char >( 0x80 | ( ( code >> 12 ) & 0x3F ) ) );
+                    value.append( static_cast< char >( 0x80 | ( ( code >> 6 ) & 0x3F ) ) );
+                    value.append( static_cast< char >( 0x80 | ( code & 0x3F ) ) );
+                }
+                break;
+            }
+
+            default:
+            {
+                return false;
+            }
+        }
+    }
+
+    if( cur == end )
+    {
+        return false;
+    }
+
+    pos = cur + 1;
+
+    return true;
+}
+
+
+/*
+ *  Parse an integer
+ */
+bool    SysTrayXLinkDecoder::parseInt( const char*& pos, const char* end, int& value )
+{
+    const char* cur = pos;
+
+    bool negative = ( cur < end && *cur == '-' );
+    if( negative )
+    {
+        ++cur;
+    }
+
+    const char* digits = cur;
+    int result = 0;
+
+    while( cur < end && *cur >= '0' && *cur <= '9' )
+    {
+        if( cur - digits >= 9 )
+        {
+            /*
+             *  Too large, leave it to QJsonDocument
+             */
+            return false;
+        }
+
+        result = result * 10 + ( *cur++ - '0' );
+    }
+
+    if( cur == digits || ( cur < end && ( *cur == '.' || *cur == 'e' || *cur == 'E' ) ) )
+    {
+        return false;
+    }
+
+    value = negative ? -result : result;
+    pos = cur;
+
+    return true;
+}
+
+
+/*
+ *  Parse the preferences object
+ */
+bool    SysTrayXLinkDecoder::parsePreferences( const char*& pos, const char* end, Message& message )
+{
+    if( pos == end || *pos != '{' )
+    {
+        return false;
+    }
+
+    ++pos;
+    skipSpace( pos, end );
+
+    bool last = ( pos < end && *pos == '}' );
+    if( last )
+    {
+        ++pos;
+    }
+
+    while( !last )
+    {
+        const char* key;
+        int key_len;
+
+        if( !parseKey( pos, end, key, key_len ) )
+        {
+            return false;
+        }
+
+        int pref;
+        switch( keyHashOf( key, key_len ) )
+        {
+            case keyHash( "debug" ): pref = PREF_DEBUG; break;
+            case keyHash( "hideOnMinimize" ): pref = PREF_HIDE_ON_MINIMIZE; break;
+            case keyHash( "startMinimized" ): pref = PREF_START_MINIMIZED; break;
+            case keyHash( "iconType" ): pref = PREF_ICON_TYPE; break;
+            case keyHash( "iconMime" ): pref = PREF_ICON_MIME; break;
+            case keyHash( "icon" ): pref = PREF_ICON; break;
+            case keyHash( "iconDigest" ): pref = PREF_ICON_DIGEST; break;
+
+            default:
+            {
+                return false;
+            }
+        }
+
+        if( !isKey( key, key_len, PREF_NAMES[ pref ] ) || !parseString( pos, end, message.pref[ pref ] ) )
+        {
+            return false;
+        }
+
+        message.pref_keys |= 1u << pref;
+
+        if( !parseNext( pos, end, last ) )
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+/*
+ *  Parse the handshake answer object
+ */
+bool    SysTrayXLinkDecoder::parseHelloAck( const char*& pos, const char* end, Message& message )
+{
+    if( pos == end || *pos != '{' )
+    {
+        return false;
+    }
+
+    ++pos;
+    skipSpace( pos, end );
+
+    bool last = ( pos < end && *pos == '}' );
+    if( last )
+    {
+        ++pos;
+    }
+
+    while( !last )
+    {
+        const char* key;
+        int key_len;
+
+        if( !parseKey( pos, end, key, key_len ) )
+        {
+            return false;
+        }
+
+        int* value;
+        if( isKey( key, key_len, "version" ) )
+        {
+            value = &message.version;
+        }
+        else if( isKey( key, key_len, "capabilities" ) )
+        {
+            value = &message.capabilities;
+        }
+        else
+        {
+            return false;
+        }
+
+        if( !parseInt( pos, end, *value ) || !parseNext( pos, end, last ) )
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+
+/*
+ *  Read a CBOR text or byte string
+ */
+bool    SysTrayXLinkDecoder::readCborString( QCborStreamReader& reader, QByteArray& value )
+{
+    value.clear();
+
+    if( reader.isString() )
+    {
+        QCborStreamReader::StringResult< QString > chunk = reader.readString();
+        while( chunk.status == QCborStreamReader::Ok )
+        {
+            value.append( chunk.data.toUtf8() );
+            chunk = reader.readString();
+        }
+
+        return chunk.status == QCborStreamReader::EndOfString;
+    }
+
+    if( reader.isByteArray() )
+    {
+        QCborStreamReader::StringResult< QByteArray > chunk = reader.readByteArray();
+        while( chunk.status == QCborStreamReader::Ok )
+        {
+            value.append( chunk.data );
+            chunk = reader.readByteArray();
+        }
+
+        return chunk.status == QCborStreamReader::EndOfString;
+    }
+
+    return false;
+}
+
+
+/*
+ *  Read the CBOR preferences map
+ */
+bool    SysTrayXLinkDecoder::readCborPreferences( QCborStreamReader& reader, Message& message )
+{
+    if( !reader.isMap() || !reader.enterContainer() )
+    {
+        return false;
+    }
+
+    while( reader.lastError() == QCborError::NoError && reader.hasNext() )
+    {
+        QByteArray key;
+        if( !reader.isString() || !readCborString( reader, key ) )
+        {
+            return false;
+        }
+
+        int pref = -1;
+        for( int i = 0 ; i < PREF_KEY_COUNT ; ++i )
+        {
+            if( isKey( key.constData(), key.size(), PREF_NAMES[ i ] ) )
+            {
+                pref = i;
+                break;
+            }
+        }
+
+        if( pref < 0 )
+        {
+            /*
+             *  Unknown preference, skip the value
+             */
+            if( !reader.next() )
+            {
+                return false;
+            }
+            continue;
+        }
+
+        if( pref == PREF_ICON )
+        {
+            message.raw_icon = reader.isByteArray();
+        }
+
+        if( !readCborString( reader, message.pref[ pref ] ) )
+        {
+            return false;
+        }
+
+        message.pref_keys |= 1u << pref;
+    }
+
+    return reader.lastError() == QCborError::NoError && reader.leaveContainer();
+}
+
+
+/*
+ *  Read the CBOR handshake answer map
+ */
+bool    SysTrayXLinkDecoder::readCborHelloAck( QCborStreamReader& reader, Message& message )
+{
+    if( !reader.isMap() || !reader.enterContainer() )
+    {
+        return false;
+    }
+
+    while( reader.lastError() == QCborError::NoError && reader.hasNext() )
+    {
+        QByteArray key;
+        if( !reader.isString() || !readCborString( reader, key ) )
+        {
+            return false;
+        }
+
+        if( reader.isInteger() && isKey( key.constData(), key.size(), "version" ) )
+        {
+            message.version = static_cast< int >( reader.toInteger() );
+        }
+        else if( reader.isInteger() && isKey( key.constData(), key.size(), "capabilities" ) )
+        {
+            message.capabilities = static_cast< int >( reader.toInteger() );
+        }
+
+        if( !reader.next() )
+        {
+            return false;
+        }
+    }
+
+    return reader.lastError() == QCborError::NoError && reader.leaveContainer();
+}
+
+#endif
@@ -0,0 +1,407 @@
+#ifndef SYSTRAYXLINKDECODER_H
+#define SYSTRAYXLINKDECODER_H
+
+/*
+ *	Local includes
+ */
+
+/*
+ *	Qt includes
+ */
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <QList>
+
+/*
+ *	Predefines
+ */
+class QCborStreamReader;
+
+
+/**
+ * @brief The SysTrayXLinkDecoder class. Decoder for the messages of the add-on.
+ *
+ *  The known message shapes are tokenized in place, anything else is handled by QJsonDocument.
+ */
+class SysTrayXLinkDecoder
+{
+    public:
+
+        /*
+         *  Message keys (bits)
+         */
+        enum MessageKey
+        {
+            KEY_UNREAD_MAIL = 0x01,
+            KEY_TITLE = 0x02,
+            KEY_SHUTDOWN = 0x04,
+            KEY_WINDOW = 0x08,
+            KEY_PREFERENCES = 0x10,
+            KEY_ICON_REQUEST = 0x20,
+            KEY_HELLO_ACK = 0x40,
+            KEY_PONG = 0x80,
+            KEY_UNREAD_FOLDERS = 0x100,
+            KEY_UNREAD_DELTA = 0x200
+        };
+
+        /*
+         *  Preference keys
+         */
+        enum PrefKey
+        {
+            PREF_DEBUG = 0,
+            PREF_HIDE_ON_MINIMIZE,
+            PREF_START_MINIMIZED,
+            PREF_ICON_TYPE,
+            PREF_ICON_MIME,
+            PREF_ICON,
+            PREF_ICON_DIGEST,
+            PREF_KEY_COUNT
+        };
+
+        /**
+         * @brief The UnreadFolder class. Unread mails of a folder.
+         */
+        class UnreadFolder
+        {
+            public:
+
+                UnreadFolder()
+                {
+                    unread = 0;
+                }
+
+                /**
+                 * @brief account. Id of the account.
+                 */
+                QByteArray  account;
+
+                /**
+                 * @brief name. Name of the account (UTF-8), may be empty.
+                 */
+                QByteArray  name;
+
+                /**
+                 * @brief folder. Path of the folder (UTF-8), empty for the whole account.
+                 */
+                QByteArray  folder;
+
+                /**
+                 * @brief unread. Number of unread mails.
+                 */
+                int unread;
+        };
+
+        /**
+         * @brief The Message class. A decoded message.
+         *
+         *  The string values may point into the frame, do not use them after the frame is gone.
+         */
+        class Message
+        {
+            public:
+
+                Message()
+                {
+                    keys = 0;
+                    unread_mail = 0;
+                    pref_keys = 0;
+                    version = 0;
+                    capabilities = 0;
+                    pong = 0;
+                    raw_icon = false;
+                }
+
+                /**
+                 * @brief keys. The found message keys.
+                 */
+                quint32 keys;
+
+                /**
+                 * @brief unread_mail. Number of unread mails.
+                 */
+                int unread_mail;
+
+                /**
+                 * @brief title. Window title (UTF-8).
+                 */
+                QByteArray title;
+
+                /**
+                 * @brief window. Window state.
+                 */
+                QByteArray window;
+
+                /**
+                 * @brief icon_request. Digest of the requested icon.
+                 */
+                QByteArray icon_request;
+
+                /**
+                 * @brief version. Protocol version of the add-on.
+                 */
+                int version;
+
+                /**
+                 * @brief capabilities. Capabilities of the add-on (bits).
+                 */
+                int capabilities;
+
+                /**
+                 * @brief pong. Sequence number of the answered heartbeat.
+                 */
+                int pong;
+
+                /**
+                 * @brief pref_keys. The found preference keys (bits, 1 << PrefKey).
+                 */
+                quint32 pref_keys;
+
+                /**
+                 * @brief pref. The preference values (UTF-8).
+                 */
+                QByteArray pref[ PREF_KEY_COUNT ];
+
+                /**
+                 * @brief raw_icon. The icon preference is binary data instead of base64.
+                 */
+                bool raw_icon;
+
+                /**
+                 * @brief unread_folders. Unread mails per folder, all folders or only the changed ones.
+                 */
+                QList< UnreadFolder >   unread_folders;
+        };
+
+    public:
+
+        /**
+         * @brief PREF_NAMES. The preference key names.
+         */
+        static const char* const    PREF_NAMES[ PREF_KEY_COUNT ];
+
+        /**
+         * @brief BULK_FRAME_SIZE. Frames of this size and up are handled by the bulk lane.
+         */
+        static const int BULK_FRAME_SIZE = 1024;
+
+    public:
+
+        /**
+         * @brief keyHash. Hash of a key, usable at compile time (FNV-1a).
+         *
+         *  @param key      The key.
+         *  @param hash     The hash so far.
+         *
+         *  @return     The hash.
+         */
+        static constexpr quint32    keyHash( const char* key, quint32 hash = 2166136261u )
+        {
+            return *key ? keyHash( key + 1, ( hash ^ static_cast< quint8 >( *key ) ) * 16777619u ) : hash;
+        }
+
+        /**
+         * @brief decode. Decode a message by tokenizing it in place.
+         *
+         *  @param frame    The frame.
+         *  @param message  Storage for the decoded message.
+         *
+         *  @return     False if the frame does not have a known shape.
+         */
+        static bool decode( const QByteArray& frame, Message& message );
+
+        /**
+         * @brief decodeJson. Decode a message using QJsonDocument.
+         *
+         *  @param frame    The frame.
+         *  @param message  Storage for the decoded message.
+         *
+         *  @return     False if the frame is not a JSON object.
+         */
+        static bool decodeJson( const QByteArray& frame, Message& message );
+
+        /**
+         * @brief isCbor. Check for the start of a CBOR frame (a map).
+         *
+         *  @param first    The first byte of the frame.
+         *
+         *  @return     True for a CBOR map.
+         */
+        static bool isCbor( char first )
+        {
+            return ( static_cast< quint8 >( first ) & 0xE0 ) == 0xA0;
+        }
+
+        /**
+         * @brief decodeCbor. Decode a CBOR message, the icon is a byte string.
+         *
+         *  @param frame    The frame.
+         *  @param message  Storage for the decoded message.
+         *
+         *  @return     False if the frame is not a CBOR map or CBOR is not supported.
+         */
+        static bool decodeCbor( const QByteArray& frame, Message& message );
+
+        /**
+         * @brief isBulk. Classify a frame without decoding it.
+         *
+         *  Preferences, unread folder lists and large frames are bulk. Everything else
+         *  is a small control message that is handled ahead of them. The unread snapshots
+         *  and deltas share the bulk lane to stay in order.
+         *
+         *  @param data     The frame data.
+         *  @param len      The frame length.
+         *
+         *  @return     True for a bulk frame.
+         */
+        static bool isBulk( const char* data, int len );
+
+        /**
+         * @brief benchmarkFraming. Compare JSON and CBOR framing of the preferences.
+         *
+         *  @param iterations   Number of encodes and decodes per icon size and framing.
+         *
+         *  @return     The results.
+         */
+        static QStringList  benchmarkFraming( int iterations );
+
+        /**
+         * @brief benchmark. Compare the decoders.
+         *
+         *  @param iterations   Number of decodes per frame and decoder.
+         *
+         *  @return     The results.
+         */
+        static QStringList  benchmark( int iterations );
+
+    private:
+
+        /**
+         * @brief keyHashOf. Hash of a key found in a frame.
+         *
+         *  @param key      The key.
+         *  @param len      The key length.
+         *
+         *  @return     The hash.
+         */
+        static quint32  keyHashOf( const char* key, int len );
+
+        /**
+         * @brief isKey. Compare a key found in a frame.
+         *
+         *  @param key      The key.
+         *  @param len      The key length.
+         *  @param name     The name to compare with.
+         *
+         *  @return     Equal.
+         */
+        static bool isKey( const char* key, int len, const char* name );
+
+        /**
+         * @brief parseKey. Parse an object key and the following colon.
+         *
+         *  @param pos      The current position (on the opening quote).
+         *  @param end      The end of the data.
+         *  @param key      Storage for the start of the key.
+         *  @param len      Storage for the key length.
+         *
+         *  @return     Success.
+         */
+        static bool parseKey( const char*& pos, const char* end, const char*& key, int& len );
+
+        /**
+         * @brief parseNext. Parse the separator after an object value.
+         *
+         *  @param pos      The current position.
+         *  @param end      The end of the data.
+         *  @param last     Storage for the end of object state.
+         *
+         *  @return     Success.
+         */
+        static bool parseNext( const char*& pos, const char* end, bool& last );
+
+        /**
+         * @brief skipSpace. Skip white space.
+         *
+         *  @param pos      The current position.
+         *  @param end      The end of the data.
+         */
+        static void skipSpace( const char*& pos, const char* end );
+
+        /**
+         * @brief parseString. Parse a string.
+         *
+         *  @param pos      The current position (on the opening quote).
+         *  @param end      The end of the data.
+         *  @param value    Storage for the value (UTF-8).
+         *
+         *  @return     Success.
+         */
+        static bool parseString( const char*& pos, const char* end, QByteArray& value );
+
+        /**
+         * @brief parseInt. Parse an integer.
+         *
+         *  @param pos      The current position.
+         *  @param end      The end of the data.
+         *  @param value    Storage for the value.
+         *
+         *  @return     Success.
+         */
+        static bool parseInt( const char*& pos, const char* end, int& value );
+
+        /**
+         * @brief parsePreferences. Parse the preferences object.
+         *
+         *  @param pos      The current position (on the opening brace).
+         *  @param end      The end of the data.
+         *  @param message  Storage for the decoded preferences.
+         *
+         *  @return     Success.
+         */
+        static bool parsePreferences( const char*& pos, const char* end, Message& message );
+
+        /**
+         * @brief parseHelloAck. Parse the handshake answer object.
+         *
+         *  @param pos      The current position (on the opening brace).
+         *  @param end      The end of the data.
+         *  @param message  Storage for the decoded handshake.
+         *
+         *  @return     Success.
+         */
+        static bool parseHelloAck( const char*& pos, const char* end, Message& message );
+
+        /**
+         * @brief readCborString. Read a CBOR text or byte string.
+         *
+         *  @param reader   The CBOR reader.
+         *  @param value    Storage for the value (UTF-8 or binary).
+         *
+         *  @return     Success.
+         */
+        static bool readCborString( QCborStreamReader& reader, QByteArray& value );
+
+        /**
+         * @brief readCborPreferences. Read the CBOR preferences map.
+         *
+         *  @param reader   The CBOR reader.
+         *  @param message  Storage for the decoded preferences.
+         *
+         *  @return     Success.
+         */
+        static bool readCborPreferences( QCborStreamReader& reader, Message& message );
+
+        /**
+         * @brief readCborHelloAck. Read the CBOR handshake answer map.
+         *
+         *  @param reader   The CBOR reader.
+         *  @param message  Storage for the decoded handshake.
+         *
+         *  @return     Success.
+         */
+        static bool readCborHelloAck( QCborStreamReader& reader, Message& message );
+};
+
+#endif // SYSTRAYXLINKDECODER_H
@@ -0,0 +1,218 @@
+#ifndef SYSTRAYXLINKQUEUE_H
+#define SYSTRAYXLINKQUEUE_H
+
+/*
+ *	Local includes
+ */
+
+/*
+ *  System includes
+ */
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+/*
+ *	Qt includes
+ */
+
+
+/**
+ * @brief The SysTrayXLinkQueue class. Bounded lock-free single producer / single consumer queue.
+ *
+ *  One thread may push, one other thread may pop. The wakeup and stall flags are used to
+ *  post a single wakeup per batch and to pause the producer while the queue is full.
+ */
+template< typename T >
+class SysTrayXLinkQueue
+{
+    public:
+
+        /**
+         * @brief CACHE_LINE. Size of a cache line, the counters are kept this far apart.
+         */
+        static const size_t CACHE_LINE = 64;
+
+    public:
+
+        /**
+         * @brief SysTrayXLinkQueue. Constructor.
+         *
+         *  @param capacity     Number of items, rounded up to a power of 2.
+         */
+        explicit SysTrayXLinkQueue( size_t capacity )
+        {
+            size_t size = 1;
+            while( size < capacity )
+            {
+                size *= 2;
+            }
+
+            m_items.resize( size );
+            m_mask = size - 1;
+            m_head.store( 0 );
+            m_tail.store( 0 );
+            m_wakeup.store( false );
+            m_stalled.store( false );
+        }
+
+        /**
+         * @brief push. Add an item (producer only).
+         *
+         *  @param item     The item.
+         *
+         *  @return     False if the queue is full.
+         */
+        bool    push( const T& item )
+        {
+            size_t tail = m_tail.load( std::memory_order_relaxed );
+
+            if( tail - m_head.load( std::memory_order_acquire ) > m_mask )
+            {
+                return false;
+            }
+
+            m_items[ tail & m_mask ] = item;
+            m_tail.store( tail + 1, std::memory_order_release );
+
+            return true;
+        }
+
+        /**
+         * @brief pop. Remove the oldest item (consumer only).
+         *
+         *  @param item     Storage for the item.
+         *
+         *  @return     False if the queue is empty.
+         */
+        bool    pop( T& item )
+        {
+            size_t head = m_head.load( std::memory_order_relaxed );
+
+            if( head == m_tail.load( std::memory_order_acquire ) )
+            {
+                return false;
+            }
+
+            item = m_items[ head & m_mask ];
+            m_items[ head & m_mask ] = T();
+            m_head.store( head + 1, std::memory_order_release );
+
+            return true;
+        }
+
+        /**
+         * @brief isFull. Check for a full queue (producer only).
+         *
+         *  @return     The state.
+         */
+        bool    isFull() const
+        {
+            return m_tail.load( std::memory_order_relaxed ) - m_head.load( std::memory_order_acquire ) > m_mask;
+        }
+
+        /**
+         * @brief size. Get the number of queued items (estimate when called concurrently).
+         *
+         *  @return     The number of items.
+         */
+        size_t  size() const
+        {
+            return m_tail.load( std::memory_order_acquire ) - m_head.load( std::memory_order_acquire );
+        }
+
+        /**
+         * @brief requestWakeup. Request a wakeup of the consumer (producer only).
+         *
+         *  @return     True if the caller has to wake the consumer.
+         */
+        bool    requestWakeup()
+        {
+            return !m_wakeup.exchange( true, std::memory_order_acq_rel );
+        }
+
+        /**
+         * @brief clearWakeup. Acknowledge a wakeup, call before draining (consumer only).
+         */
+        void    clearWakeup()
+        {
+            m_wakeup.store( false, std::memory_order_release );
+        }
+
+        /**
+         * @brief setStalled. Mark the producer as waiting for space (producer only).
+         */
+        void    setStalled()
+        {
+            m_stalled.store( true, std::memory_order_release );
+        }
+
+        /**
+         * @brief takeStalled. Get and clear the producer waiting state (consumer only).
+         *
+         *  @return     True if the caller has to resume the producer.
+         */
+        bool    takeStalled()
+        {
+            return m_stalled.exchange( false, std::memory_order_acq_rel );
+        }
+
+    private:
+
+        /**
+         * @brief m_items. The item storage.
+         */
+        std::vector< T >    m_items;
+
+        /**
+         * @brief m_mask. Index mask (capacity - 1).
+         */
+        size_t  m_mask;
+
+        /*
+         *  Padding instead of alignas, an over-aligned queue member would need the C++17 aligned new
+         *  in every class holding one by value
+         */
+
+        /**
+         * @brief m_pad_head. Keeps the read counter off the line of the fields before it.
+         */
+        char    m_pad_head[ CACHE_LINE ];
+
+        /**
+         * @brief m_head. Read counter, owned by the consumer.
+         */
+        std::atomic< size_t > m_head;
+
+        /**
+         * @brief m_pad_tail. Keeps the write counter off the line of the read counter.
+         */
+        char    m_pad_tail[ CACHE_LINE ];
+
+        /**
+         * @brief m_tail. Write counter, owned by the producer.
+         */
+        std::atomic< size_t > m_tail;
+
+        /**
+         * @brief m_pad_flags. Keeps the flags off the line of the write counter.
+         */
+        char    m_pad_flags[ CACHE_LINE ];
+
+        /**
+         * @brief m_wakeup. A wakeup of the consumer is pending.
+         */
+        std::atomic< bool >   m_wakeup;
+
+        /**
+         * @brief m_stalled. The producer waits for space.
+         */
+        std::atomic< bool > m_stalled;
+
+        /**
+         * @brief m_pad_end. Keeps the flags off the line of the fields after the queue.
+         */
+        char    m_pad_end[ CACHE_LINE ];
+};
+
+#endif // SYSTRAYXLINKQUEUE_H
@@ -0,0 +1,1121 @@
+#include "systrayxlinktransport.h"
+
+
+/*
+ *	Local includes
+ */
+#include "systrayxlink.h"
+
+
+/*
+ *  System includes
+ */
+#include <iostream>
+#ifdef Q_OS_WIN
+#include <fcntl.h>
+#include <io.h>
+#include <windows.h>
+#endif
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/uio.h>
+#endif
+
+
+/*
+ *	Qt includes
+ */
+#include <QMutex>
+#include <QMutexLocker>
+#include <QList>
+#include <QThread>
+#include <QElapsedTimer>
+#include <QSocketNotifier>
+#include <QLocalSocket>
+#include <QLocalServer>
+#include <QCoreApplication>
+#include <QMetaObject>
+
+
+/*
+ *  Constants
+ */
+const int   SysTrayXLinkStreamTransport::WRITE_BATCH;
+
+static const int    BENCHMARK_BYTES = 4 * 1024 * 1024;
+static const int    BENCHMARK_ROUND_TRIPS = 1000;
+
+
+/*****************************************************************************
+ *
+ *  SysTrayXLinkTransport Class
+ *
+ *****************************************************************************/
+
+
+/*
+ *	Destructor
+ */
+SysTrayXLinkTransport::~SysTrayXLinkTransport()
+{
+}
+
+
+/*
+ *	Only read when told there is data
+ */
+bool    SysTrayXLinkTransport::isBlocking() const
+{
+    return false;
+}
+
+
+/*
+ *	Native messaging only carries JSON
+ */
+bool    SysTrayXLinkTransport::isBinaryFraming() const
+{
+    return false;
+}
+
+
+/*
+ *	Nothing to prepare
+ */
+void    SysTrayXLinkTransport::startReading()
+{
+}
+
+
+/*
+ *	Nothing to enable
+ */
+void    SysTrayXLinkTransport::setReadEnabled( bool state )
+{
+    Q_UNUSED( state )
+}
+
+
+/*
+ *	Nothing blocks
+ */
+void    SysTrayXLinkTransport::cancel()
+{
+}
+
+
+/*
+ *	Byte transports do not pass frames
+ */
+bool    SysTrayXLinkTransport::takeFrame( QByteArray& frame )
+{
+    Q_UNUSED( frame )
+
+    return false;
+}
+
+
+/*****************************************************************************
+ *
+ *  SysTrayXLinkStreamTransport Class
+ *
+ *****************************************************************************/
+
+
+/*
+ *	Constructor
+ */
+SysTrayXLinkStreamTransport::SysTrayXLinkStreamTransport( int read_fd, int write_fd, bool close_fds )
+{
+    /*
+     *  Initialize
+     */
+    m_read_fd = read_fd;
+    m_write_fd = write_fd;
+    m_close_fds = close_fds;
+    m_notifier = nullptr;
+    m_cancelled.store( false );
+
+#ifdef Q_OS_UNIX
+
+    /*
+     *  Report a closed peer as a write error instead of being killed
+     */
+    signal( SIGPIPE, SIG_IGN );
+
+    /*
+     *  Never block in a write, wait for room in poll where a cancel can wake us
+     */
+    int flags = fcntl( m_write_fd, F_GETFL );
+    fcntl( m_write_fd, F_SETFL, flags | O_NONBLOCK );
+
+    if( ::pipe( m_cancel_fds ) < 0 )
+    {
+        m_cancel_fds[ 0 ] = -1;
+        m_cancel_fds[ 1 ] = -1;
+    }
+#else
+    m_read_thread = nullptr;
+    m_write_thread = nullptr;
+#endif
+}
+
+
+/*
+ *	Destructor
+ */
+SysTrayXLinkStreamTransport::~SysTrayXLinkStreamTransport()
+{
+    /*
+     *  Cleanup
+     */
+    if( m_notifier )
+    {
+        m_notifier->setEnabled( false );
+        delete m_notifier;
+    }
+
+#ifdef Q_OS_UNIX
+    if( m_close_fds )
+    {
+        ::close( m_read_fd );
+
+        if( m_write_fd != m_read_fd )
+        {
+            ::close( m_write_fd );
+        }
+    }
+
+    if( m_cancel_fds[ 0 ] >= 0 )
+    {
+        ::close( m_cancel_fds[ 0 ] );
+        ::close( m_cancel_fds[ 1 ] );
+    }
+#else
+    if( m_read_thread )
+    {
+        CloseHandle( m_read_thread );
+    }
+
+    if( m_write_thread )
+    {
+        CloseHandle( m_write_thread );
+    }
+#endif
+}
+
+
+/*
+ *	Get the name
+ */
+QString SysTrayXLinkStreamTransport::getName() const
+{
+    return QString( "stream" );
+}
+
+
+/*
+ *	Windows pipes cannot be watched by a notifier
+ */
+bool    SysTrayXLinkStreamTransport::isBlocking() const
+{
+#ifdef Q_OS_UNIX
+    return false;
+#else
+    return true;
+#endif
+}
+
+
+/*
+ *	Never block on the input, only read when the notifier tells us there is data
+ */
+void    SysTrayXLinkStreamTransport::startReading()
+{
+#ifdef Q_OS_UNIX
+    int flags = fcntl( m_read_fd, F_GETFL );
+    fcntl( m_read_fd, F_SETFL, flags | O_NONBLOCK );
+
+    /*
+     *  Wait for data in the event loop of this thread.
+     *  (String based connect, the activated signal is overloaded in Qt 5.15)
+     */
+    m_notifier = new QSocketNotifier( m_read_fd, QSocketNotifier::Read, this );
+    connect( m_notifier, SIGNAL( activated( int ) ), this, SIGNAL( signalReadyRead() ) );
+    m_notifier->setEnabled( true );
+#endif
+}
+
+
+/*
+ *	Enable or disable the notifier
+ */
+void    SysTrayXLinkStreamTransport::setReadEnabled( bool state )
+{
+    if( m_notifier )
+    {
+        m_notifier->setEnabled( state );
+    }
+}
+
+
+/*
+ *	Read the available data
+ */
+SysTrayXLinkTransport::ReadResult   SysTrayXLinkStreamTransport::read( SysTrayXLinkRingBuffer& ring )
+{
+    if( m_cancelled.load() )
+    {
+        return READ_END;
+    }
+
+#ifdef Q_OS_UNIX
+    qint64 len = ring.readFrom( m_read_fd );
+
+    if( len > 0 || ( len < 0 && errno == EINTR ) )
+    {
+        return READ_DATA;
+    }
+    else
+    if( len < 0 && ( errno == EAGAIN || errno == EWOULDBLOCK ) )
+    {
+        return READ_WAIT;
+    }
+
+    return READ_END;
+#else
+
+    /*
+     *  Blocking, one frame at a time
+     */
+    registerThread( &m_read_thread );
+
+    qint32 data_len = 0;
+    if( !std::cin.read( reinterpret_cast< char* >( &data_len ), sizeof( qint32 ) ) )
+    {
+        return READ_END;
+    }
+
+    if( data_len <= 0 || data_len > ring.getMaxFrameSize() )
+    {
+        /*
+         *  Corrupt length, never allocate for it. Let the ring drop the bytes and resync.
+         */
+        ring.append( reinterpret_cast< char* >( &data_len ), sizeof( qint32 ) );
+
+        return READ_DATA;
+    }
+
+    QByteArray data( data_len, 0 );
+    if( !std::cin.read( data.data(), data_len ) )
+    {
+        return READ_END;
+    }
+
+    ring.append( reinterpret_cast< char* >( &data_len ), sizeof( qint32 ) );
+    ring.append( data.constData(), data_len );
+
+    return READ_DATA;
+#endif
+}
+
+
+/*
+ *	Write a batch of frames
+ */
+bool    SysTrayXLinkStreamTransport::write( const QByteArray* frames, int count )
+{
+    qint32 headers[ WRITE_BATCH ];
+
+    if( m_cancelled.load() )
+    {
+        return false;
+    }
+
+#ifdef Q_OS_UNIX
+    struct iovec iov[ 2 * WRITE_BATCH ];
+
+    for( int start = 0 ; start < count ; start += WRITE_BATCH )
+    {
+        int batch = qMin( count - start, WRITE_BATCH );
+
+        /*
+         *  All headers and frames in a single call
+         */
+        for( int i = 0 ; i < batch ; ++i )
+        {
+            headers[ i ] = frames[ start + i ].length();
+
+            iov[ 2 * i ].iov_base = &headers[ i ];
+            iov[ 2 * i ].iov_len = sizeof( qint32 );
+            iov[ 2 * i + 1 ].iov_base = const_cast< char* >( frames[ start + i ].constData() );
+            iov[ 2 * i + 1 ].iov_len = static_cast< size_t >( headers[ i ] );
+        }
+
+        struct iovec* current = iov;
+        int iov_count = 2 * batch;
+
+        while( iov_count > 0 )
+        {
+            ssize_t len = ::writev( m_write_fd, current, iov_count );
+
+            if( len < 0 )
+            {
+                if( errno == EINTR )
+                {
+                    continue;
+                }
+
+                if( errno == EAGAIN || errno == EWOULDBLOCK )
+                {
+                    /*
+                     *  Wait for room, or for a cancel of a hung peer
+                     */
+                    struct pollfd pfd[ 2 ];
+                    pfd[ 0 ].fd = m_write_fd;
+                    pfd[ 0 ].events = POLLOUT;
+                    pfd[ 0 ].revents = 0;
+                    pfd[ 1 ].fd = m_cancel_fds[ 0 ];
+                    pfd[ 1 ].events = POLLIN;
+                    pfd[ 1 ].revents = 0;
+
+                    ::poll( pfd, 2, -1 );
+
+                    if( m_cancelled.load() )
+                    {
+                        return false;
+                    }
+                    continue;
+                }
+
+                return false;
+            }
+
+            /*
+             *  Skip the written parts
+             */
+            size_t written = static_cast< size_t >( len );
+            while( iov_count > 0 && written >= current->iov_len )
+            {
+                written -= current->iov_len;
+                ++current;
+                --iov_count;
+            }
+
+            if( iov_count > 0 )
+            {
+                current->iov_base = static_cast< char* >( current->iov_base ) + written;
+                current->iov_len -= written;
+            }
+        }
+    }
+
+    return true;
+#else
+    registerThread( &m_write_thread );
+
+    for( int i = 0 ; i < count ; ++i )
+    {
+        headers[ 0 ] = frames[ i ].length();
+
+        std::cout.write( reinterpret_cast< char* >( &headers[ 0 ] ), sizeof( qint32 ) );
+        std::cout.write( frames[ i ].constData(), headers[ 0 ] );
+    }
+
+    std::cout << std::flush;
+
+    return !std::cout.fail();
+#endif
+}
+
+
+/*
+ *	Wake the reader and writer blocked on a hung peer
+ */
+void    SysTrayXLinkStreamTransport::cancel()
+{
+    m_cancelled.store( true );
+
+#ifdef Q_OS_UNIX
+
+    /*
+     *  The reader never blocks, it waits in its event loop
+     */
+    if( m_cancel_fds[ 1 ] >= 0 )
+    {
+        char wake = 0;
+        while( ::write( m_cancel_fds[ 1 ], &wake, 1 ) < 0 && errno == EINTR )
+        {
+        }
+    }
+#else
+    QMutexLocker locker( &m_thread_mutex );
+
+    if( m_read_thread )
+    {
+        CancelSynchronousIo( m_read_thread );
+    }
+
+    if( m_write_thread )
+    {
+        CancelSynchronousIo( m_write_thread );
+    }
+#endif
+}
+
+
+#ifdef Q_OS_WIN
+
+/*
+ *	Remember the calling thread
+ */
+void    SysTrayXLinkStreamTransport::registerThread( void** thread )
+{
+    QMutexLocker locker( &m_thread_mutex );
+
+    if( *thread == nullptr )
+    {
+        HANDLE handle = nullptr;
+        DuplicateHandle( GetCurrentProcess(), GetCurrentThread(), GetCurrentProcess(), &handle, 0, FALSE, DUPLICATE_SAME_ACCESS );
+
+        *thread = handle;
+    }
+}
+
+#endif
+
+
+/*****************************************************************************
+ *
+ *  SysTrayXLinkStdioTransport Class
+ *
+ *****************************************************************************/
+
+
+/*
+ *	Constructor
+ */
+SysTrayXLinkStdioTransport::SysTrayXLinkStdioTransport() : SysTrayXLinkStreamTransport( 0, 1 )
+{
+#ifdef Q_OS_WIN
+
+    /*
+     *  Set stdin and stdout to binary
+     */
+    _setmode( _fileno( stdin ), _O_BINARY );
+    _setmode( _fileno( stdout ), _O_BINARY );
+#endif
+}
+
+
+/*
+ *	Get the name
+ */
+QString SysTrayXLinkStdioTransport::getName() const
+{
+    return QString( "stdio" );
+}
+
+
+#ifdef Q_OS_UNIX
+
+/*****************************************************************************
+ *
+ *  SysTrayXLinkSocketTransport Class
+ *
+ *****************************************************************************/
+
+
+/*
+ *	Constructor
+ */
+SysTrayXLinkSocketTransport::SysTrayXLinkSocketTransport( int fd, bool binary_framing ) : SysTrayXLinkStreamTransport( fd, fd, true )
+{
+    /*
+     *  Initialize
+     */
+    m_binary_framing = binary_framing;
+}
+
+
+/*
+ *	Get the name
+ */
+QString SysTrayXLinkSocketTransport::getName() const
+{
+    return QString( m_binary_framing ? "local socket (cbor)" : "local socket" );
+}
+
+
+/*
+ *	CBOR as negotiated with the stub
+ */
+bool    SysTrayXLinkSocketTransport::isBinaryFraming() const
+{
+    return m_binary_framing;
+}
+
+
+/*
+ *	Take over a connected socket
+ */
+SysTrayXLinkSocketTransport*    SysTrayXLinkSocketTransport::fromSocket( QLocalSocket* socket )
+{
+    if( socket->state() != QLocalSocket::ConnectedState || socket->bytesAvailable() > 0 )
+    {
+        return nullptr;
+    }
+
+    /*
+     *  Keep our own descriptor, QLocalSocket would read it in its own thread otherwise
+     */
+    int fd = ::dup( static_cast< int >( socket->socketDescriptor() ) );
+    socket->abort();
+
+    if( fd < 0 )
+    {
+        return nullptr;
+    }
+
+    return new SysTrayXLinkSocketTransport( fd );
+}
+
+
+/*
+ *	Connect to a local server
+ */
+SysTrayXLinkSocketTransport*    SysTrayXLinkSocketTransport::connectToServer( const QString& name, int timeout )
+{
+    QLocalSocket socket;
+    socket.connectToServer( name );
+
+    if( !socket.waitForConnected( timeout ) )
+    {
+        return nullptr;
+    }
+
+    return fromSocket( &socket );
+}
+
+#endif
+
+
+/*****************************************************************************
+ *
+ *  SysTrayXLinkMemoryTransport Class
+ *
+ *****************************************************************************/
+
+
+/**
+ * @brief The SysTrayXLinkMemoryTransport::Channel class. Frames in one direction.
+ */
+class SysTrayXLinkMemoryTransport::Channel
+{
+    public:
+
+        Channel()
+        {
+            closed = false;
+            notify = false;
+            reader = nullptr;
+        }
+
+        /**
+         * @brief mutex. Protects the channel.
+         */
+        QMutex  mutex;
+
+        /**
+         * @brief frames. The frames not yet taken by the reader.
+         */
+        QList< QByteArray > frames;
+
+        /**
+         * @brief closed. The writing end is gone.
+         */
+        bool    closed;
+
+        /**
+         * @brief notify. The reader waits for signalReadyRead.
+         */
+        bool    notify;
+
+        /**
+         * @brief reader. The reading end, nullptr when gone.
+         */
+        SysTrayXLinkMemoryTransport*    reader;
+};
+
+
+/*
+ *	Constructor
+ */
+SysTrayXLinkMemoryTransport::SysTrayXLinkMemoryTransport( QSharedPointer< Channel > input, QSharedPointer< Channel > output )
+{
+    /*
+     *  Initialize
+     */
+    m_input = input;
+    m_output = output;
+
+    QMutexLocker lock( &m_input->mutex );
+    m_input->reader = this;
+}
+
+
+/*
+ *	Destructor
+ */
+SysTrayXLinkMemoryTransport::~SysTrayXLinkMemoryTransport()
+{
+    /*
+     *  Cleanup
+     */
+    {
+        QMutexLocker lock( &m_input->mutex );
+        m_input->reader = nullptr;
+    }
+
+    /*
+     *  Tell the peer
+     */
+    QMutexLocker lock( &m_output->mutex );
+    m_output->closed = true;
+
+    if( m_output->reader )
+    {
+        QMetaObject::invokeMethod( m_output->reader, "signalReadyRead", Qt::QueuedConnection );
+    }
+}
+
+
+/*
+ *	Create two connected transports
+ */
+void    SysTrayXLinkMemoryTransport::createPair( SysTrayXLinkMemoryTransport** first, SysTrayXLinkMemoryTransport** second )
+{
+    QSharedPointer< Channel > forward( new Channel() );
+    QSharedPointer< Channel > backward( new Channel() );
+
+    *first = new SysTrayXLinkMemoryTransport( backward, forward );
+    *second = new SysTrayXLinkMemoryTransport( forward, backward );
+}
+
+
+/*
+ *	Get the name
+ */
+QString SysTrayXLinkMemoryTransport::getName() const
+{
+    return QString( "memory" );
+}
+
+
+/*
+ *	Check for frames
+ */
+SysTrayXLinkTransport::ReadResult   SysTrayXLinkMemoryTransport::read( SysTrayXLinkRingBuffer& ring )
+{
+    Q_UNUSED( ring )
+
+    QMutexLocker lock( &m_input->mutex );
+
+    if( !m_input->frames.isEmpty() )
+    {
+        return READ_DATA;
+    }
+
+    if( m_input->closed )
+    {
+        return READ_END;
+    }
+
+    /*
+     *  Wake me on the next write
+     */
+    m_input->notify = true;
+
+    return READ_WAIT;
+}
+
+
+/*
+ *	Get a received frame
+ */
+bool    SysTrayXLinkMemoryTransport::takeFrame( QByteArray& frame )
+{
+    QMutexLocker lock( &m_input->mutex );
+
+    if( m_input->frames.isEmpty() )
+    {
+        return false;
+    }
+
+    frame = m_input->frames.takeFirst();
+
+    return true;
+}
+
+
+/*
+ *	Pass frames to the peer
+ */
+bool    SysTrayXLinkMemoryTransport::write( const QByteArray* frames, int count )
+{
+    QMutexLocker lock( &m_output->mutex );
+
+    if( !m_output->reader )
+    {
+        return false;
+    }
+
+    for( int i = 0 ; i < count ; ++i )
+    {
+        m_output->frames.append( frames[ i ] );
+    }
+
+    /*
+     *  Only wake a waiting reader, once. Always queued, the reader takes the lock.
+     */
+    if( m_output->notify )
+    {
+        m_output->notify = false;
+        QMetaObject::invokeMethod( m_output->reader, "signalReadyRead", Qt::QueuedConnection );
+    }
+
+    return true;
+}
+
+
+/*****************************************************************************
+ *
+ *  Benchmark
+ *
+ *****************************************************************************/
+
+
+/**
+ * @brief The SysTrayXLinkBenchmarkPeer class. The other end of a benchmark, sends or echoes frames.
+ */
+class SysTrayXLinkBenchmarkPeer : public QThread
+{
+    public:
+
+        /**
+         * @brief SysTrayXLinkBenchmarkPeer. Constructor.
+         *
+         *  @param transport    The transport.
+         *  @param frame        The frame to send, empty to echo the received frames.
+         *  @param count        Number of frames to send or echo.
+         */
+        SysTrayXLinkBenchmarkPeer( SysTrayXLinkTransport* transport, const QByteArray& frame, int count )
+        {
+            m_transport = transport;
+            m_frame = frame;
+            m_count = count;
+        }
+
+    protected:
+
+        /**
+         * @brief run. Send or echo the frames.
+         */
+        void    run() override
+        {
+            if( !m_frame.isEmpty() )
+            {
+                QByteArray batch[ SysTrayXLinkStreamTransport::WRITE_BATCH ];
+                for( int i = 0 ; i < SysTrayXLinkStreamTransport::WRITE_BATCH ; ++i )
+                {
+                    batch[ i ] = m_frame;
+                }
+
+                for( int sent = 0 ; sent < m_count ; sent += SysTrayXLinkStreamTransport::WRITE_BATCH )
+                {
+                    if( !m_transport->write( batch, qMin( m_count - sent, SysTrayXLinkStreamTransport::WRITE_BATCH ) ) )
+                    {
+                        break;
+                    }
+                }
+            }
+            else
+            {
+                SysTrayXLinkRingBuffer ring;
+                int echoed = 0;
+
+                while( echoed < m_count )
+                {
+                    QByteArray frame;
+                    if( !receiveFrame( m_transport, ring, frame ) || !m_transport->write( &frame, 1 ) )
+                    {
+                        break;
+                    }
+
+                    echoed++;
+                }
+            }
+        }
+
+    public:
+
+        /**
+         * @brief receiveFrame. Wait for the next frame.
+         *
+         *  @param transport    The transport.
+         *  @param ring         The receive buffer.
+         *  @param frame        Storage for the frame.
+         *
+         *  @return     False at the end of the stream.
+         */
+        static bool receiveFrame( SysTrayXLinkTransport* transport, SysTrayXLinkRingBuffer& ring, QByteArray& frame )
+        {
+            forever
+            {
+                if( transport->takeFrame( frame ) )
+                {
+                    return true;
+                }
+
+                const char* data;
+                int data_len;
+
+                if( ring.nextFrame( &data, &data_len ) )
+                {
+                    frame = QByteArray( data, data_len );
+                    return true;
+                }
+
+                SysTrayXLinkTransport::ReadResult result = transport->read( ring );
+                if( result == SysTrayXLinkTransport::READ_END )
+                {
+                    return false;
+                }
+                else
+                if( result == SysTrayXLinkTransport::READ_WAIT )
+                {
+                    /*
+                     *  No event loop, let the other side run (single CPU)
+                     */
+                    QThread::yieldCurrentThread();
+                }
+            }
+        }
+
+    private:
+
+        /**
+         * @brief m_transport. The transport.
+         */
+        SysTrayXLinkTransport*  m_transport;
+
+        /**
+         * @brief m_frame. The frame to send.
+         */
+        QByteArray  m_frame;
+
+        /**
+         * @brief m_count. Number of frames.
+         */
+        int m_count;
+};
+
+
+/*
+ *  Create a connected pair of a transport type
+ */
+static bool createBenchmarkPair( int type, SysTrayXLinkTransport** first, SysTrayXLinkTransport** second )
+{
+    if( type == 0 )
+    {
+        SysTrayXLinkMemoryTransport* mem_first;
+        SysTrayXLinkMemoryTransport* mem_second;
+        SysTrayXLinkMemoryTransport::createPair( &mem_first, &mem_second );
+
+        *first = mem_first;
+        *second = mem_second;
+
+        return true;
+    }
+
+#ifdef Q_OS_UNIX
+    if( type == 1 )
+    {
+        /*
+         *  Pipes, like stdin / stdout
+         */
+        int forward[ 2 ];
+        int backward[ 2 ];
+
+        if( ::pipe( forward ) < 0 )
+        {
+            return false;
+        }
+
+        if( ::pipe( backward ) < 0 )
+        {
+            ::close( forward[ 0 ] );
+            ::close( forward[ 1 ] );
+            return false;
+        }
+
+        *first = new SysTrayXLinkStreamTransport( backward[ 0 ], forward[ 1 ], true );
+        *second = new SysTrayXLinkStreamTransport( forward[ 0 ], backward[ 1 ], true );
+
+        return true;
+    }
+
+    if( type == 2 )
+    {
+        QLocalServer server;
+        QString name = QString( "SysTray-X-benchmark-%1" ).arg( QCoreApplication::applicationPid() );
+
+        QLocalServer::removeServer( name );
+        if( !server.listen( name ) )
+        {
+            return false;
+        }
+
+        QLocalSocket client;
+        client.connectToServer( name );
+
+        if( !client.waitForConnected( 1000 ) || !server.waitForNewConnection( 1000 ) )
+        {
+            return false;
+        }
+
+        QLocalSocket* connection = server.nextPendingConnection();
+
+        *first = SysTrayXLinkSocketTransport::fromSocket( &client );
+        *second = SysTrayXLinkSocketTransport::fromSocket( connection );
+        delete connection;
+
+        if( !*first || !*second )
+        {
+            delete *first;
+            delete *second;
+            return false;
+        }
+
+        return true;
+    }
+#endif
+
+    return false;
+}
+
+
+/*
+ *  Measure the throughput and latency of the transports
+ */
+QStringList SysTrayXLinkTransport::benchmark()
+{
+    QStringList results;
+
+    const int frame_sizes[] = { 64, 4 * 1024, 256 * 1024 };
+
+    for( int type = 0 ; type < 3 ; ++type )
+    {
+        QString name;
+
+        /*
+         *  Throughput, frames from a sender thread
+         */
+        for( int size : frame_sizes )
+        {
+            SysTrayXLinkTransport* sender = nullptr;
+            SysTrayXLinkTransport* receiver = nullptr;
+
+            if( !createBenchmarkPair( type, &sender, &receiver ) )
+            {
+                break;
+            }
+            name = sender->getName();
+
+            QByteArray frame = "{\"x\":\"" + QByteArray( size - 8, 'a' ) + "\"}";
+            int count = qMax( BENCHMARK_BYTES / size, 100 );
+
+            receiver->startReading();
+
+            SysTrayXLinkRingBuffer ring;
+            SysTrayXLinkBenchmarkPeer peer( sender, frame, count );
+
+            QElapsedTimer timer;
+            timer.start();
+            peer.start();
+
+            int received = 0;
+            QByteArray data;
+            while( received < count && SysTrayXLinkBenchmarkPeer::receiveFrame( receiver, ring, data ) )
+            {
+                received++;
+            }
+
+            qint64 elapsed = qMax( timer.nsecsElapsed(), Q_INT64_C( 1 ) );
+            peer.wait();
+
+            results.append( QString( "Transport %1: %2 B frames, %3 frames/s, %4 MB/s%5" )
+                            .arg( name ).arg( frame.length() )
+                            .arg( static_cast< double >( received ) * 1e9 / elapsed, 0, 'f', 0 )
+                            .arg( static_cast< double >( received ) * frame.length() * 1e3 / elapsed, 0, 'f', 1 )
+                            .arg( received < count ? " (incomplete)" : "" ) );
+
+            delete sender;
+            delete receiver;
+        }
+
+        if( name.isEmpty() )
+        {
+            continue;
+        }
+
+        /*
+         *  Latency, round trips through an echo thread
+         */
+        SysTrayXLinkTransport* local = nullptr;
+        SysTrayXLinkTransport* remote = nullptr;
+
+        if( !createBenchmarkPair( type, &local, &remote ) )
+        {
+            continue;
+        }
+
+        local->startReading();
+        remote->startReading();
+
+        SysTrayXLinkRingBuffer ring;
+        SysTrayXLinkBenchmarkPeer echo( remote, QByteArray(), BENCHMARK_ROUND_TRIPS );
+        echo.start();
+
+        QByteArray frame( "{\"unreadMail\":42}" );
+        QByteArray answer;
+        int round_trips = 0;
+
+        QElapsedTimer timer;
+        timer.start();
+
+        while( round_trips < BENCHMARK_ROUND_TRIPS && local->write( &frame, 1 ) &&
+               SysTrayXLinkBenchmarkPeer::receiveFrame( local, ring, answer ) )
+        {
+            round_trips++;
+        }
+
+        qint64 elapsed = timer.nsecsElapsed();
+
+        delete local;
+        echo.wait();
+        delete remote;
+
+        if( round_trips > 0 )
+        {
+            results.append( QString( "Transport %1: round trip %2 us" )
+                            .arg( name ).arg( static_cast< double >( elapsed ) / round_trips / 1e3, 0, 'f', 2 ) );
+        }
+    }
+
+    return results;
+}
@@ -0,0 +1,466 @@
+#ifndef SYSTRAYXLINKTRANSPORT_H
+#define SYSTRAYXLINKTRANSPORT_H
+
+/*
+ *	Local includes
+ */
+
+/*
+ *  System includes
+ */
+#include <atomic>
+
+/*
+ *	Qt includes
+ */
+#include <QObject>
+#include <QMutex>
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <QSharedPointer>
+
+/*
+ *	Predefines
+ */
+class QLocalSocket;
+class QSocketNotifier;
+class SysTrayXLinkRingBuffer;
+
+
+/**
+ * @brief The SysTrayXLinkTransport class. Byte transport of the link.
+ *
+ *  Reading is done by the reader thread, writing by the writer thread. Frames are
+ *  a 32 bit native length followed by the data, like native messaging.
+ */
+class SysTrayXLinkTransport : public QObject
+{
+    Q_OBJECT
+
+    public:
+
+        /*
+         *  Read results
+         */
+        enum ReadResult
+        {
+            READ_DATA = 0,
+            READ_WAIT,
+            READ_END
+        };
+
+    public:
+
+        /**
+         * @brief ~SysTrayXLinkTransport. Destructor.
+         */
+        virtual ~SysTrayXLinkTransport();
+
+        /**
+         * @brief getName. Get the name of the transport.
+         *
+         *  @return     The name.
+         */
+        virtual QString getName() const = 0;
+
+        /**
+         * @brief isBlocking. Check for a transport that can only be read blocking.
+         *
+         *  A blocking read returns after one frame, signalReadyRead is never emitted.
+         *
+         *  @return     True if blocking.
+         */
+        virtual bool    isBlocking() const;
+
+        /**
+         * @brief isBinaryFraming. Check for a transport that carries CBOR frames next to JSON frames.
+         *
+         *  @return     True if CBOR was negotiated.
+         */
+        virtual bool    isBinaryFraming() const;
+
+        /**
+         * @brief startReading. Prepare for reading, called in the reading thread.
+         */
+        virtual void    startReading();
+
+        /**
+         * @brief setReadEnabled. Enable or disable signalReadyRead.
+         *
+         *  @param state    The state.
+         */
+        virtual void    setReadEnabled( bool state );
+
+        /**
+         * @brief read. Read the available data.
+         *
+         *  @param ring     Storage for the data.
+         *
+         *  @return     READ_DATA if data is available in the ring or from takeFrame,
+         *              READ_WAIT if the caller has to wait for signalReadyRead,
+         *              READ_END at the end of the stream.
+         */
+        virtual ReadResult  read( SysTrayXLinkRingBuffer& ring ) = 0;
+
+        /**
+         * @brief takeFrame. Get a complete frame, for transports that pass frames instead of bytes.
+         *
+         *  @param frame    Storage for the frame.
+         *
+         *  @return     Frame available.
+         */
+        virtual bool    takeFrame( QByteArray& frame );
+
+        /**
+         * @brief write. Write frames, blocks until all data is written.
+         *
+         *  @param frames   The frames.
+         *  @param count    The number of frames.
+         *
+         *  @return     Success.
+         */
+        virtual bool    write( const QByteArray* frames, int count ) = 0;
+
+        /**
+         * @brief cancel. Wake the threads blocked in a read or write, callable from any thread.
+         *
+         *  Later reads return READ_END, later writes fail.
+         */
+        virtual void    cancel();
+
+        /**
+         * @brief benchmark. Measure the throughput and latency of the transports.
+         *
+         *  @return     The results.
+         */
+        static QStringList  benchmark();
+
+    signals:
+
+        /**
+         * @brief signalReadyRead. Signal data is available.
+         */
+        void    signalReadyRead();
+};
+
+
+/**
+ * @brief The SysTrayXLinkStreamTransport class. Transport over file descriptors.
+ *
+ *  On Windows only stdin / stdout are supported.
+ */
+class SysTrayXLinkStreamTransport : public SysTrayXLinkTransport
+{
+    Q_OBJECT
+
+    public:
+
+        /**
+         * @brief WRITE_BATCH. Maximum number of frames per system call.
+         */
+        static const int WRITE_BATCH = 64;
+
+    public:
+
+        /**
+         * @brief SysTrayXLinkStreamTransport. Constructor, destructor.
+         *
+         *  @param read_fd      The input.
+         *  @param write_fd     The output.
+         *  @param close_fds    Close the descriptors in the destructor.
+         */
+        SysTrayXLinkStreamTransport( int read_fd, int write_fd, bool close_fds = false );
+        ~SysTrayXLinkStreamTransport();
+
+        /**
+         * @brief getName. Get the name of the transport.
+         *
+         *  @return     The name.
+         */
+        QString getName() const override;
+
+        /**
+         * @brief isBlocking. Check for a transport that can only be read blocking.
+         *
+         *  @return     True if blocking.
+         */
+        bool    isBlocking() const override;
+
+        /**
+         * @brief startReading. Make the input non blocking and watch it.
+         */
+        void    startReading() override;
+
+        /**
+         * @brief setReadEnabled. Enable or disable the input notifier.
+         *
+         *  @param state    The state.
+         */
+        void    setReadEnabled( bool state ) override;
+
+        /**
+         * @brief read. Read the available data.
+         *
+         *  @param ring     Storage for the data.
+         *
+         *  @return     The result.
+         */
+        ReadResult  read( SysTrayXLinkRingBuffer& ring ) override;
+
+        /**
+         * @brief write. Write frames, headers and data in a single call per batch.
+         *
+         *  @param frames   The frames.
+         *  @param count    The number of frames.
+         *
+         *  @return     Success.
+         */
+        bool    write( const QByteArray* frames, int count ) override;
+
+        /**
+         * @brief cancel. Wake the reader and writer blocked on a hung peer.
+         */
+        void    cancel() override;
+
+    private:
+
+#ifdef Q_OS_WIN
+
+        /**
+         * @brief registerThread. Remember the calling thread, its blocking calls can be cancelled.
+         *
+         *  @param thread   Storage for the thread handle.
+         */
+        void    registerThread( void** thread );
+#endif
+
+    private:
+
+        /**
+         * @brief m_read_fd. The input.
+         */
+        int m_read_fd;
+
+        /**
+         * @brief m_write_fd. The output.
+         */
+        int m_write_fd;
+
+        /**
+         * @brief m_close_fds. Close the descriptors in the destructor.
+         */
+        bool    m_close_fds;
+
+        /**
+         * @brief m_notifier. Input data available notifier.
+         */
+        QSocketNotifier*    m_notifier;
+
+        /**
+         * @brief m_cancelled. The transport has been cancelled.
+         */
+        std::atomic< bool > m_cancelled;
+
+#ifdef Q_OS_UNIX
+
+        /**
+         * @brief m_cancel_fds. Pipe waking a write waiting for room.
+         */
+        int m_cancel_fds[ 2 ];
+#else
+
+        /**
+         * @brief m_thread_mutex. Protects the thread handles.
+         */
+        QMutex  m_thread_mutex;
+
+        /**
+         * @brief m_read_thread. Handle of the thread reading, nullptr until the first read.
+         */
+        void*   m_read_thread;
+
+        /**
+         * @brief m_write_thread. Handle of the thread writing, nullptr until the first write.
+         */
+        void*   m_write_thread;
+#endif
+};
+
+
+/**
+ * @brief The SysTrayXLinkStdioTransport class. Native messaging transport over stdin / stdout.
+ */
+class SysTrayXLinkStdioTransport : public SysTrayXLinkStreamTransport
+{
+    Q_OBJECT
+
+    public:
+
+        /**
+         * @brief SysTrayXLinkStdioTransport. Constructor.
+         */
+        SysTrayXLinkStdioTransport();
+
+        /**
+         * @brief getName. Get the name of the transport.
+         *
+         *  @return     The name.
+         */
+        QString getName() const override;
+};
+
+
+#ifdef Q_OS_UNIX
+
+/**
+ * @brief The SysTrayXLinkSocketTransport class. Transport over a local socket.
+ *
+ *  The connected socket is taken over from QLocalSocket and used directly by both threads.
+ */
+class SysTrayXLinkSocketTransport : public SysTrayXLinkStreamTransport
+{
+    Q_OBJECT
+
+    public:
+
+        /**
+         * @brief SysTrayXLinkSocketTransport. Constructor.
+         *
+         *  @param fd   The connected socket, closed by the transport.
+         *  @param binary_framing   The other end accepts and sends CBOR frames.
+         */
+        explicit SysTrayXLinkSocketTransport( int fd, bool binary_framing = false );
+
+        /**
+         * @brief getName. Get the name of the transport.
+         *
+         *  @return     The name.
+         */
+        QString getName() const override;
+
+        /**
+         * @brief isBinaryFraming. Check for a transport that carries CBOR frames next to JSON frames.
+         *
+         *  @return     True if CBOR was negotiated.
+         */
+        bool    isBinaryFraming() const override;
+
+        /**
+         * @brief fromSocket. Take over a connected socket, before anything has been read from it.
+         *
+         *  @param socket   The socket, closed afterwards.
+         *
+         *  @return     The transport, nullptr on failure.
+         */
+        static SysTrayXLinkSocketTransport* fromSocket( QLocalSocket* socket );
+
+        /**
+         * @brief connectToServer. Connect to a local server.
+         *
+         *  @param name     The server name.
+         *  @param timeout  The timeout in ms.
+         *
+         *  @return     The transport, nullptr on failure.
+         */
+        static SysTrayXLinkSocketTransport* connectToServer( const QString& name, int timeout = 1000 );
+
+    private:
+
+        /**
+         * @brief m_binary_framing. The other end accepts and sends CBOR frames.
+         */
+        bool    m_binary_framing;
+};
+
+#endif
+
+
+/**
+ * @brief The SysTrayXLinkMemoryTransport class. In process transport, one end of a pair.
+ *
+ *  Frames are passed by reference, the data is never copied.
+ */
+class SysTrayXLinkMemoryTransport : public SysTrayXLinkTransport
+{
+    Q_OBJECT
+
+    public:
+
+        /**
+         * @brief createPair. Create two connected transports.
+         *
+         *  @param first    Storage for the first end.
+         *  @param second   Storage for the second end.
+         */
+        static void createPair( SysTrayXLinkMemoryTransport** first, SysTrayXLinkMemoryTransport** second );
+
+        /**
+         * @brief ~SysTrayXLinkMemoryTransport. Destructor, the peer sees the end of the stream.
+         */
+        ~SysTrayXLinkMemoryTransport();
+
+        /**
+         * @brief getName. Get the name of the transport.
+         *
+         *  @return     The name.
+         */
+        QString getName() const override;
+
+        /**
+         * @brief read. Check for available frames.
+         *
+         *  @param ring     Unused, frames are returned by takeFrame.
+         *
+         *  @return     The result.
+         */
+        ReadResult  read( SysTrayXLinkRingBuffer& ring ) override;
+
+        /**
+         * @brief takeFrame. Get a received frame.
+         *
+         *  @param frame    Storage for the frame.
+         *
+         *  @return     Frame available.
+         */
+        bool    takeFrame( QByteArray& frame ) override;
+
+        /**
+         * @brief write. Pass frames to the peer.
+         *
+         *  @param frames   The frames.
+         *  @param count    The number of frames.
+         *
+         *  @return     False if the peer is gone.
+         */
+        bool    write( const QByteArray* frames, int count ) override;
+
+    private:
+
+        /*
+         *  Frames in one direction, shared by both ends
+         */
+        class Channel;
+
+        /**
+         * @brief SysTrayXLinkMemoryTransport. Constructor.
+         *
+         *  @param input    The receive direction.
+         *  @param output   The send direction.
+         */
+        SysTrayXLinkMemoryTransport( QSharedPointer< Channel > input, QSharedPointer< Channel > output );
+
+    private:
+
+        /**
+         * @brief m_input. The receive direction.
+         */
+        QSharedPointer< Channel >   m_input;
+
+        /**
+         * @brief m_output. The send direction.
+         */
+        QSharedPointer< Channel >   m_output;
+};
+
+#endif // SYSTRAYXLINKTRANSPORT_H
@@ -0,0 +1,173 @@
+#include "systrayxunreadmodel.h"
+
+/*
+ *	Local includes
+ */
+
+
+/*
+ *	Qt includes
+ */
+
+
+/*
+ *	Constructor
+ */
+SysTrayXUnreadModel::SysTrayXUnreadModel( QObject* parent ) : QObject( parent )
+{
+    /*
+     *  Initialize
+     */
+    m_total = 0;
+    m_update_level = 0;
+    m_changed = false;
+    m_last_total = -1;
+}
+
+
+/*
+ *  Start a transaction
+ */
+void    SysTrayXUnreadModel::beginUpdate()
+{
+    m_update_level++;
+}
+
+
+/*
+ *  End a transaction
+ */
+void    SysTrayXUnreadModel::commitUpdate()
+{
+    if( m_update_level > 0 )
+    {
+        m_update_level--;
+    }
+
+    if( m_update_level > 0 )
+    {
+        return;
+    }
+
+    if( m_changed )
+    {
+        m_changed = false;
+
+        emit signalAccountUnread( getAccountUnread() );
+    }
+
+    if( m_total != m_last_total )
+    {
+        m_last_total = m_total;
+
+        emit signalUnreadMail( m_total );
+    }
+}
+
+
+/*
+ *  Remove all folders
+ */
+void    SysTrayXUnreadModel::clear()
+{
+    if( !m_accounts.isEmpty() )
+    {
+        m_accounts.clear();
+        m_changed = true;
+    }
+
+    m_total = 0;
+}
+
+
+/*
+ *  Set the unread mails of a folder
+ */
+void    SysTrayXUnreadModel::setUnread( const QString& account, const QString& name, const QString& folder, int unread )
+{
+    Account& acc = m_accounts[ account ];
+
+    if( !name.isEmpty() && acc.name != name )
+    {
+        acc.name = name;
+        m_changed = true;
+    }
+
+    unread = qMax( unread, 0 );
+
+    /*
+     *  Apply the difference, only the folders with unread mails are kept
+     */
+    QHash< QString, int >::iterator it = acc.folders.find( folder );
+    int old_unread = it != acc.folders.end() ? it.value() : 0;
+
+    if( unread != old_unread )
+    {
+        if( unread == 0 )
+        {
+            acc.folders.erase( it );
+        }
+        else
+        if( it != acc.folders.end() )
+        {
+            it.value() = unread;
+        }
+        else
+        {
+            acc.folders.insert( folder, unread );
+        }
+
+        acc.unread += unread - old_unread;
+        m_total += unread - old_unread;
+        m_changed = true;
+    }
+
+    if( m_update_level == 0 && m_changed )
+    {
+        /*
+         *  Not in a transaction, signal now
+         */
+        beginUpdate();
+        commitUpdate();
+    }
+}
+
+
+/*
+ *  Get the total number of unread mails
+ */
+int SysTrayXUnreadModel::getTotal() const
+{
+    return m_total;
+}
+
+
+/*
+ *  Get the number of folders with unread mails
+ */
+int SysTrayXUnreadModel::getFolderCount() const
+{
+    int count = 0;
+    for( QHash< QString, Account >::const_iterator it = m_accounts.constBegin() ; it != m_accounts.constEnd() ; ++it )
+    {
+        count += it.value().folders.size();
+    }
+
+    return count;
+}
+
+
+/*
+ *  Get the unread mails per account
+ */
+QMap< QString, int >    SysTrayXUnreadModel::getAccountUnread() const
+{
+    QMap< QString, int > accounts;
+    for( QHash< QString, Account >::const_iterator it = m_accounts.constBegin() ; it != m_accounts.constEnd() ; ++it )
+    {
+        const QString& name = it.value().name.isEmpty() ? it.key() : it.value().name;
+        accounts[ name ] += it.value().unread;
+    }
+
+    return accounts;
+}
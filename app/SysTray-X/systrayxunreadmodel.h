@@ -0,0 +1,156 @@
+#ifndef SYSTRAYXUNREADMODEL_H
+#define SYSTRAYXUNREADMODEL_H
+
+/*
+ *	Local includes
+ */
+
+/*
+ *	Qt includes
+ */
+#include <QObject>
+#include <QString>
+#include <QHash>
+#include <QMap>
+
+
+/**
+ * @brief The SysTrayXUnreadModel class. Unread mails per account and folder.
+ *
+ *  The add-on sends a snapshot of all folders and after that only the changed folders.
+ *  The account totals and the overall total are kept up to date incrementally.
+ */
+class SysTrayXUnreadModel : public QObject
+{
+    Q_OBJECT
+
+    public:
+
+        /**
+         * @brief SysTrayXUnreadModel. Constructor.
+         *
+         *  @param parent   My parent.
+         */
+        explicit SysTrayXUnreadModel( QObject* parent = nullptr );
+
+        /**
+         * @brief beginUpdate. Start a transaction, changes are signalled at the commit.
+         */
+        void    beginUpdate();
+
+        /**
+         * @brief commitUpdate. End a transaction, signal all changes at once.
+         */
+        void    commitUpdate();
+
+        /**
+         * @brief clear. Remove all folders, used before a snapshot.
+         */
+        void    clear();
+
+        /**
+         * @brief setUnread. Set the number of unread mails of a folder.
+         *
+         *  @param account  Id of the account.
+         *  @param name     Name of the account, empty to keep the known name.
+         *  @param folder   Path of the folder.
+         *  @param unread   The number of unread mails.
+         */
+        void    setUnread( const QString& account, const QString& name, const QString& folder, int unread );
+
+        /**
+         * @brief getTotal. Get the total number of unread mails.
+         *
+         *  @return     The count.
+         */
+        int getTotal() const;
+
+        /**
+         * @brief getFolderCount. Get the number of folders with unread mails.
+         *
+         *  @return     The count.
+         */
+        int getFolderCount() const;
+
+        /**
+         * @brief getAccountUnread. Get the number of unread mails per account.
+         *
+         *  @return     The counts by account name.
+         */
+        QMap< QString, int >    getAccountUnread() const;
+
+    signals:
+
+        /**
+         * @brief signalUnreadMail. Signal a change of the total number of unread mails.
+         *
+         *  @param unread_mail  The number of unread mails.
+         */
+        void    signalUnreadMail( int unread_mail );
+
+        /**
+         * @brief signalAccountUnread. Signal a change of the unread mails of the accounts.
+         *
+         *  @param accounts     The counts by account name.
+         */
+        void    signalAccountUnread( const QMap< QString, int >& accounts );
+
+    private:
+
+        /**
+         * @brief The Account class. The folders of an account.
+         */
+        class Account
+        {
+            public:
+
+                Account()
+                {
+                    unread = 0;
+                }
+
+                /**
+                 * @brief name. Name of the account.
+                 */
+                QString name;
+
+                /**
+                 * @brief unread. Number of unread mails of all folders.
+                 */
+                int unread;
+
+                /**
+                 * @brief folders. Unread mails by folder path, only folders with unread mails.
+                 */
+                QHash< QString, int >   folders;
+        };
+
+    private:
+
+        /**
+         * @brief m_accounts. The accounts by id.
+         */
+        QHash< QString, Account >   m_accounts;
+
+        /**
+         * @brief m_total. Total number of unread mails.
+         */
+        int m_total;
+
+        /**
+         * @brief m_update_level. Transaction nesting level.
+         */
+        int m_update_level;
+
+        /**
+         * @brief m_changed. The account counts changed in this transaction.
+         */
+        bool    m_changed;
+
+        /**
+         * @brief m_last_total. Last signalled total.
+         */
+        int m_last_total;
+};
+
+#endif // SYSTRAYXUNREADMODEL_H
@@ -6,9 +6,149 @@
  *  System includes
  */
 #include <unistd.h>
+#include <cstdlib>
+#include <cstring>
 #include <X11/Xlib.h>
 #include <X11/Xatom.h>
 #include <X11/Xutil.h>
+#include <X11/extensions/scrnsaver.h>
+#include <X11/Xlib-xcb.h>
+#include <xcb/xcb.h>
+#include <xcb/xproto.h>
+
+/*
+ *	Qt includes
+ */
+#include <QElapsedTimer>
+#include <QSocketNotifier>
+#include <QAbstractEventDispatcher>
+
+
+/*
+ *  Atom names, in the order of AtomId
+ */
+const char* const WindowCtrlUnix::AtomNames[ ATOM_COUNT ] = {
+    "_NET_WM_STATE_MODAL",
+    "_NET_WM_STATE_STICKY",
+    "_NET_WM_STATE_MAXIMIZED_VERT",
+    "_NET_WM_STATE_MAXIMIZED_HORZ",
+    "_NET_WM_STATE_SHADED",
+    "_NET_WM_STATE_SKIP_TASKBAR",
+    "_NET_WM_STATE_SKIP_PAGER",
+    "_NET_WM_STATE_HIDDEN",
+    "_NET_WM_STATE_FULLSCREEN",
+    "_NET_WM_STATE_ABOVE",
+    "_NET_WM_STATE_BELOW",
+    "_NET_WM_STATE_DEMANDS_ATTENTION",
+    "_NET_WM_WINDOW_TYPE_DESKTOP",
+    "_NET_WM_WINDOW_TYPE_DOCK",
+    "_NET_WM_WINDOW_TYPE_TOOLBAR",
+    "_NET_WM_WINDOW_TYPE_MENU",
+    "_NET_WM_WINDOW_TYPE_UTILITY",
+    "_NET_WM_WINDOW_TYPE_SPLASH",
+    "_NET_WM_WINDOW_TYPE_DIALOG",
+    "_NET_WM_WINDOW_TYPE_DROPDOWN_MENU",
+    "_NET_WM_WINDOW_TYPE_POPUP_MENU",
+    "_NET_WM_WINDOW_TYPE_TOOLTIP",
+    "_NET_WM_WINDOW_TYPE_NOTIFICATION",
+    "_NET_WM_WINDOW_TYPE_COMBO",
+    "_NET_WM_WINDOW_TYPE_DND",
+    "_NET_WM_WINDOW_TYPE_NORMAL",
+    "_NET_WM_STATE",
+    "_NET_WM_WINDOW_TYPE",
+    "_NET_WM_NAME",
+    "_NET_WM_PID",
+    "_NET_CLIENT_LIST",
+    "_NET_ACTIVE_WINDOW",
+    "UTF8_STRING",
+    "WM_PROTOCOLS",
+    "WM_DELETE_WINDOW",
+    "WM_STATE",
+    "WM_NAME",
+    "WM_CLASS"
+};
+
+
+/*
+ *  Thunderbird window classes
+ */
+const char* const WindowCtrlUnix::TB_CLASSES[] = { "Thunderbird", "thunderbird" };
+
+
+/*
+ *  Events selected on the tracked windows
+ */
+const long WindowCtrlUnix::TRACK_MASK = PropertyChangeMask | StructureNotifyMask;
+
+
+/*
+ *  Get the class part of a WM_CLASS property, "instance\0class\0"
+ */
+static QString  decodeClass( const char* data, int len )
+{
+    int instance_len = static_cast< int >( strnlen( data, static_cast< size_t >( len ) ) );
+    if( instance_len + 1 >= len )
+    {
+        return QString();
+    }
+
+    data += instance_len + 1;
+    len -= instance_len + 1;
+
+    return QString::fromUtf8( data, static_cast< int >( strnlen( data, static_cast< size_t >( len ) ) ) );
+}
+
+
+/*
+ *  Get a property of a window using Xlib, the caller frees the data
+ */
+static unsigned char*   getXProperty( Display* display, Window window, Atom prop, Atom type, long length, int* format, unsigned long* len )
+{
+    Atom actual_type;
+    unsigned long remain;
+    unsigned char* data = nullptr;
+
+    if( XGetWindowProperty( display, window, prop, 0, length, False, type,
+                &actual_type, format, len, &remain, &data ) != Success || actual_type != type )
+    {
+        if( data )
+        {
+            XFree( data );
+        }
+
+        *len = 0;
+        return nullptr;
+    }
+
+    return data;
+}
+
+
+/*
+ *  X error handler in place before ours, and our connections
+ */
+static XErrorHandler    previousXErrorHandler = nullptr;
+static QList< Display* >    ownDisplays;
+
+
+/*
+ *  Tracked windows may be destroyed at any time, ignore the errors of our requests in flight.
+ *  Everything else goes to the handler in place before ours.
+ */
+static int  ignoreXErrors( Display* display, XErrorEvent* error )
+{
+    if( ownDisplays.contains( display ) && ( error->error_code == BadWindow || error->error_code == BadMatch ) )
+    {
+        return 0;
+    }
+
+    if( previousXErrorHandler )
+    {
+        return previousXErrorHandler( display, error );
+    }
+
+    return 0;
+}
 
 
 /*
@@ -20,7 +160,10 @@ WindowCtrlUnix::WindowCtrlUnix( QObject *parent ) : QObject( parent )
      *  Initialize
      */
     m_tb_window = 0;
+    m_tb_pid = 0;
     m_tb_windows = QList< quint64 >();
+    m_tracked_state = QString();
+    m_index_order = 0;
 
     /*
      *  Get the base display and window
@@ -28,6 +171,103 @@ WindowCtrlUnix::WindowCtrlUnix( QObject *parent ) : QObject( parent )
     m_display = XOpenDisplay( ":0" );
     m_screen = 0;
     m_root_window = XDefaultRootWindow( m_display );
+
+    /*
+     *  Idle time source
+     */
+    int event_base;
+    int error_base;
+    m_screensaver = XScreenSaverQueryExtension( m_display, &event_base, &error_base );
+
+    /*
+     *  XCB shares the connection of the display, use it to pipeline the window searches
+     */
+    m_xcb = XGetXCBConnection( m_display );
+    m_backend = m_xcb ? BACKEND_XCB : BACKEND_XLIB;
+
+    /*
+     *  Intern all atoms in a single round trip
+     */
+    Atom atoms[ ATOM_COUNT ] = { None };
+    XInternAtoms( m_display, const_cast< char** >( AtomNames ), ATOM_COUNT, False, atoms );
+
+    for( int i = 0 ; i < ATOM_COUNT ; ++i )
+    {
+        m_atoms[ i ] = atoms[ i ];
+    }
+
+    /*
+     *  Install the error handler once for all our connections
+     */
+    if( ownDisplays.isEmpty() )
+    {
+        XErrorHandler previous = XSetErrorHandler( ignoreXErrors );
+        if( previous != ignoreXErrors )
+        {
+            previousXErrorHandler = previous;
+        }
+    }
+    ownDisplays.append( m_display );
+
+    /*
+     *  Handle the events of the tracked windows in the event loop.
+     *  Xlib may read events while waiting for a reply, check its queue before the loop sleeps.
+     *  (String based connect, the activated signal is overloaded in Qt 5.15)
+     */
+    m_x_notifier = new QSocketNotifier( ConnectionNumber( m_display ), QSocketNotifier::Read, this );
+    connect( m_x_notifier, SIGNAL( activated( int ) ), this, SLOT( slotXEvents() ) );
+    m_x_notifier->setEnabled( true );
+
+    connect( QAbstractEventDispatcher::instance(), &QAbstractEventDispatcher::aboutToBlock, this, &WindowCtrlUnix::slotXQueuedEvents );
+
+    /*
+     *  Build the window index once, the _NET_CLIENT_LIST changes keep it up to date.
+     *  Select the events first, no new window can be missed.
+     */
+    XSelectInput( m_display, static_cast< Window >( m_root_window ), PropertyChangeMask );
+
+    refreshIndex();
+}
+
+
+/*
+ *  Destructor
+ */
+WindowCtrlUnix::~WindowCtrlUnix()
+{
+    /*
+     *  Stop watching the connection before it is gone
+     */
+    delete m_x_notifier;
+    m_x_notifier = nullptr;
+
+    /*
+     *  Drop the event selections, a daemon opens a connection per profile
+     */
+    XSelectInput( m_display, static_cast< Window >( m_root_window ), NoEventMask );
+
+    foreach( quint64 window, m_tracked.keys() )
+    {
+        XSelectInput( m_display, static_cast< Window >( window ), NoEventMask );
+    }
+
+    XCloseDisplay( m_display );
+
+    /*
+     *  Give the error handling back with the last connection
+     */
+    ownDisplays.removeAll( m_display );
+    if( ownDisplays.isEmpty() )
+    {
+        XErrorHandler current = XSetErrorHandler( previousXErrorHandler );
+        if( current != ignoreXErrors )
+        {
+            /*
+             *  Someone else took over meanwhile, leave theirs in place
+             */
+            XSetErrorHandler( current );
+        }
+    }
 }
 
 
@@ -40,14 +280,689 @@ qint64  WindowCtrlUnix::getPpid()
 }
 
 
+/*
+ *  Get the time since the last user input
+ */
+qint64  WindowCtrlUnix::getIdleTime()
+{
+    if( !m_screensaver )
+    {
+        return -1;
+    }
+
+    XScreenSaverInfo info;
+    if( !XScreenSaverQueryInfo( m_display, m_root_window, &info ) )
+    {
+        return -1;
+    }
+
+    return static_cast< qint64 >( info.idle );
+}
+
+
 /*
  *  Find window(s) by title
  */
 bool    WindowCtrlUnix::findWindow( const QString& title )
 {
-    QList< WindowItem > windows = listXWindows( m_display, m_root_window );
+    QList< quint64 > found = findIndexTitleWindows( title );
 
-    m_tb_windows = QList< quint64 >();
+    /*
+     *  Only the Thunderbird windows, another application can show the same title.
+     *  Keep all matches for a Thunderbird with an unknown class.
+     */
+    m_tb_windows.clear();
+    for( const char* wm_class : TB_CLASSES )
+    {
+        foreach( quint64 window, findClassWindows( wm_class ) )
+        {
+            if( found.contains( window ) && !m_tb_windows.contains( window ) )
+            {
+                m_tb_windows.append( window );
+            }
+        }
+    }
+
+    if( m_tb_windows.isEmpty() )
+    {
+        m_tb_windows = found;
+    }
+
+    QList< quint64 > windows = m_tb_windows;
+    if( m_tb_window != 0 && !windows.contains( m_tb_window ) )
+    {
+        windows.append( m_tb_window );
+    }
+    trackWindows( windows );
+
+    if( m_tb_windows.length() > 0 )
+    {
+        return true;
+    }
+
+    return false;
+}
+
+
+/*
+ *  Find a window by PID
+ */
+void    WindowCtrlUnix::findWindow( qint64 pid )
+{
+    m_tb_pid = pid;
+    m_tb_window = findIndexPidWindow( pid );
+
+    QList< quint64 > windows = m_tb_windows;
+    if( m_tb_window != 0 && !windows.contains( m_tb_window ) )
+    {
+        windows.append( m_tb_window );
+    }
+    trackWindows( windows );
+}
+
+
+/*
+ *  Are the TB windows tracked
+ */
+bool    WindowCtrlUnix::isTrackingWindows() const
+{
+    return !m_tracked.isEmpty();
+}
+
+
+/*
+ *  Find the top level windows of a class
+ */
+QList< quint64 >    WindowCtrlUnix::findClassWindows( const QString& wm_class ) const
+{
+    return m_index_class.values( wm_class );
+}
+
+
+/*
+ *  Find the first indexed window of a process
+ */
+quint64 WindowCtrlUnix::findIndexPidWindow( qint64 pid )
+{
+    quint64 found = 0;
+    quint64 found_order = 0;
+
+    /*
+     *  Only the tracked windows report their property changes, re-read the others on a miss
+     */
+    for( int pass = 0 ; pass < 2 && found == 0 ; ++pass )
+    {
+        if( pass > 0 )
+        {
+            refreshIndex();
+        }
+
+        QMultiHash< qint64, quint64 >::const_iterator it = m_index_pid.constFind( pid );
+        for( ; it != m_index_pid.constEnd() && it.key() == pid ; ++it )
+        {
+            quint64 order = m_index.value( it.value() ).order;
+            if( found == 0 || order < found_order )
+            {
+                found = it.value();
+                found_order = order;
+            }
+        }
+    }
+
+    return found;
+}
+
+
+/*
+ *  Find the indexed windows with a (sub)title
+ */
+QList< quint64 >    WindowCtrlUnix::findIndexTitleWindows( const QString& title )
+{
+    /*
+     *  A substring match, no X requests needed for the tracked windows.
+     *  The others do not report their title changes, re-read the matching ones before trusting
+     *  them and all of them on a miss.
+     */
+    QList< quint64 > found;
+    for( int pass = 0 ; pass < 2 && found.isEmpty() ; ++pass )
+    {
+        if( pass > 0 )
+        {
+            refreshIndex();
+        }
+
+        QList< quint64 > untracked;
+        for( QHash< quint64, IndexedWindow >::const_iterator it = m_index.constBegin() ; it != m_index.constEnd() ; ++it )
+        {
+            if( it.value().title.contains( title, Qt::CaseInsensitive ) )
+            {
+                if( pass > 0 || m_tracked.contains( it.key() ) )
+                {
+                    found.append( it.key() );
+                }
+                else
+                {
+                    untracked.append( it.key() );
+                }
+            }
+        }
+
+        /*
+         *  One batch of requests for all untracked matches
+         */
+        indexWindows( untracked );
+
+        foreach( quint64 window, untracked )
+        {
+            if( m_index.value( window ).title.contains( title, Qt::CaseInsensitive ) )
+            {
+                found.append( window );
+            }
+        }
+    }
+
+    return found;
+}
+
+
+/*
+ *  Sync the index with the window list and re-read the properties
+ */
+void    WindowCtrlUnix::refreshIndex()
+{
+    QList< quint64 > windows;
+    foreach( WindowItem win, listCandidateWindows( m_backend ) )
+    {
+        windows.append( win.window );
+    }
+
+    foreach( quint64 window, m_index.keys() )
+    {
+        if( !windows.contains( window ) )
+        {
+            removeIndexWindow( window );
+        }
+    }
+
+    indexWindows( windows );
+}
+
+
+/*
+ *  Add windows to the index or refresh their properties
+ */
+void    WindowCtrlUnix::indexWindows( const QList< quint64 >& windows )
+{
+    if( windows.isEmpty() )
+    {
+        return;
+    }
+
+    QList< qint64 > pids;
+    QStringList classes;
+    QStringList net_names;
+    QStringList wm_names;
+
+    if( m_xcb )
+    {
+        /*
+         *  Send the requests for all windows before waiting for the first reply
+         */
+        QList< xcb_get_property_cookie_t > cookies;
+        foreach( quint64 window, windows )
+        {
+            xcb_window_t win = static_cast< xcb_window_t >( window );
+            cookies.append( xcb_get_property( m_xcb, 0, win, static_cast< xcb_atom_t >( m_atoms[ ATOM_NET_WM_PID ] ), XCB_ATOM_CARDINAL, 0, 1 ) );
+            cookies.append( xcb_get_property( m_xcb, 0, win, XCB_ATOM_WM_CLASS, XCB_ATOM_STRING, 0, 1024 ) );
+            cookies.append( xcb_get_property( m_xcb, 0, win, static_cast< xcb_atom_t >( m_atoms[ ATOM_NET_WM_NAME ] ),
+                                              static_cast< xcb_atom_t >( m_atoms[ ATOM_UTF8_STRING ] ), 0, 100000 ) );
+            cookies.append( xcb_get_property( m_xcb, 0, win, XCB_ATOM_WM_NAME, XCB_ATOM_STRING, 0, 100000 ) );
+        }
+
+        for( int i = 0 ; i < cookies.length() ; ++i )
+        {
+            xcb_get_property_reply_t* reply = xcb_get_property_reply( m_xcb, cookies.at( i ), nullptr );
+
+            const char* data = reply ? reinterpret_cast< const char* >( xcb_get_property_value( reply ) ) : nullptr;
+            int len = reply && reply->type != XCB_ATOM_NONE ? xcb_get_property_value_length( reply ) : 0;
+
+            switch( i % 4 )
+            {
+                case 0:
+                {
+                    pids.append( len >= 4 ? static_cast< qint64 >( *reinterpret_cast< const quint32* >( data ) ) : 0 );
+                    break;
+                }
+
+                case 1:
+                {
+                    classes.append( len > 0 ? decodeClass( data, len ) : QString() );
+                    break;
+                }
+
+                case 2:
+                {
+                    net_names.append( len > 0 ? QString::fromUtf8( data, len ) : QString() );
+                    break;
+                }
+
+                default:
+                {
+                    wm_names.append( len > 0 ? QString::fromUtf8( data, len ) : QString() );
+                    break;
+                }
+            }
+
+            free( reply );
+        }
+    }
+    else
+    {
+        foreach( quint64 window, windows )
+        {
+            Window win = static_cast< Window >( window );
+            int format;
+            unsigned long len;
+
+            /*
+             *  Format 32 properties are returned as longs
+             */
+            unsigned char* data = getXProperty( m_display, win, m_atoms[ ATOM_NET_WM_PID ], XA_CARDINAL, 1, &format, &len );
+            pids.append( data && len > 0 ? static_cast< qint64 >( *reinterpret_cast< unsigned long* >( data ) ) : 0 );
+            if( data )
+            {
+                XFree( data );
+            }
+
+            data = getXProperty( m_display, win, XA_WM_CLASS, XA_STRING, 1024, &format, &len );
+            classes.append( data && len > 0 ? decodeClass( reinterpret_cast< const char* >( data ), static_cast< int >( len ) ) : QString() );
+            if( data )
+            {
+                XFree( data );
+            }
+
+            data = getXProperty( m_display, win, m_atoms[ ATOM_NET_WM_NAME ], m_atoms[ ATOM_UTF8_STRING ], 100000, &format, &len );
+            net_names.append( data && len > 0 ? QString::fromUtf8( reinterpret_cast< const char* >( data ), static_cast< int >( len ) ) : QString() );
+            if( data )
+            {
+                XFree( data );
+            }
+
+            data = getXProperty( m_display, win, XA_WM_NAME, XA_STRING, 100000, &format, &len );
+            wm_names.append( data && len > 0 ? QString::fromUtf8( reinterpret_cast< const char* >( data ), static_cast< int >( len ) ) : QString() );
+            if( data )
+            {
+                XFree( data );
+            }
+        }
+    }
+
+    /*
+     *  Store, a refreshed window keeps its place in the order
+     */
+    for( int i = 0 ; i < windows.length() ; ++i )
+    {
+        quint64 window = windows.at( i );
+
+        IndexedWindow entry;
+        if( m_index.contains( window ) )
+        {
+            entry = m_index.value( window );
+            removeIndexWindow( window );
+        }
+        else
+        {
+            entry.order = m_index_order++;
+        }
+
+        entry.pid = pids.at( i );
+        entry.wm_class = classes.at( i );
+        entry.title = net_names.at( i ).isEmpty() ? wm_names.at( i ) : net_names.at( i );
+
+        m_index.insert( window, entry );
+
+        if( entry.pid != 0 )
+        {
+            m_index_pid.insert( entry.pid, window );
+        }
+
+        if( !entry.wm_class.isEmpty() )
+        {
+            m_index_class.insert( entry.wm_class, window );
+        }
+    }
+}
+
+
+/*
+ *  Remove a window from the index
+ */
+void    WindowCtrlUnix::removeIndexWindow( quint64 window )
+{
+    QHash< quint64, IndexedWindow >::iterator it = m_index.find( window );
+    if( it == m_index.end() )
+    {
+        return;
+    }
+
+    m_index_pid.remove( it.value().pid, window );
+    m_index_class.remove( it.value().wm_class, window );
+    m_index.erase( it );
+}
+
+
+/*
+ *  Follow the state of the windows
+ */
+void    WindowCtrlUnix::trackWindows( const QList< quint64 >& windows )
+{
+    /*
+     *  Stop following the windows no longer wanted
+     */
+    foreach( quint64 window, m_tracked.keys() )
+    {
+        if( !windows.contains( window ) )
+        {
+            XSelectInput( m_display, static_cast< Window >( window ), NoEventMask );
+            m_tracked.remove( window );
+        }
+    }
+
+    foreach( quint64 window, windows )
+    {
+        if( m_tracked.contains( window ) )
+        {
+            continue;
+        }
+
+        /*
+         *  Select the events before reading the state, no change can be missed
+         */
+        XSelectInput( m_display, static_cast< Window >( window ), TRACK_MASK );
+
+        XWindowAttributes attributes;
+        if( !XGetWindowAttributes( m_display, static_cast< Window >( window ), &attributes ) )
+        {
+            continue;
+        }
+
+        TrackedWindow tracked;
+        tracked.mapped = attributes.map_state != IsUnmapped;
+        tracked.iconic = readWmState( window ) == IconicState;
+        tracked.hidden = atomState( m_display, window ).contains( STATE_HIDDEN );
+
+        m_tracked.insert( window, tracked );
+    }
+
+    XFlush( m_display );
+
+    updateTrackedState();
+}
+
+
+/*
+ *  Handle the X events, the connection is readable
+ */
+void    WindowCtrlUnix::slotXEvents()
+{
+    processXEvents( QueuedAfterReading );
+}
+
+
+/*
+ *  Handle the X events already read by Xlib
+ */
+void    WindowCtrlUnix::slotXQueuedEvents()
+{
+    processXEvents( QueuedAlready );
+}
+
+
+/*
+ *  Handle the queued X events
+ */
+void    WindowCtrlUnix::processXEvents( int mode )
+{
+    if( XEventsQueued( m_display, mode ) == 0 )
+    {
+        return;
+    }
+
+    while( XEventsQueued( m_display, QueuedAlready ) > 0 )
+    {
+        XEvent event;
+        XNextEvent( m_display, &event );
+
+        handleXEvent( &event );
+    }
+
+    /*
+     *  Signal once per batch
+     */
+    updateTrackedState();
+}
+
+
+/*
+ *  Update the tracked windows with an event
+ */
+void    WindowCtrlUnix::handleXEvent( XEvent* event )
+{
+    switch( event->type )
+    {
+        case MapNotify:
+        {
+            QHash< quint64, TrackedWindow >::iterator it = m_tracked.find( event->xmap.window );
+            if( it != m_tracked.end() )
+            {
+                it.value().mapped = true;
+            }
+            break;
+        }
+
+        case UnmapNotify:
+        {
+            QHash< quint64, TrackedWindow >::iterator it = m_tracked.find( event->xunmap.window );
+            if( it != m_tracked.end() )
+            {
+                it.value().mapped = false;
+            }
+            break;
+        }
+
+        case DestroyNotify:
+        {
+            quint64 window = event->xdestroywindow.window;
+
+            removeIndexWindow( window );
+            m_tracked.remove( window );
+
+            /*
+             *  Forget the destroyed Thunderbird window, its successor is picked up from the client list
+             */
+            m_tb_windows.removeAll( window );
+            if( m_tb_window == window )
+            {
+                m_tb_window = 0;
+            }
+            break;
+        }
+
+        case PropertyNotify:
+        {
+            Atom atom = event->xproperty.atom;
+
+            if( event->xproperty.window == static_cast< Window >( m_root_window ) )
+            {
+                /*
+                 *  Managed windows came or went, index the new ones and drop the gone ones
+                 */
+                if( atom == m_atoms[ ATOM_NET_CLIENT_LIST ] )
+                {
+                    QList< WindowItem > clients;
+                    if( listClientWindows( clients ) )
+                    {
+                        QList< quint64 > current;
+                        QList< quint64 > windows;
+                        foreach( WindowItem win, clients )
+                        {
+                            current.append( win.window );
+
+                            if( !m_index.contains( win.window ) )
+                            {
+                                windows.append( win.window );
+                            }
+                        }
+
+                        foreach( quint64 window, m_index.keys() )
+                        {
+                            if( !current.contains( window ) )
+                            {
+                                removeIndexWindow( window );
+                            }
+                        }
+
+                        indexWindows( windows );
+
+                        /*
+                         *  A new window of Thunderbird replaces the destroyed one
+                         */
+                        if( m_tb_window == 0 && m_tb_pid != 0 )
+                        {
+                            foreach( quint64 window, windows )
+                            {
+                                if( m_index.value( window ).pid == m_tb_pid )
+                                {
+                                    m_tb_window = window;
+
+                                    QList< quint64 > tracked = m_tb_windows;
+                                    tracked.append( m_tb_window );
+                                    trackWindows( tracked );
+                                    break;
+                                }
+                            }
+                        }
+                    }
+                }
+                break;
+            }
+
+            /*
+             *  Only the tracked windows report their property changes
+             */
+            if( m_index.contains( event->xproperty.window ) &&
+                    ( atom == m_atoms[ ATOM_NET_WM_PID ] || atom == m_atoms[ ATOM_NET_WM_NAME ] ||
+                      atom == m_atoms[ ATOM_WM_NAME ] || atom == m_atoms[ ATOM_WM_CLASS ] ) )
+            {
+                indexWindows( QList< quint64 >() << event->xproperty.window );
+            }
+
+            QHash< quint64, TrackedWindow >::iterator it = m_tracked.find( event->xproperty.window );
+            if( it == m_tracked.end() )
+            {
+                break;
+            }
+
+            /*
+             *  The event only names the property, read the new value
+             */
+            if( event->xproperty.atom == m_atoms[ ATOM_WM_STATE ] )
+            {
+                it.value().iconic = event->xproperty.state == PropertyNewValue &&
+                        readWmState( event->xproperty.window ) == IconicState;
+            }
+            else
+            if( event->xproperty.atom == m_atoms[ ATOM_NET_WM_STATE ] )
+            {
+                it.value().hidden = event->xproperty.state == PropertyNewValue &&
+                        atomState( m_display, event->xproperty.window ).contains( STATE_HIDDEN );
+            }
+            break;
+        }
+
+        default:
+        {
+            break;
+        }
+    }
+}
+
+
+/*
+ *  Get the ICCCM state of the window
+ */
+long    WindowCtrlUnix::readWmState( quint64 window )
+{
+    Atom type;
+    int format;
+    unsigned long remain;
+    unsigned long len;
+    unsigned char* list = nullptr;
+
+    long state = -1;
+
+    Atom prop = m_atoms[ ATOM_WM_STATE ];
+    if( XGetWindowProperty( m_display, static_cast< Window >( window ), prop, 0, 2, False, prop,
+                &type, &format, &len, &remain, &list ) == Success && type == prop && format == 32 && len > 0 )
+    {
+        /*
+         *  Format 32 properties are returned as longs
+         */
+        state = reinterpret_cast< long* >( list )[ 0 ];
+    }
+
+    if( list )
+    {
+        XFree( list );
+    }
+
+    return state;
+}
+
+
+/*
+ *  Signal the state of the tracked windows
+ */
+void    WindowCtrlUnix::updateTrackedState()
+{
+    if( m_tracked.isEmpty() )
+    {
+        return;
+    }
+
+    /*
+     *  Normal as long as one of the windows is visible
+     */
+    QString state = "minimized";
+    for( QHash< quint64, TrackedWindow >::const_iterator it = m_tracked.constBegin() ; it != m_tracked.constEnd() ; ++it )
+    {
+        if( it.value().mapped && !it.value().iconic && !it.value().hidden )
+        {
+            state = "normal";
+            break;
+        }
+    }
+
+    if( state != m_tracked_state )
+    {
+        m_tracked_state = state;
+
+        emit signalWindowStateChanged( state );
+    }
+}
+
+
+/*
+ *  Find window(s) by title
+ */
+QList< quint64 >    WindowCtrlUnix::findTitleWindows( Backend backend, const QString& title, const QList< WindowItem >& windows )
+{
+    if( backend == BACKEND_XCB && m_xcb )
+    {
+        return findXcbTitleWindows( title, windows );
+    }
+
+    QList< quint64 > found;
     foreach( WindowItem win, windows )
     {
         char *name = nullptr;
@@ -60,35 +975,31 @@ bool    WindowCtrlUnix::findWindow( const QString& title )
                 /*
                  *  Store the XID
                  */
-                m_tb_windows.append( static_cast<quint64>( win.window ) );
+                found.append( static_cast<quint64>( win.window ) );
             }
         }
     }
 
-    if( m_tb_windows.length() > 0 )
-    {
-        return true;
-    }
-
-    return false;
+    return found;
 }
 
 
 /*
- *  Find a window by PID
+ *  Find the first window of a process
  */
-void    WindowCtrlUnix::findWindow( qint64 pid )
+quint64 WindowCtrlUnix::findPidWindow( Backend backend, qint64 pid, const QList< WindowItem >& windows )
 {
-    QList< WindowItem > windows = listXWindows( m_display, m_root_window );
+    if( backend == BACKEND_XCB && m_xcb )
+    {
+        return findXcbPidWindow( pid, windows );
+    }
 
-    // Get the PID property atom.
-    Atom atom_PID = XInternAtom( m_display, "_NET_WM_PID", True );
+    Atom atom_PID = m_atoms[ ATOM_NET_WM_PID ];
     if( atom_PID == None )
     {
-        return;
+        return 0;
     }
 
-    m_tb_window = 0;
     foreach( WindowItem win, windows )
     {
         Atom           type;
@@ -102,44 +1013,112 @@ void    WindowCtrlUnix::findWindow( qint64 pid )
         {
             if( propPID != nullptr )
             {
-                if( pid == *((reinterpret_cast<qint64 *>( propPID ) ) ) )
-                {
-                    m_tb_window = win.window;
-
-                    XFree( propPID );
-                    return;
-                }
+                /*
+                 *  Format 32 properties are returned as longs
+                 */
+                bool found = nItems > 0 && pid == static_cast< qint64 >( *reinterpret_cast< unsigned long* >( propPID ) );
 
                 XFree( propPID );
+
+                if( found )
+                {
+                    return win.window;
+                }
             }
         }
     }
+
+    return 0;
 }
 
 
 /*
- *  Display window atoms
+ *  Compare the window search methods
  */
-void    WindowCtrlUnix::displayWindowElements( const QString& title )
+QStringList WindowCtrlUnix::benchmarkFindWindow( qint64 pid, int iterations )
 {
-    QList< WindowItem > windows = listXWindows( m_display, m_root_window );
+    QStringList results;
 
-    foreach( WindowItem win, windows )
+    const char* const backends[] = { "Xlib", "XCB" };
+    const char* const names[] = { "client list", "window tree" };
+    for( int backend = BACKEND_XLIB ; backend <= BACKEND_XCB ; ++backend )
     {
-        char *name = nullptr;
-        if( XFetchName( m_display, win.window, &name ) > 0 ) {
-            QString win_name( name );
-
-            XFree( name );
+        if( backend == BACKEND_XCB && !m_xcb )
+        {
+            results.append( QString( "Find window XCB: not available" ) );
+            break;
+        }
 
-            if( win_name.contains( title, Qt::CaseInsensitive ) ) {
+        for( int method = 0 ; method < 2 ; ++method )
+        {
+            XSync( m_display, False );
+            unsigned long requests = XNextRequest( m_display );
 
-                emit signalConsole( QString( "Found: Level %1, XID %2, Name %3" ).arg( win.level ).arg( win.window ).arg( win_name ) );
+            QElapsedTimer timer;
+            timer.start();
 
-                displayWindowElements( win.window );
+            int scanned = 0;
+            quint64 window = 0;
+            for( int i = 0 ; i < iterations ; ++i )
+            {
+                QList< WindowItem > windows = listCandidateWindows( static_cast< Backend >( backend ), method == 0 );
+                scanned = windows.length();
+                window = findPidWindow( static_cast< Backend >( backend ), pid, windows );
             }
+
+            qint64 elapsed = timer.nsecsElapsed() / 1000;
+
+            /*
+             *  Let Xlib catch up with the requests sent through XCB, minus the sync itself
+             */
+            XSync( m_display, False );
+            requests = XNextRequest( m_display ) - requests - 1;
+
+            results.append( QString( "Find window %1 %2: %3 windows scanned, XID %4, %5 us, %6 requests per search" )
+                            .arg( backends[ backend ] ).arg( names[ method ] ).arg( scanned ).arg( window )
+                            .arg( elapsed / qMax( iterations, 1 ) ).arg( requests / qMax( iterations, 1 ) ) );
         }
     }
+
+    /*
+     *  The window index, in ns, a lookup is too fast for us
+     */
+    XSync( m_display, False );
+    unsigned long requests = XNextRequest( m_display );
+
+    QElapsedTimer timer;
+    timer.start();
+
+    quint64 window = 0;
+    for( int i = 0 ; i < iterations ; ++i )
+    {
+        window = findIndexPidWindow( pid );
+    }
+
+    qint64 elapsed = timer.nsecsElapsed();
+    requests = XNextRequest( m_display ) - requests;
+
+    results.append( QString( "Find window index: %1 windows indexed, XID %2, %3 ns, %4 requests per search" )
+                    .arg( m_index.size() ).arg( window )
+                    .arg( elapsed / qMax( iterations, 1 ) ).arg( requests / qMax( iterations, 1 ) ) );
+
+    return results;
+}
+
+
+/*
+ *  Display window atoms
+ */
+void    WindowCtrlUnix::displayWindowElements( const QString& title )
+{
+    foreach( quint64 window, findIndexTitleWindows( title ) )
+    {
+        IndexedWindow win = m_index.value( window );
+
+        emit signalConsole( QString( "Found: XID %1, Pid %2, Class %3, Name %4" ).arg( window ).arg( win.pid ).arg( win.wm_class ).arg( win.title ) );
+
+        displayWindowElements( window );
+    }
 }
 
 
@@ -151,25 +1130,24 @@ void    WindowCtrlUnix::displayWindowElements( quint64 window )
     QString name = atomName( m_display, window );
     emit signalConsole( QString( "Atom name: %1" ).arg( name ) );
 
-    QStringList types = atomWindowType( m_display, window );
-    foreach( QString type, types )
+    QList< WindowType > types = atomWindowType( m_display, window );
+    foreach( WindowType type, types )
     {
-        emit signalConsole( QString( "Atom type: %1" ).arg( type ) );
+        QString type_name = type == TYPE_UNKNOWN ? QString( "unknown" ) : QString( AtomNames[ ATOM_NET_WM_WINDOW_TYPE_DESKTOP + type - TYPE_DESKTOP ] );
+        emit signalConsole( QString( "Atom type: %1" ).arg( type_name ) );
     }
 
-    QStringList states = atomState( m_display, window );
+    QList< WindowState > states = atomState( m_display, window );
 
     bool max_vert = false;
     bool max_horz = false;
     bool hidden = false;
 
-    foreach( QString state, states )
+    foreach( WindowState state, states )
     {
-        emit signalConsole( QString( "Atom state: %1" ).arg( state ) );
-
-        int state_code = WindowStates.indexOf( state ) ;
+        emit signalConsole( QString( "Atom state: %1" ).arg( WindowStates[ state ] ) );
 
-        switch( state_code )
+        switch( state )
         {
             case STATE_MAXIMIZED_VERT:
             {
@@ -188,6 +1166,11 @@ void    WindowCtrlUnix::displayWindowElements( quint64 window )
                 hidden = true;
                 break;
             }
+
+            default:
+            {
+                break;
+            }
         }
     }
 
@@ -262,7 +1245,7 @@ void    WindowCtrlUnix::normalizeWindow( quint64 window )
     event.xclient.type = ClientMessage;
     event.xclient.serial = 0;
     event.xclient.send_event = True;
-    event.xclient.message_type = XInternAtom( m_display, "_NET_ACTIVE_WINDOW", False );
+    event.xclient.message_type = m_atoms[ ATOM_NET_ACTIVE_WINDOW ];
     event.xclient.window = static_cast<Window>( window );
     event.xclient.format = 32;
 
@@ -280,9 +1263,8 @@ void    WindowCtrlUnix::hideWindow( quint64 window, bool set )
 {
     Window win = static_cast<Window>( window );
 
-    char prop_name[] = "_NET_WM_STATE";
-    Atom prop = XInternAtom( m_display, prop_name, True );
-    Atom prop_skip_taskbar = XInternAtom( m_display, WindowStates[ STATE_SKIP_TASKBAR ].toUtf8(), True );
+    Atom prop = m_atoms[ ATOM_NET_WM_STATE ];
+    Atom prop_skip_taskbar = m_atoms[ ATOM_NET_WM_STATE_SKIP_TASKBAR ];
 
     Atom type;
     int format;
@@ -362,14 +1344,9 @@ void    WindowCtrlUnix::deleteWindow( quint64 window )
 {
     Window win = static_cast<Window>( window );
 
-    Atom prop = XInternAtom( m_display, "WM_PROTOCOLS", True );
-    if( prop == None )
-    {
-        return;
-    }
-
-    Atom delete_prop = XInternAtom( m_display, "WM_DELETE_WINDOW", False );
-    if( prop == None )
+    Atom prop = m_atoms[ ATOM_WM_PROTOCOLS ];
+    Atom delete_prop = m_atoms[ ATOM_WM_DELETE_WINDOW ];
+    if( prop == None || delete_prop == None )
     {
         return;
     }
@@ -386,6 +1363,258 @@ void    WindowCtrlUnix::deleteWindow( quint64 window )
 }
 
 
+/*
+ *  Get the windows to search
+ */
+QList< WindowCtrlUnix::WindowItem >   WindowCtrlUnix::listCandidateWindows( Backend backend, bool use_client_list )
+{
+    QList< WindowItem > windows;
+
+    if( backend == BACKEND_XCB && m_xcb )
+    {
+        if( use_client_list && listXcbClientWindows( windows ) )
+        {
+            return windows;
+        }
+
+        return listXcbWindows();
+    }
+
+    if( use_client_list && listClientWindows( windows ) )
+    {
+        return windows;
+    }
+
+    /*
+     *  No EWMH window manager, walk the whole tree
+     */
+    return listXWindows( m_display, m_root_window );
+}
+
+
+/*
+ *  Get the managed top level windows
+ */
+bool    WindowCtrlUnix::listClientWindows( QList< WindowItem >& windows )
+{
+    Atom prop = m_atoms[ ATOM_NET_CLIENT_LIST ];
+    if( prop == None )
+    {
+        return false;
+    }
+
+    Atom type;
+    int format;
+    unsigned long remain;
+    unsigned long len;
+    unsigned char* list = nullptr;
+
+    bool supported = false;
+
+    if( XGetWindowProperty( m_display, m_root_window, prop, 0, LONG_MAX, False, XA_WINDOW,
+                &type, &format, &len, &remain, &list ) == Success && type == XA_WINDOW && format == 32 )
+    {
+        Window* clients = reinterpret_cast< Window* >( list );
+        for( unsigned long i = 0; i < len; ++i )
+        {
+            windows.append( WindowItem( clients[ i ], 0 ) );
+        }
+
+        supported = true;
+    }
+
+    if( list )
+    {
+        XFree( list );
+    }
+
+    return supported;
+}
+
+
+/*
+ *  Get the managed top level windows using XCB
+ */
+bool    WindowCtrlUnix::listXcbClientWindows( QList< WindowItem >& windows )
+{
+    Atom prop = m_atoms[ ATOM_NET_CLIENT_LIST ];
+    if( prop == None )
+    {
+        return false;
+    }
+
+    xcb_get_property_cookie_t cookie = xcb_get_property( m_xcb, 0, static_cast< xcb_window_t >( m_root_window ),
+                                                         static_cast< xcb_atom_t >( prop ), XCB_ATOM_WINDOW, 0, UINT32_MAX );
+
+    xcb_get_property_reply_t* reply = xcb_get_property_reply( m_xcb, cookie, nullptr );
+    if( reply == nullptr )
+    {
+        return false;
+    }
+
+    bool supported = false;
+    if( reply->type == XCB_ATOM_WINDOW && reply->format == 32 )
+    {
+        xcb_window_t* clients = reinterpret_cast< xcb_window_t* >( xcb_get_property_value( reply ) );
+        int len = xcb_get_property_value_length( reply ) / static_cast< int >( sizeof( xcb_window_t ) );
+        for( int i = 0; i < len; ++i )
+        {
+            windows.append( WindowItem( clients[ i ], 0 ) );
+        }
+
+        supported = true;
+    }
+
+    free( reply );
+
+    return supported;
+}
+
+
+/*
+ *  Get the X11 window list using XCB
+ */
+QList< WindowCtrlUnix::WindowItem >   WindowCtrlUnix::listXcbWindows()
+{
+    QList< WindowItem > windows;
+
+    /*
+     *  Walk the tree breadth first, the queries of a level are sent at once
+     */
+    QList< xcb_window_t > parents;
+    parents.append( static_cast< xcb_window_t >( m_root_window ) );
+
+    for( int level = 0 ; !parents.isEmpty() ; ++level )
+    {
+        QList< xcb_query_tree_cookie_t > cookies;
+        foreach( xcb_window_t parent, parents )
+        {
+            cookies.append( xcb_query_tree( m_xcb, parent ) );
+        }
+
+        parents.clear();
+        foreach( xcb_query_tree_cookie_t cookie, cookies )
+        {
+            xcb_query_tree_reply_t* reply = xcb_query_tree_reply( m_xcb, cookie, nullptr );
+            if( reply == nullptr )
+            {
+                continue;
+            }
+
+            xcb_window_t* children = xcb_query_tree_children( reply );
+            int len = xcb_query_tree_children_length( reply );
+            for( int i = 0; i < len; ++i )
+            {
+                windows.append( WindowItem( children[ i ], level ) );
+                parents.append( children[ i ] );
+            }
+
+            free( reply );
+        }
+    }
+
+    return windows;
+}
+
+
+/*
+ *  Find the first window of a process using XCB
+ */
+quint64 WindowCtrlUnix::findXcbPidWindow( qint64 pid, const QList< WindowItem >& windows )
+{
+    Atom atom_PID = m_atoms[ ATOM_NET_WM_PID ];
+    if( atom_PID == None )
+    {
+        return 0;
+    }
+
+    /*
+     *  Send all requests before waiting for the first reply
+     */
+    QList< xcb_get_property_cookie_t > cookies;
+    foreach( WindowItem win, windows )
+    {
+        cookies.append( xcb_get_property( m_xcb, 0, static_cast< xcb_window_t >( win.window ),
+                                          static_cast< xcb_atom_t >( atom_PID ), XCB_ATOM_CARDINAL, 0, 1 ) );
+    }
+
+    quint64 found = 0;
+    for( int i = 0 ; i < cookies.length() ; ++i )
+    {
+        if( found != 0 )
+        {
+            /*
+             *  Drop the replies still to come
+             */
+            xcb_discard_reply( m_xcb, cookies.at( i ).sequence );
+            continue;
+        }
+
+        xcb_get_property_reply_t* reply = xcb_get_property_reply( m_xcb, cookies.at( i ), nullptr );
+        if( reply == nullptr )
+        {
+            continue;
+        }
+
+        if( reply->type == XCB_ATOM_CARDINAL && reply->format == 32 && xcb_get_property_value_length( reply ) >= 4 )
+        {
+            if( pid == static_cast< qint64 >( *reinterpret_cast< quint32* >( xcb_get_property_value( reply ) ) ) )
+            {
+                found = windows.at( i ).window;
+            }
+        }
+
+        free( reply );
+    }
+
+    return found;
+}
+
+
+/*
+ *  Find window(s) by title using XCB
+ */
+QList< quint64 >    WindowCtrlUnix::findXcbTitleWindows( const QString& title, const QList< WindowItem >& windows )
+{
+    /*
+     *  Send all requests before waiting for the first reply, same property as XFetchName
+     */
+    QList< xcb_get_property_cookie_t > cookies;
+    foreach( WindowItem win, windows )
+    {
+        cookies.append( xcb_get_property( m_xcb, 0, static_cast< xcb_window_t >( win.window ),
+                                          XCB_ATOM_WM_NAME, XCB_ATOM_STRING, 0, 100000 ) );
+    }
+
+    QList< quint64 > found;
+    for( int i = 0 ; i < cookies.length() ; ++i )
+    {
+        xcb_get_property_reply_t* reply = xcb_get_property_reply( m_xcb, cookies.at( i ), nullptr );
+        if( reply == nullptr )
+        {
+            continue;
+        }
+
+        int len = xcb_get_property_value_length( reply );
+        if( reply->type == XCB_ATOM_STRING && reply->format == 8 && len > 0 )
+        {
+            QString win_name = QString::fromUtf8( reinterpret_cast< const char* >( xcb_get_property_value( reply ) ), len );
+
+            if( win_name.contains( title, Qt::CaseInsensitive ) ) {
+                /*
+                 *  Store the XID
+                 */
+                found.append( windows.at( i ).window );
+            }
+        }
+
+        free( reply );
+    }
+
+    return found;
+}
+
+
 /*
  *  Get the X11 window list
  */
@@ -417,9 +1646,8 @@ QList< WindowCtrlUnix::WindowItem >   WindowCtrlUnix::listXWindows( Display *dis
  */
 QString   WindowCtrlUnix::atomName( Display *display, quint64 window )
 {
-    char prop_name[] = "_NET_WM_NAME";
-    Atom prop = XInternAtom( display, prop_name, True );
-    Atom utf8_string = XInternAtom( display, "UTF8_STRING", False );
+    Atom prop = m_atoms[ ATOM_NET_WM_NAME ];
+    Atom utf8_string = m_atoms[ ATOM_UTF8_STRING ];
 
     Atom type;
     int format;
@@ -447,42 +1675,26 @@ QString   WindowCtrlUnix::atomName( Display *display, quint64 window )
 /*
  *  Get the state of the window
  */
-QStringList    WindowCtrlUnix::atomState( Display *display, quint64 window )
+QList< WindowCtrlUnix::WindowState >    WindowCtrlUnix::atomState( Display *display, quint64 window )
 {
-    char prop_name[] = "_NET_WM_STATE";
-    Atom prop = XInternAtom( display, prop_name, True );
-
-    Atom type;
-    int format;
-    unsigned long remain;
-    unsigned long len;
-    unsigned char* list = nullptr;
+    QList< WindowState > states;
 
-    QStringList states;
-
-//    if( XGetWindowProperty( display, window, prop, 0, LONG_MAX, False, AnyPropertyType,
-//                &type, &format, &len, &remain, &list ) == Success )
-    if( XGetWindowProperty( display, window, prop, 0, sizeof( Atom ), False, XA_ATOM,
-                &type, &format, &len, &remain, &list ) == Success )
+    QList< unsigned long > atoms = atomListProperty( display, window, m_atoms[ ATOM_NET_WM_STATE ] );
+    foreach( unsigned long atom, atoms )
     {
-        for( unsigned long i = 0; i < len; ++i )
+        /*
+         *  The state atoms are the first in the table
+         */
+        for( int state = STATE_MODAL ; state <= STATE_DEMANDS_ATTENTION ; ++state )
         {
-            char* atom_name = XGetAtomName( display, reinterpret_cast<Atom *>( list )[ i ] );
-
-            states.append( atom_name );
-
-            if( atom_name )
+            if( atom == m_atoms[ ATOM_NET_WM_STATE_MODAL + state ] )
             {
-                XFree( atom_name );
+                states.append( static_cast< WindowState >( state ) );
+                break;
             }
         }
     }
 
-    if( list )
-    {
-        XFree( list );
-    }
-
     return states;
 }
 
@@ -490,32 +1702,52 @@ QStringList    WindowCtrlUnix::atomState( Display *display, quint64 window )
 /*
  *  Get the type of the window
  */
-QStringList    WindowCtrlUnix::atomWindowType( Display *display, quint64 window )
+QList< WindowCtrlUnix::WindowType >    WindowCtrlUnix::atomWindowType( Display *display, quint64 window )
 {
-    char prop_name[] = "_NET_WM_WINDOW_TYPE";
-    Atom prop = XInternAtom( display, prop_name, True );
+    QList< WindowType > types;
+
+    QList< unsigned long > atoms = atomListProperty( display, window, m_atoms[ ATOM_NET_WM_WINDOW_TYPE ] );
+    foreach( unsigned long atom, atoms )
+    {
+        WindowType found = TYPE_UNKNOWN;
+        for( int type = TYPE_DESKTOP ; type <= TYPE_NORMAL ; ++type )
+        {
+            if( atom == m_atoms[ ATOM_NET_WM_WINDOW_TYPE_DESKTOP + type - TYPE_DESKTOP ] )
+            {
+                found = static_cast< WindowType >( type );
+                break;
+            }
+        }
 
+        types.append( found );
+    }
+
+    return types;
+}
+
+
+/*
+ *  Get an atom list property of the window
+ */
+QList< unsigned long >  WindowCtrlUnix::atomListProperty( Display *display, quint64 window, unsigned long prop )
+{
     Atom type;
     int format;
     unsigned long remain;
     unsigned long len;
     unsigned char* list = nullptr;
 
-    QStringList states;
+    QList< unsigned long > atoms;
 
-    if( XGetWindowProperty( display, window, prop, 0, sizeof( Atom ), False, XA_ATOM,
-                &type, &format, &len, &remain, &list ) == Success )
+    if( XGetWindowProperty( display, window, prop, 0, LONG_MAX, False, XA_ATOM,
+                &type, &format, &len, &remain, &list ) == Success && type == XA_ATOM && format == 32 )
     {
+        /*
+         *  Format 32 properties are returned as longs
+         */
         for( unsigned long i = 0; i < len; ++i )
         {
-            char* atom_name = XGetAtomName( display, reinterpret_cast<Atom *>( list )[ i ] );
-
-            states.append( atom_name );
-
-            if( atom_name )
-            {
-                XFree( atom_name );
-            }
+            atoms.append( reinterpret_cast<Atom *>( list )[ i ] );
         }
     }
 
@@ -524,7 +1756,7 @@ QStringList    WindowCtrlUnix::atomWindowType( Display *display, quint64 window
         XFree( list );
     }
 
-    return states;
+    return atoms;
 }
 
 #endif // Q_OS_UNIX
@@ -17,11 +17,17 @@
  *	Qt includes
  */
 #include <QObject>
+#include <QHash>
+#include <QMultiHash>
 
 /*
  *  Predefines
  */
+class QSocketNotifier;
+
 typedef struct _XDisplay Display;
+typedef union _XEvent XEvent;
+typedef struct xcb_connection_t xcb_connection_t;
 
 /**
  * @brief The WindowCtrlUnix class.
@@ -88,6 +94,62 @@ class WindowCtrlUnix : public QObject
             "_NET_WM_STATE_DEMANDS_ATTENTION"
         };
 
+        /*
+         *  The EWMH/ICCCM atoms used, interned once at startup.
+         *  The states and types are in the order of WindowState and WindowType.
+         */
+        enum AtomId
+        {
+            ATOM_NET_WM_STATE_MODAL = 0,
+            ATOM_NET_WM_STATE_STICKY,
+            ATOM_NET_WM_STATE_MAXIMIZED_VERT,
+            ATOM_NET_WM_STATE_MAXIMIZED_HORZ,
+            ATOM_NET_WM_STATE_SHADED,
+            ATOM_NET_WM_STATE_SKIP_TASKBAR,
+            ATOM_NET_WM_STATE_SKIP_PAGER,
+            ATOM_NET_WM_STATE_HIDDEN,
+            ATOM_NET_WM_STATE_FULLSCREEN,
+            ATOM_NET_WM_STATE_ABOVE,
+            ATOM_NET_WM_STATE_BELOW,
+            ATOM_NET_WM_STATE_DEMANDS_ATTENTION,
+            ATOM_NET_WM_WINDOW_TYPE_DESKTOP,
+            ATOM_NET_WM_WINDOW_TYPE_DOCK,
+            ATOM_NET_WM_WINDOW_TYPE_TOOLBAR,
+            ATOM_NET_WM_WINDOW_TYPE_MENU,
+            ATOM_NET_WM_WINDOW_TYPE_UTILITY,
+            ATOM_NET_WM_WINDOW_TYPE_SPLASH,
+            ATOM_NET_WM_WINDOW_TYPE_DIALOG,
+            ATOM_NET_WM_WINDOW_TYPE_DROPDOWN_MENU,
+            ATOM_NET_WM_WINDOW_TYPE_POPUP_MENU,
+            ATOM_NET_WM_WINDOW_TYPE_TOOLTIP,
+            ATOM_NET_WM_WINDOW_TYPE_NOTIFICATION,
+            ATOM_NET_WM_WINDOW_TYPE_COMBO,
+            ATOM_NET_WM_WINDOW_TYPE_DND,
+            ATOM_NET_WM_WINDOW_TYPE_NORMAL,
+            ATOM_NET_WM_STATE,
+            ATOM_NET_WM_WINDOW_TYPE,
+            ATOM_NET_WM_NAME,
+            ATOM_NET_WM_PID,
+            ATOM_NET_CLIENT_LIST,
+            ATOM_NET_ACTIVE_WINDOW,
+            ATOM_UTF8_STRING,
+            ATOM_WM_PROTOCOLS,
+            ATOM_WM_DELETE_WINDOW,
+            ATOM_WM_STATE,
+            ATOM_WM_NAME,
+            ATOM_WM_CLASS,
+            ATOM_COUNT
+        };
+
+        /*
+         *  X protocol backends for the window searches
+         */
+        enum Backend
+        {
+            BACKEND_XLIB = 0,
+            BACKEND_XCB
+        };
+
         /*
          *  Window list item
          */
@@ -114,6 +176,11 @@ class WindowCtrlUnix : public QObject
          */
         explicit WindowCtrlUnix( QObject *parent = nullptr );
 
+        /**
+         * @brief ~WindowCtrlUnix. Destructor, closes the X connection.
+         */
+        ~WindowCtrlUnix();
+
         /**
          * @brief getPpid. Get the parent process id.
          *
@@ -121,6 +188,13 @@ class WindowCtrlUnix : public QObject
          */
         qint64  getPpid();
 
+        /**
+         * @brief getIdleTime. Get the time since the last user input.
+         *
+         *  @return     The idle time in ms, -1 if the screen saver extension is not available.
+         */
+        qint64  getIdleTime();
+
         /**
          * @brief findWindow. Find window by (sub)title.
          *
@@ -137,6 +211,32 @@ class WindowCtrlUnix : public QObject
          */
         void    findWindow( qint64 pid );
 
+        /**
+         * @brief isTrackingWindows. Are the Thunderbird windows tracked by X events.
+         *
+         *  @return     True if the window state is known from the X server.
+         */
+        bool    isTrackingWindows() const;
+
+        /**
+         * @brief findClassWindows. Find the top level windows of a WM_CLASS.
+         *
+         *  @param wm_class     The class name.
+         *
+         *  @return     The windows.
+         */
+        QList< quint64 >    findClassWindows( const QString& wm_class ) const;
+
+        /**
+         * @brief benchmarkFindWindow. Compare the window searches using Xlib and XCB, the client list and the window tree.
+         *
+         *  @param pid          The process id to find.
+         *  @param iterations   Number of searches per method.
+         *
+         *  @return     The results.
+         */
+        QStringList benchmarkFindWindow( qint64 pid, int iterations );
+
         /**
          * @brief displayWindowElements. Display window elements (atoms).
          *
@@ -197,6 +297,86 @@ class WindowCtrlUnix : public QObject
 
     private:
 
+        /**
+         * @brief listCandidateWindows. Get the windows to search.
+         *
+         *  The top level clients listed by an EWMH window manager in _NET_CLIENT_LIST,
+         *  the whole window tree for other window managers.
+         *
+         *  @param backend          The X protocol backend.
+         *  @param use_client_list  Use the client list if available.
+         *
+         *  @return     The windows list.
+         */
+        QList< WindowItem > listCandidateWindows( Backend backend, bool use_client_list = true );
+
+        /**
+         * @brief listClientWindows. Get the managed top level windows in a single request.
+         *
+         *  @param windows  Storage for the windows.
+         *
+         *  @return     False if the window manager does not support _NET_CLIENT_LIST.
+         */
+        bool    listClientWindows( QList< WindowItem >& windows );
+
+        /**
+         * @brief findPidWindow. Find the first window of a process.
+         *
+         *  @param backend  The X protocol backend.
+         *  @param pid      The process id.
+         *  @param windows  The windows to search.
+         *
+         *  @return     The window, 0 if not found.
+         */
+        quint64 findPidWindow( Backend backend, qint64 pid, const QList< WindowItem >& windows );
+
+        /**
+         * @brief findTitleWindows. Find the windows with a (sub)title.
+         *
+         *  @param backend  The X protocol backend.
+         *  @param title    The title to find.
+         *  @param windows  The windows to search.
+         *
+         *  @return     The windows.
+         */
+        QList< quint64 >    findTitleWindows( Backend backend, const QString& title, const QList< WindowItem >& windows );
+
+        /**
+         * @brief listXcbClientWindows. Get the managed top level windows using XCB.
+         *
+         *  @param windows  Storage for the windows.
+         *
+         *  @return     False if the window manager does not support _NET_CLIENT_LIST.
+         */
+        bool    listXcbClientWindows( QList< WindowItem >& windows );
+
+        /**
+         * @brief listXcbWindows. Get all the windows using XCB, one round trip per tree level.
+         *
+         *  @return     The windows list.
+         */
+        QList< WindowItem > listXcbWindows();
+
+        /**
+         * @brief findXcbPidWindow. Find the first window of a process, all requests pipelined.
+         *
+         *  @param pid      The process id.
+         *  @param windows  The windows to search.
+         *
+         *  @return     The window, 0 if not found.
+         */
+        quint64 findXcbPidWindow( qint64 pid, const QList< WindowItem >& windows );
+
+        /**
+         * @brief findXcbTitleWindows. Find the windows with a (sub)title, all requests pipelined.
+         *
+         *  @param title    The title to find.
+         *  @param windows  The windows to search.
+         *
+         *  @return     The windows.
+         */
+        QList< quint64 >    findXcbTitleWindows( const QString& title, const QList< WindowItem >& windows );
+
         /**
          * @brief listXWindows. Get all the windows.
          *
@@ -224,9 +404,9 @@ class WindowCtrlUnix : public QObject
          *  @param display  The display
          *  @param window   The window
          *
-         *  @return     State of the window.
+         *  @return     The known states of the window.
          */
-        QStringList    atomState( Display* display, quint64 window );
+        QList< WindowState >    atomState( Display* display, quint64 window );
 
         /**
          * @brief atomType. Get the type of the window.
@@ -234,9 +414,20 @@ class WindowCtrlUnix : public QObject
          *  @param display  The display
          *  @param window   The window
          *
-         *  @return     Type of the window.
+         *  @return     Types of the window, TYPE_UNKNOWN for the unknown types.
          */
-        QStringList    atomWindowType( Display* display, quint64 window );
+        QList< WindowType >     atomWindowType( Display* display, quint64 window );
+
+        /**
+         * @brief atomListProperty. Get an atom list property of the window.
+         *
+         *  @param display  The display
+         *  @param window   The window
+         *  @param prop     The property.
+         *
+         *  @return     The atoms.
+         */
+        QList< unsigned long >  atomListProperty( Display* display, quint64 window, unsigned long prop );
 
     signals:
 
@@ -257,8 +448,184 @@ class WindowCtrlUnix : public QObject
          */
         void    signalConsole( QString message );
 
+        /**
+         * @brief signalWindowStateChanged. Signal a change of the tracked window state reported by the X server.
+         *
+         *  @param state    The state, "normal" or "minimized".
+         */
+        void    signalWindowStateChanged( QString state );
+
+    private slots:
+
+        /**
+         * @brief slotXEvents. Handle the X events, the connection is readable.
+         */
+        void    slotXEvents();
+
+        /**
+         * @brief slotXQueuedEvents. Handle the X events already read by Xlib, before the event loop sleeps.
+         */
+        void    slotXQueuedEvents();
+
+    private:
+
+        /**
+         * @brief trackWindows. Follow the state of the windows by X events.
+         *
+         *  @param windows  The windows.
+         */
+        void    trackWindows( const QList< quint64 >& windows );
+
+        /**
+         * @brief indexWindows. Add the windows to the index or refresh their properties.
+         *
+         *  @param windows  The windows.
+         */
+        void    indexWindows( const QList< quint64 >& windows );
+
+        /**
+         * @brief refreshIndex. Sync the index with the window list and re-read the properties.
+         */
+        void    refreshIndex();
+
+        /**
+         * @brief removeIndexWindow. Remove a window from the index.
+         *
+         *  @param window   The window.
+         */
+        void    removeIndexWindow( quint64 window );
+
+        /**
+         * @brief findIndexPidWindow. Find the first indexed window of a process, refresh the index on a miss.
+         *
+         *  @param pid      The process id.
+         *
+         *  @return     The window, 0 if not found.
+         */
+        quint64 findIndexPidWindow( qint64 pid );
+
+        /**
+         * @brief findIndexTitleWindows. Find the indexed windows with a (sub)title.
+         *
+         *  The untracked matches are re-read before they are trusted, the index is refreshed on a miss.
+         *
+         *  @param title    The title to find.
+         *
+         *  @return     The windows.
+         */
+        QList< quint64 >    findIndexTitleWindows( const QString& title );
+
+        /**
+         * @brief processXEvents. Handle the queued X events.
+         *
+         *  @param mode     The XEventsQueued mode.
+         */
+        void    processXEvents( int mode );
+
+        /**
+         * @brief handleXEvent. Update the tracked windows with an event.
+         *
+         *  @param event    The event.
+         */
+        void    handleXEvent( XEvent* event );
+
+        /**
+         * @brief readWmState. Get the ICCCM WM_STATE of the window.
+         *
+         *  @param window   The window.
+         *
+         *  @return     The state, -1 if not set.
+         */
+        long    readWmState( quint64 window );
+
+        /**
+         * @brief updateTrackedState. Signal the state of the tracked windows if changed.
+         */
+        void    updateTrackedState();
+
+    private:
+
+        /**
+         * @brief The TrackedWindow class. The X state of a tracked window.
+         */
+        class TrackedWindow
+        {
+            public:
+
+                TrackedWindow()
+                {
+                    mapped = false;
+                    iconic = false;
+                    hidden = false;
+                }
+
+                /**
+                 * @brief mapped. The window is mapped.
+                 */
+                bool    mapped;
+
+                /**
+                 * @brief iconic. The WM_STATE is IconicState.
+                 */
+                bool    iconic;
+
+                /**
+                 * @brief hidden. The _NET_WM_STATE contains _NET_WM_STATE_HIDDEN.
+                 */
+                bool    hidden;
+        };
+
+        /**
+         * @brief The IndexedWindow class. The properties of a top level window.
+         */
+        class IndexedWindow
+        {
+            public:
+
+                IndexedWindow()
+                {
+                    order = 0;
+                    pid = 0;
+                }
+
+                /**
+                 * @brief order. Order of discovery, older windows first.
+                 */
+                quint64 order;
+
+                /**
+                 * @brief pid. The _NET_WM_PID, 0 if not set.
+                 */
+                qint64  pid;
+
+                /**
+                 * @brief wm_class. The class part of WM_CLASS.
+                 */
+                QString wm_class;
+
+                /**
+                 * @brief title. The _NET_WM_NAME, WM_NAME if not set.
+                 */
+                QString title;
+        };
+
    private:
 
+        /**
+         * @brief TRACK_MASK. Events selected on the tracked windows.
+         */
+        static const long TRACK_MASK;
+
+        /**
+         * @brief AtomNames. The names of the atoms, indexed by AtomId.
+         */
+        static const char* const AtomNames[ ATOM_COUNT ];
+
+        /**
+         * @brief TB_CLASSES. The WM_CLASS names of the Thunderbird windows, the case changed over the versions.
+         */
+        static const char* const TB_CLASSES[];
+
         /**
          * @brief m_display. Pointer to the main display.
          */
@@ -279,10 +646,70 @@ class WindowCtrlUnix : public QObject
          */
         quint64 m_tb_window;
 
+        /**
+         * @brief m_tb_pid. The pid of the Thunderbird window, 0 if not searched by pid.
+         */
+        qint64  m_tb_pid;
+
         /**
          * @brief m_tb_windows. The Thunderbird windows (used by title search).
          */
         QList< quint64 >    m_tb_windows;
+
+        /**
+         * @brief m_screensaver. The screen saver extension is available.
+         */
+        bool    m_screensaver;
+
+        /**
+         * @brief m_xcb. The XCB connection of the display, nullptr if not available.
+         */
+        xcb_connection_t*   m_xcb;
+
+        /**
+         * @brief m_backend. The X protocol backend used for the window searches.
+         */
+        Backend m_backend;
+
+        /**
+         * @brief m_atoms. The interned atoms, indexed by AtomId.
+         */
+        unsigned long   m_atoms[ ATOM_COUNT ];
+
+        /**
+         * @brief m_x_notifier. Notifier of the X connection.
+         */
+        QSocketNotifier*    m_x_notifier;
+
+        /**
+         * @brief m_tracked. The tracked windows.
+         */
+        QHash< quint64, TrackedWindow > m_tracked;
+
+        /**
+         * @brief m_tracked_state. Last signalled state of the tracked windows.
+         */
+        QString m_tracked_state;
+
+        /**
+         * @brief m_index. The top level windows.
+         */
+        QHash< quint64, IndexedWindow > m_index;
+
+        /**
+         * @brief m_index_pid. The indexed windows by pid.
+         */
+        QMultiHash< qint64, quint64 >   m_index_pid;
+
+        /**
+         * @brief m_index_class. The indexed windows by class.
+         */
+        QMultiHash< QString, quint64 >  m_index_class;
+
+        /**
+         * @brief m_index_order. Order of the next indexed window.
+         */
+        quint64 m_index_order;
 };
 
 #endif // WINDOWCTRLUNIX_H
@@ -64,6 +64,26 @@ qint64  WindowCtrlWin::getPpid()
 }
 
 
+/*
+ *  Get the time since the last user input
+ */
+qint64  WindowCtrlWin::getIdleTime()
+{
+    LASTINPUTINFO info;
+    info.cbSize = sizeof( LASTINPUTINFO );
+
+    if( !GetLastInputInfo( &info ) )
+    {
+        return -1;
+    }
+
+    /*
+     *  Both tick counts wrap together
+     */
+    return static_cast< qint64 >( static_cast< DWORD >( GetTickCount() - info.dwTime ) );
+}
+
+
 /*
  *  Find the window by title
  */
@@ -45,6 +45,13 @@ class WindowCtrlWin : public QObject
          */
         qint64  getPpid();
 
+        /**
+         * @brief getIdleTime. Get the time since the last user input.
+         *
+         *  @return     The idle time in ms, -1 if not available.
+         */
+        qint64  getIdleTime();
+
         /**
          * @brief findWindow. Find window by title.
          *
@@ -4,6 +4,7 @@
 #include <QWidget>
 #include <QWindow>
 #include <QCoreApplication>
+#include <QTimer>
 
 /*
  *  Main include
@@ -18,7 +19,7 @@
 /*
  *  Constructor
  */
-WindowCtrl::WindowCtrl( Preferences* pref, QObject *parent )
+WindowCtrl::WindowCtrl( Preferences* pref, qint64 tb_pid, QObject *parent )
 #ifdef Q_OS_UNIX
     : WindowCtrlUnix( parent )
 #elif defined Q_OS_WIN
@@ -36,17 +37,46 @@ WindowCtrl::WindowCtrl( Preferences* pref, QObject *parent )
      *  Initialize
      */
     m_hide_minimize = m_pref->getHideOnMinimize();
+    m_poll_interval = POLL_INTERVAL_ACTIVE;
 
     /*
      *  Get pids
      */
     m_pid = QCoreApplication::applicationPid();
-    m_ppid = getPpid();
+    m_ppid = tb_pid > 0 ? tb_pid : getPpid();
+
+    /*
+     *  Follow the TB window state as reported by the window system
+     */
+#ifdef Q_OS_UNIX
+    connect( this, &WindowCtrlUnix::signalWindowStateChanged, this, &WindowCtrl::slotWindowStateChanged );
+#endif
 
     /*
      *  Get the TB window
      */
     findWindow( m_ppid );
+
+    /*
+     *  Follow the user activity, without an idle time source the interval stays active
+     */
+    m_idle_timer = new QTimer( this );
+    m_idle_timer->setInterval( IDLE_CHECK_INTERVAL );
+    connect( m_idle_timer, &QTimer::timeout, this, &WindowCtrl::slotIdleCheck );
+
+    if( getIdleTime() >= 0 )
+    {
+        m_idle_timer->start();
+    }
+}
+
+
+/*
+ *  Get the recommended poll interval
+ */
+int WindowCtrl::getPollInterval() const
+{
+    return m_poll_interval;
 }
 
 
@@ -87,6 +117,13 @@ void    WindowCtrl::slotWindowTest3()
 //    emit signalConsole( QString( "Pid %1" ).arg( m_pid ) );
 //    emit signalConsole( QString( "Ppid %1" ).arg( m_ppid ) );
 
+#ifdef Q_OS_UNIX
+    foreach( const QString& line, benchmarkFindWindow( m_ppid, 20 ) )
+    {
+        emit signalConsole( line );
+    }
+#endif
+
     emit signalConsole("Test 3 done");
 }
 
@@ -109,27 +146,54 @@ void    WindowCtrl::slotWindowTitle( QString title )
 
 
 /*
- *  Handle change in hide on minimize state
+ *  Handle change in preferences
  */
-void    WindowCtrl::slotHideOnMinimizeChange()
+void    WindowCtrl::slotPreferencesChange( quint32 changes )
 {
-    m_hide_minimize = m_pref->getHideOnMinimize();
+    if( changes & Preferences::PREF_HIDE_ON_MINIMIZE_CHANGE )
+    {
+        m_hide_minimize = m_pref->getHideOnMinimize();
+    }
+
+    if( changes & Preferences::PREF_START_MINIMIZED_CHANGE )
+    {
+        m_start_minimized = m_pref->getStartMinimized();
+    }
+}
+
+
+/*
+ *  Handle change in window state
+ */
+void    WindowCtrl::slotWindowState( QString state )
+{
+#ifdef Q_OS_UNIX
+    if( isTrackingWindows() )
+    {
+        /*
+         *  The X server already told us, the add-on message may be stale
+         */
+        return;
+    }
+#endif
+
+    setWindowState( state );
 }
 
 
 /*
- *  Handle change in start minimized state
+ *  Handle change in window state reported by the window system
  */
-void    WindowCtrl::slotStartMinimizedChange()
+void    WindowCtrl::slotWindowStateChanged( QString state )
 {
-    m_start_minimized = m_pref->getStartMinimized();
+    setWindowState( state );
 }
 
 
 /*
- *  Handle change in window state
+ *  Apply a new window state
  */
-void    WindowCtrl::slotWindowState( QString state )
+void    WindowCtrl::setWindowState( const QString& state )
 {
     if( m_state != state )
     {
@@ -165,6 +229,42 @@ void    WindowCtrl::slotShowHide()
 }
 
 
+/*
+ *  Adapt the poll interval to the user activity
+ */
+void    WindowCtrl::slotIdleCheck()
+{
+    qint64 idle = getIdleTime();
+    if( idle < 0 )
+    {
+        return;
+    }
+
+    /*
+     *  A visible TB window may be read without any input, back off later
+     */
+    qint64 scale = ( m_state == "normal" ) ? 2 : 1;
+
+    int interval = POLL_INTERVAL_ACTIVE;
+    if( idle >= scale * AWAY_TIME )
+    {
+        interval = POLL_INTERVAL_AWAY;
+    }
+    else
+    if( idle >= scale * IDLE_TIME )
+    {
+        interval = POLL_INTERVAL_IDLE;
+    }
+
+    if( interval != m_poll_interval )
+    {
+        m_poll_interval = interval;
+
+        emit signalPollInterval( interval );
+    }
+}
+
+
 /*
  *  Handle close signal
  */
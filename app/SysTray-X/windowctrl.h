@@ -16,6 +16,7 @@
  *  Predefines
  */
 class QWindow;
+class QTimer;
 class Preferences;
 
 /**
@@ -31,14 +32,64 @@ class WindowCtrl : public QObject
 {
     Q_OBJECT
 
+    public:
+
+        /**
+         * @brief POLL_INTERVAL_ACTIVE. Unread mail poll interval while the user is active (ms).
+         */
+        static const int POLL_INTERVAL_ACTIVE = 1000;
+
+        /**
+         * @brief POLL_INTERVAL_IDLE. Unread mail poll interval while the user is idle (ms).
+         */
+        static const int POLL_INTERVAL_IDLE = 5000;
+
+        /**
+         * @brief POLL_INTERVAL_AWAY. Unread mail poll interval while the user is away (ms).
+         */
+        static const int POLL_INTERVAL_AWAY = 30000;
+
+        /**
+         * @brief IDLE_TIME. Time without input before the user is idle (ms).
+         */
+        static const int IDLE_TIME = 60000;
+
+        /**
+         * @brief AWAY_TIME. Time without input before the user is away (ms).
+         */
+        static const int AWAY_TIME = 300000;
+
+        /**
+         * @brief IDLE_CHECK_INTERVAL. Interval of the idle time check (ms).
+         */
+        static const int IDLE_CHECK_INTERVAL = 2000;
+
     public:
 
         /**
          * @brief WindowCtrlUnix. Constructor.
          *
+         * @param pref      Pointer to the preferences storage.
+         * @param tb_pid    Pid of the TB process, 0 for the parent process.
          * @param parent    My parent.
          */
-        explicit WindowCtrl( Preferences* pref, QObject *parent = nullptr );
+        explicit WindowCtrl( Preferences* pref, qint64 tb_pid = 0, QObject *parent = nullptr );
+
+        /**
+         * @brief getPollInterval. Get the recommended unread mail poll interval.
+         *
+         *  @return     The interval in ms.
+         */
+        int getPollInterval() const;
+
+    signals:
+
+        /**
+         * @brief signalPollInterval. Signal a change of the recommended unread mail poll interval.
+         *
+         *  @param interval     The interval in ms.
+         */
+        void    signalPollInterval( int interval );
 
     public slots:
 
@@ -65,18 +116,11 @@ class WindowCtrl : public QObject
         void    slotWindowTitle( QString title );
 
         /**
-         * @brief slotHideOnMinimizeChange. Handle the hide on minimize signal.
+         * @brief slotPreferencesChange. Handle the preferences change signal.
          *
-         *  @param state    The state
+         *  @param changes  The changes (bits, Preferences::PrefChange).
          */
-        void    slotHideOnMinimizeChange();
-
-        /**
-         * @brief slotStartMinimizedChange. Handle the start minimized signal.
-         *
-         *  @param state    The state
-         */
-        void    slotStartMinimizedChange();
+        void    slotPreferencesChange( quint32 changes );
 
         /**
          * @brief slotWindowState. Handle the window state change signal.
@@ -95,6 +139,29 @@ class WindowCtrl : public QObject
          */
         void    slotClose();
 
+    private slots:
+
+        /**
+         * @brief slotIdleCheck. Adapt the poll interval to the user activity.
+         */
+        void    slotIdleCheck();
+
+        /**
+         * @brief slotWindowStateChanged. Handle the window state reported by the window system.
+         *
+         *  @param state    The state.
+         */
+        void    slotWindowStateChanged( QString state );
+
+    private:
+
+        /**
+         * @brief setWindowState. Apply a new window state.
+         *
+         *  @param state    The state.
+         */
+        void    setWindowState( const QString& state );
+
     private:
 
         /**
@@ -136,6 +203,16 @@ class WindowCtrl : public QObject
          * @brief m_state. State of the TB window.
          */
         QString m_state;
+
+        /**
+         * @brief m_idle_timer. Idle time check timer.
+         */
+        QTimer* m_idle_timer;
+
+        /**
+         * @brief m_poll_interval. Recommended unread mail poll interval (ms).
+         */
+        int m_poll_interval;
 };
 
 
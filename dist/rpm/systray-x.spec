@@ -27,6 +27,10 @@ BuildRequires:  unzip
 BuildRequires:  zip
 BuildRequires:  pkgconfig(Qt5Core)
 BuildRequires:  pkgconfig(Qt5Widgets)
+BuildRequires:  pkgconfig(Qt5Network)
+BuildRequires:  pkgconfig(xscrnsaver)
+BuildRequires:  pkgconfig(x11-xcb)
+BuildRequires:  pkgconfig(xcb)
 Requires:       MozillaThunderbird >= 68
 
 %description
@@ -3,6 +3,17 @@ var SysTrayX = {
 };
 
 SysTrayX.Messaging = {
+  lastUnread: undefined,
+
+  //  Unread mails per folder last send to the app, undefined before the snapshot
+  lastFolders: undefined,
+
+  //  Unread mail poll timer and interval (ms), the app may recommend another interval
+  POLL_INTERVAL_MIN: 1000,
+  POLL_INTERVAL_MAX: 60000,
+  pollTimer: undefined,
+  pollInterval: 1000,
+
   unreadFiltersTest: [
     { unread: true },
     { unread: true, folder: { accountId: "account1", path: "/INBOX" } }
@@ -16,11 +27,18 @@ SysTrayX.Messaging = {
     //  Send the window title to app
     SysTrayX.Messaging.sendTitle();
 
-    //  Send preferences to app
-    SysTrayX.Messaging.sendPreferences();
+    //  Send preferences to an app without handshake, a hello triggers them otherwise
+    window.setTimeout(SysTrayX.Link.helloTimeout, 2000);
 
     //    this.unReadMessages(this.unreadFiltersTest).then(this.unreadCb);
-    window.setInterval(SysTrayX.Messaging.pollAccounts, 1000);
+    SysTrayX.Messaging.setPollInterval(SysTrayX.Messaging.pollInterval);
+
+    //  Count new mail right away if Thunderbird tells us
+    if (browser.messages.onNewMailReceived) {
+      browser.messages.onNewMailReceived.addListener(
+        SysTrayX.Messaging.pollAccounts
+      );
+    }
 
     //  Send the app a close command if the window closes
     browser.windows.onRemoved.addListener(SysTrayX.Window.closed);
@@ -49,6 +67,37 @@ SysTrayX.Messaging = {
     }
   },
 
+  //
+  //  (Re)start polling with a new interval
+  //
+  setPollInterval: function(interval) {
+    interval = Math.min(
+      Math.max(interval, SysTrayX.Messaging.POLL_INTERVAL_MIN),
+      SysTrayX.Messaging.POLL_INTERVAL_MAX
+    );
+
+    if (
+      SysTrayX.Messaging.pollTimer !== undefined &&
+      interval === SysTrayX.Messaging.pollInterval
+    ) {
+      return;
+    }
+
+    //  The user is back, count right away
+    const faster = interval < SysTrayX.Messaging.pollInterval;
+
+    SysTrayX.Messaging.pollInterval = interval;
+    window.clearInterval(SysTrayX.Messaging.pollTimer);
+    SysTrayX.Messaging.pollTimer = window.setInterval(
+      SysTrayX.Messaging.pollAccounts,
+      interval
+    );
+
+    if (faster) {
+      SysTrayX.Messaging.pollAccounts();
+    }
+  },
+
   //
   //  Poll the accounts
   //
@@ -59,20 +108,22 @@ SysTrayX.Messaging = {
     const filtersDiv = document.getElementById("filters");
     const filtersAttr = filtersDiv.getAttribute("data-filters");
 
+    let filters = [{ unread: true }];
     if (filtersAttr !== "undefined") {
-      const filters = JSON.parse(filtersAttr);
-
-      if (filters.length > 0) {
-        SysTrayX.Messaging.unReadMessages(filters).then(
-          SysTrayX.Messaging.unreadCb
-        );
-      } else {
-        SysTrayX.Link.postSysTrayXMessage({ unreadMail: 0 });
-      }
-    } else {
-      SysTrayX.Messaging.unReadMessages([{ unread: true }]).then(
+      filters = JSON.parse(filtersAttr);
+    }
+
+    if (SysTrayX.Link.capabilities & SysTrayX.Link.CAP_UNREAD_MODEL) {
+      //  Per folder, only the changes are send
+      SysTrayX.Messaging.unReadFolders(filters).then(
+        SysTrayX.Messaging.unreadFoldersCb
+      );
+    } else if (filters.length > 0) {
+      SysTrayX.Messaging.unReadMessages(filters).then(
         SysTrayX.Messaging.unreadCb
       );
+    } else {
+      SysTrayX.Messaging.unreadCb(0);
     }
   },
 
@@ -98,10 +149,97 @@ SysTrayX.Messaging = {
     return unreadMessages;
   },
 
+  //
+  //  Get the unread messages per folder (Promise)
+  //  Returns a map of "accountId/path" to { account, folder, unread }
+  //
+  unReadFolders: async function(filters) {
+    let folders = new Map();
+    for (let i = 0; i < filters.length; ++i) {
+      let page = await browser.messages.query(filters[i]);
+
+      for (;;) {
+        for (const message of page.messages) {
+          const key = message.folder.accountId + message.folder.path;
+          const entry = folders.get(key);
+
+          if (entry) {
+            entry.unread++;
+          } else {
+            folders.set(key, {
+              account: message.folder.accountId,
+              folder: message.folder.path,
+              unread: 1
+            });
+          }
+        }
+
+        if (!page.id) {
+          break;
+        }
+
+        page = await browser.messages.continueList(page.id);
+      }
+    }
+
+    return folders;
+  },
+
+  //
+  //  Callback for unReadFolders
+  //
+  unreadFoldersCb: async function(folders) {
+    const last = SysTrayX.Messaging.lastFolders;
+    SysTrayX.Messaging.lastFolders = folders;
+
+    if (last === undefined) {
+      //  First count, send all folders with the account names
+      const names = {};
+      for (const account of await browser.accounts.list()) {
+        names[account.id] = account.name;
+      }
+
+      const snapshot = Array.from(folders.values(), entry =>
+        Object.assign({ name: names[entry.account] || "" }, entry)
+      );
+
+      SysTrayX.Link.postSysTrayXMessage({ unreadFolders: snapshot });
+      return;
+    }
+
+    //  Only the folders that changed, gone folders have no unread mails left
+    const delta = [];
+    for (const [key, entry] of folders) {
+      const previous = last.get(key);
+      if (!previous || previous.unread !== entry.unread) {
+        delta.push(entry);
+      }
+    }
+
+    for (const [key, entry] of last) {
+      if (!folders.has(key)) {
+        delta.push({ account: entry.account, folder: entry.folder, unread: 0 });
+      }
+    }
+
+    if (delta.length > 0) {
+      SysTrayX.Link.postSysTrayXMessage({ unreadDelta: delta });
+    }
+  },
+
   //
   //  Callback for unReadMessages
   //
   unreadCb: function(count) {
+    //  Only send changes if the app does not need the polls
+    if (
+      SysTrayX.Link.capabilities & SysTrayX.Link.CAP_PUSH_UNREAD &&
+      count === SysTrayX.Messaging.lastUnread
+    ) {
+      return;
+    }
+
+    SysTrayX.Messaging.lastUnread = count;
     SysTrayX.Link.postSysTrayXMessage({ unreadMail: count });
   },
 
@@ -122,25 +260,68 @@ SysTrayX.Messaging = {
     getter.then(this.sendPreferencesStorage, this.onSendPreferecesStorageError);
   },
 
-  sendPreferencesStorage: function(result) {
+  sendPreferencesStorage: async function(result) {
     const debug = result.debug || "false";
     const hideOnMinimize = result.hideOnMinimize || "true";
     const startMinimized = result.startMinimized || "false";
     const iconType = result.iconType || "0";
     const iconMime = result.iconMime || "image/png";
-    const icon = result.icon || [];
+    const icon = result.icon || "";
+
+    const preferences = {
+      debug: debug,
+      hideOnMinimize: hideOnMinimize,
+      startMinimized: startMinimized,
+      iconType: iconType,
+      iconMime: iconMime
+    };
+
+    if (SysTrayX.Link.capabilities & SysTrayX.Link.CAP_ICON_DIGESTS) {
+      //  Only the digest, the app requests the icon if it does not have it
+      if (icon) {
+        preferences.iconDigest = await SysTrayX.Messaging.iconDigest(icon);
+      }
+    } else {
+      preferences.icon = icon;
+    }
 
     //  Send it to the app
-    SysTrayX.Link.postSysTrayXMessage({
-      preferences: {
-        debug: debug,
-        hideOnMinimize: hideOnMinimize,
-        startMinimized: startMinimized,
-        iconType: iconType,
-        iconMime: iconMime,
-        icon: icon
-      }
-    });
+    SysTrayX.Link.postSysTrayXMessage({ preferences: preferences });
+  },
+
+  //
+  //  Send the icon with its digest to the app
+  //
+  sendIcon: function() {
+    const getter = browser.storage.sync.get(["iconMime", "icon"]);
+    getter.then(this.sendIconStorage, this.onSendIconStorageError);
+  },
+
+  sendIconStorage: async function(result) {
+    const iconMime = result.iconMime || "image/png";
+    const icon = result.icon || "";
+
+    if (icon) {
+      SysTrayX.Link.postSysTrayXMessage({
+        preferences: {
+          iconMime: iconMime,
+          icon: icon,
+          iconDigest: await SysTrayX.Messaging.iconDigest(icon)
+        }
+      });
+    }
+  },
+
+  //
+  //  SHA-256 digest (hex) of the binary icon data
+  //
+  iconDigest: async function(iconBase64) {
+    const data = Uint8Array.from(atob(iconBase64), c => c.charCodeAt(0));
+    const hash = await crypto.subtle.digest("SHA-256", data);
+
+    return Array.from(new Uint8Array(hash))
+      .map(b => b.toString(16).padStart(2, "0"))
+      .join("");
   },
 
   onSendIconStorageError: function(error) {
@@ -194,6 +375,31 @@ SysTrayX.Messaging = {
 SysTrayX.Link = {
   portSysTrayX: undefined,
 
+  //  Protocol version and capabilities (bits)
+  PROTOCOL_VERSION: 1,
+  CAP_DELTA_PREFS: 0x01,
+  CAP_ICON_DIGESTS: 0x04,
+  CAP_PUSH_UNREAD: 0x08,
+  CAP_HEARTBEAT: 0x10,
+  CAP_UNREAD_MODEL: 0x20,
+  CAP_POLL_HINT: 0x40,
+
+  //  Capabilities of the add-on, keep the bits in sync with systrayxlink.h
+  get CAPABILITIES() {
+    return (
+      this.CAP_DELTA_PREFS |
+      this.CAP_ICON_DIGESTS |
+      this.CAP_PUSH_UNREAD |
+      this.CAP_HEARTBEAT |
+      this.CAP_UNREAD_MODEL |
+      this.CAP_POLL_HINT
+    );
+  },
+
+  //  Capabilities supported by both sides
+  capabilities: 0,
+  helloReceived: false,
+
   init: function() {
     //  Connect to the app
     this.portSysTrayX = browser.runtime.connectNative("SysTray_X");
@@ -209,7 +415,65 @@ SysTrayX.Link = {
     SysTrayX.Link.portSysTrayX.postMessage(object);
   },
 
+  //
+  //  Compare the icon digest of the app with the stored icon
+  //
+  checkIconDigest: async function(iconMime, iconDigest) {
+    const result = await browser.storage.sync.get(["icon"]);
+    const icon = result.icon || "";
+
+    if (icon && (await SysTrayX.Messaging.iconDigest(icon)) === iconDigest) {
+      if (iconMime) {
+        browser.storage.sync.set({
+          iconMime: iconMime
+        });
+      }
+    } else {
+      SysTrayX.Link.postSysTrayXMessage({ iconRequest: iconDigest });
+    }
+  },
+
+  //
+  //  No hello from the app, send the preferences the old way
+  //
+  helloTimeout: function() {
+    if (!SysTrayX.Link.helloReceived) {
+      SysTrayX.Messaging.sendPreferences();
+    }
+  },
+
   receiveSysTrayXMessage: function(response) {
+    if (response["hello"]) {
+      //  Handshake, enable the fast paths supported by both sides
+      const hello = response["hello"];
+      SysTrayX.Link.helloReceived = true;
+      SysTrayX.Link.capabilities =
+        SysTrayX.Link.CAPABILITIES & (hello.capabilities || 0);
+
+      //  Start the unread model of the app with a snapshot
+      SysTrayX.Messaging.lastFolders = undefined;
+
+      SysTrayX.Link.postSysTrayXMessage({
+        helloAck: {
+          version: SysTrayX.Link.PROTOCOL_VERSION,
+          capabilities: SysTrayX.Link.CAPABILITIES
+        }
+      });
+
+      //  Send the preferences to the app
+      SysTrayX.Messaging.sendPreferences();
+    }
+
+    if (response["ping"] !== undefined) {
+      //  Heartbeat of the app, we are alive
+      SysTrayX.Link.postSysTrayXMessage({ pong: response["ping"] });
+    }
+
+    if (response["pollInterval"] !== undefined) {
+      //  The app follows the user activity
+      SysTrayX.Messaging.setPollInterval(response["pollInterval"]);
+    }
+
     if (response["window"]) {
       if (response["window"] === "minimized") {
         browser.windows.update(SysTrayX.Window.startWindow.id, {
@@ -229,19 +493,35 @@ SysTrayX.Link = {
       console.log("Shutdown received: " + response["shutdown"]);
     }
 
+    if (response["iconRequest"]) {
+      //  The app does not have our icon
+      SysTrayX.Messaging.sendIcon();
+    }
+
     if (response["preferences"]) {
       //  Store the preferences from the app
       const iconMime = response["preferences"].iconMime;
-      if (iconMime) {
-        browser.storage.sync.set({
-          iconMime: iconMime
-        });
-      }
-
       const icon = response["preferences"].icon;
+      const iconDigest = response["preferences"].iconDigest;
+
       if (icon) {
+        //  Store the icon and its mime together, never an undefined mime
+        if (iconMime) {
+          browser.storage.sync.set({
+            iconMime: iconMime,
+            icon: icon
+          });
+        } else {
+          browser.storage.sync.set({
+            icon: icon
+          });
+        }
+      } else if (iconDigest) {
+        //  Only the digest, request the icon if we do not have it
+        SysTrayX.Link.checkIconDigest(iconMime, iconDigest);
+      } else if (iconMime) {
         browser.storage.sync.set({
-          icon: icon
+          iconMime: iconMime
         });
       }
 
@@ -1,5 +1,16 @@
+//  Largest custom icon, the app gets it in base64 and has to send it back in frames of at most 1 MB
+const MAX_ICON_SIZE = 512 * 1024;
+
 function fileSelected() {
   const input = document.getElementById("selectedFileIconType");
+  const tooLarge = document.getElementById("iconTooLarge");
+
+  if (input.files.length > 0 && input.files[0].size > MAX_ICON_SIZE) {
+    tooLarge.style.display = "inline";
+    input.value = "";
+    return;
+  }
+  tooLarge.style.display = "none";
 
   //  if (input.files.length > 0) {
   //    console.debug("Selected file: " + input.files[0].name);